@@ -0,0 +1,86 @@
+/*
+ * Copyright (C) 2015 University of Chicago.
+ * See COPYRIGHT notice in top-level directory.
+ *
+ */
+
+#ifndef CH_PLACEMENT_DIFF_H
+#define CH_PLACEMENT_DIFF_H
+
+#include <stdint.h>
+#include <ch-placement.h>
+
+#ifdef __cplusplus
+extern "C" {
+#endif
+
+/* a range of oid space whose replica set differs between two instances,
+ * along with one of the copies needed to migrate it
+ */
+struct ch_placement_moved_arc
+{
+    unsigned int ring;   /* arc only covers oids with oid % n_rings == ring */
+    uint64_t start;      /* first oid of the arc */
+    uint64_t end;        /* end of the arc (exclusive); wraps if < start */
+    unsigned long src;   /* server holding a replica in the old instance */
+    unsigned long dst;   /* server receiving the replica in the new one */
+};
+
+/* result of comparing the placement of two instances */
+struct ch_placement_diff
+{
+    int exact;              /* 1 if computed from arcs, 0 if sampled */
+    unsigned long examined; /* arcs (exact) or objects (sampled) compared */
+    double moved_fraction;  /* fraction of objects whose replica set changed */
+    unsigned int n_svrs;    /* dimension of the transfer matrix */
+    /* matrix[src*n_svrs + dst]: fraction of all objects that must be
+     * copied from server src to server dst.  Multiply by the size of the
+     * data set to estimate bytes moved.
+     */
+    double *matrix;
+    unsigned long n_arcs;   /* number of entries in arcs (exact only) */
+    struct ch_placement_moved_arc *arcs;
+};
+
+/* computes which data must move when switching placement from instance
+ * a to instance b (e.g. after changing the number of servers, the virtual
+ * node factor, or the down bitmap).  If both instances expose the same arc
+ * structure (ring, multiring) the result is exact.  Otherwise samples
+ * pseudo-random oids are compared using n_threads threads (0 for one per
+ * online CPU).  Returns 0 on success, -1 on failure.
+ */
+int ch_placement_diff(
+    struct ch_placement_instance *a,
+    struct ch_placement_instance *b,
+    unsigned int replication,
+    unsigned long samples,
+    int n_threads,
+    struct ch_placement_diff **diff);
+
+/* same as ch_placement_diff(), but always samples, even if an exact
+ * method is available.  Useful to check the accuracy of the estimate.
+ */
+int ch_placement_diff_sampled(
+    struct ch_placement_instance *a,
+    struct ch_placement_instance *b,
+    unsigned int replication,
+    unsigned long samples,
+    int n_threads,
+    struct ch_placement_diff **diff);
+
+void ch_placement_diff_free(struct ch_placement_diff *diff);
+
+#ifdef __cplusplus
+}
+#endif
+
+#endif /* CH_PLACEMENT_DIFF_H */
+
+/*
+ * Local variables:
+ *  c-indent-level: 4
+ *  c-basic-offset: 4
+ * End:
+ *
+ * vim: ft=c ts=8 sts=4 sw=4 expandtab
+ */
@@ -7,6 +7,7 @@
 #ifndef OID_GEN_H
 #define OID_GEN_H
 
+#include <stddef.h>
 #include <stdint.h>
 #include <ch-placement.h>
 
@@ -14,13 +15,18 @@
 extern "C" {
 #endif
 
+/* number of replicas whose placement can be cached in struct obj; kept
+ * smaller than CH_MAX_REPLICATION so that large populations stay compact
+ */
+#define CH_OBJ_MAX_REPLICATION 5
+
 /* describes an object */
 struct obj
 {
     uint64_t oid;          /* identifier */
     unsigned int replication;  /* replication factor */
     uint64_t size;         /* size of object */
-    unsigned long server_idxs[CH_MAX_REPLICATION]; /* cached placement data */
+    unsigned long server_idxs[CH_OBJ_MAX_REPLICATION]; /* cached placement data */
 };
 
 /* generates a random array of object IDs for testing/evaluation */
@@ -36,6 +42,46 @@ void oid_gen(char* gen_name,
     unsigned long* total_obj_count,
     struct obj** total_objs);
 
+/* Streaming generation, for populations too large to hold in memory.
+ * Objects are produced in chunks of at most chunk_objs, in generation
+ * order (not sorted), with the oids and sizes oid_gen("random") would
+ * produce for the same seed.  Repeated oids are suppressed as they are
+ * generated by a Bloom filter of at most filter_bytes (0 for the
+ * default), so memory use does not grow with max_objs.  A false positive
+ * drops a unique oid, which is replaced by the next one drawn; they only
+ * become likely once the population outgrows the filter, which is then
+ * filled only up to a ~1% false positive rate.  Only the "random"
+ * generator can be streamed; returns NULL for any other.
+ */
+#define OID_STREAM_DEFAULT_FILTER_BYTES (64UL*1024*1024)
+
+struct oid_stream;
+
+struct oid_stream* oid_stream_init(const char* gen_name,
+    unsigned long max_objs,
+    uint64_t max_bytes,
+    unsigned int random_seed,
+    unsigned int replication,
+    unsigned long chunk_objs,
+    size_t filter_bytes);
+
+/* fills objs with the next chunk (chunk_objs entries must fit) and returns
+ * its length, or 0 once the population is exhausted
+ */
+unsigned long oid_stream_next_batch(struct oid_stream *stream,
+    struct obj *objs);
+
+/* releases the stream; any of the counts may be NULL.  suppressed counts
+ * oids dropped as repeats (true repeats and filter false positives).
+ */
+void oid_stream_finalize(struct oid_stream *stream,
+    uint64_t* total_byte_count,
+    unsigned long* total_obj_count,
+    unsigned long* suppressed);
+
+/* sorts objs by oid, keeping equal oids in order; large arrays are sorted
+ * by up to CH_PLACEMENT_THREADS threads
+ */
 void oid_sort(struct obj* objs, unsigned int objs_count);
 
 void oid_randomize(struct obj* objs, unsigned int objs_count, unsigned int seed);
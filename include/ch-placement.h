@@ -8,19 +8,39 @@
 #define CH_PLACEMENT_H
 
 #include <stdint.h>
+#include <stddef.h>
 
 #ifdef __cplusplus
 extern "C" {
 #endif
 
-/* maximum replication factor allowed by library */
-#define CH_MAX_REPLICATION 5
+/* maximum replication factor allowed by library; wide enough for erasure
+ * coded layouts (k+m) as well as replication.  Lookups also require
+ * replication <= the number of servers.
+ */
+#define CH_MAX_REPLICATION 32
+
+/* server index stored by ch_placement_find_closest() in the entries it
+ * could not fill because fewer than replication servers are up
+ */
+#define CH_PLACEMENT_NO_SERVER ((unsigned long)-1)
 
 struct ch_placement_instance;
 
 struct ch_placement_instance* ch_placement_initialize(const char* name, 
     int n_svrs, int virt_factor, int seed);
 
+/* flags for ch_placement_initialize_flags() */
+/* build a private copy of the module tables on every NUMA node, allocated
+ * by a thread pinned to that node, and serve each lookup from the copy
+ * local to the calling thread.  Costs one table per node.
+ */
+#define CH_PLACEMENT_NUMA_REPLICATE 0x1
+
+/* ch_placement_initialize() with optional CH_PLACEMENT_* flags */
+struct ch_placement_instance* ch_placement_initialize_flags(const char* name,
+    int n_svrs, int virt_factor, int seed, unsigned int flags);
+
 void ch_placement_finalize(struct ch_placement_instance *instance);
 
 void ch_placement_find_closest(
@@ -29,8 +49,181 @@ void ch_placement_find_closest(
     unsigned int replication, 
     unsigned long* server_idxs);
 
+/* places n_objs objects; server_idxs receives replication entries per
+ * object.  Gives the same results as ch_placement_find_closest() on each
+ * object, but ring and multiring overlap the table searches of a batch so
+ * that their cache misses are serviced in parallel.
+ */
+void ch_placement_find_closest_batch(
+    struct ch_placement_instance *instance,
+    unsigned long n_objs,
+    const uint64_t *objs,
+    unsigned int replication,
+    unsigned long* server_idxs);
+
+/* ch_placement_find_closest_batch() spread over a pool of worker threads
+ * owned by the library (plain pthreads; the application does not need
+ * OpenMP).  The pool starts on first use with one thread per online CPU,
+ * or CH_PLACEMENT_THREADS threads if that environment variable is set,
+ * counting the calling thread, which takes part in the work.  Safe to call
+ * from several threads; a call that finds the pool busy runs on the
+ * calling thread alone.
+ */
+void ch_placement_find_closest_parallel(
+    struct ch_placement_instance *instance,
+    unsigned long n_objs,
+    const uint64_t *objs,
+    unsigned int replication,
+    unsigned long* server_idxs);
+
+/* name of the instruction set the library's scan kernels were resolved
+ * to on this CPU ("scalar", "sse4.2", "avx2" or "avx512").  Set the
+ * CH_PLACEMENT_ISA environment variable to one of these before the first
+ * lookup to force a lower level.  A level that is unknown or not supported
+ * by the CPU is ignored; call this to see which level is in use.
+ */
+const char* ch_placement_isa(void);
+
+/* memory held by an instance's placement tables */
+struct ch_placement_footprint
+{
+    size_t bytes;      /* bytes mapped, including page rounding */
+    size_t used;       /* bytes of those actually allocated */
+    size_t page_size;  /* largest page size explicitly mapped */
+    int transparent;   /* non-zero if transparent huge pages were requested */
+};
+
+/* fills in fp for instance, counting every NUMA replica.  Returns 0, or -1
+ * if the module does not track its memory (crush).
+ */
+int ch_placement_get_footprint(struct ch_placement_instance *instance,
+    struct ch_placement_footprint *fp);
+
+/* maximum number of tables described by struct ch_placement_stats */
+#define CH_PLACEMENT_STATS_TABLES 4
+
+struct ch_placement_table_stats
+{
+    const char *name;       /* "state", "vnodes", "ids", ... */
+    size_t bytes;           /* bytes allocated for it */
+    unsigned long entries;  /* number of entries in it */
+};
+
+/* construction cost and size of an instance's placement tables */
+struct ch_placement_stats
+{
+    double construction_time;   /* wall clock seconds to build the instance */
+    unsigned long entries;      /* vnodes or index entries a lookup searches */
+    size_t bytes;               /* bytes of all tables, over all replicas */
+    int replicas;               /* copies of the tables (one per NUMA node
+                                 * with CH_PLACEMENT_NUMA_REPLICATE) */
+    unsigned int n_tables;
+    struct ch_placement_table_stats tables[CH_PLACEMENT_STATS_TABLES];
+                                /* the tables of one copy */
+};
+
+/* fills in stats for instance.  Returns 0, or -1 if the module does not
+ * describe its tables.
+ */
+int ch_placement_get_stats(struct ch_placement_instance *instance,
+    struct ch_placement_stats *stats);
+
+/* hashes an arbitrary byte string key (path, UUID, tuple, ...) into the
+ * oid space used by ch_placement_find_closest().  16 byte keys take a
+ * specialized path that yields the same value as the generic one.
+ */
+uint64_t ch_placement_hash_key(const void *key, size_t key_len);
+
+/* places a byte string key, hashed with ch_placement_hash_key() */
+void ch_placement_find_closest_key(
+    struct ch_placement_instance *instance,
+    const void *key,
+    size_t key_len,
+    unsigned int replication,
+    unsigned long* server_idxs);
+
+/* places n_keys keys; server_idxs receives replication entries per key */
+void ch_placement_find_closest_key_batch(
+    struct ch_placement_instance *instance,
+    unsigned long n_keys,
+    const void * const *keys,
+    const size_t *key_lens,
+    unsigned int replication,
+    unsigned long* server_idxs);
+
+/* number of uint64_t words in a down bitmap for n_svrs servers */
+#define CH_PLACEMENT_DOWN_WORDS(n_svrs) (((n_svrs) + 63) / 64)
+
+/* marks servers as down without rebuilding the instance: bit (i % 64) of
+ * down[i / 64] set means server i is skipped by every lookup, in the
+ * module's natural order (next vnode on the ring, next best score, next
+ * slot); objects with no replica on a down server keep their placement.
+ * At least replication servers must remain up; if they do not,
+ * ch_placement_find_closest() sets the entries it cannot fill to
+ * CH_PLACEMENT_NO_SERVER.  The bitmap is not
+ * copied and must not be modified once installed; pass NULL to bring all
+ * servers back.  The swap is atomic and safe while other threads perform
+ * lookups.  Returns the previous bitmap, which the caller may release once
+ * lookups that started before the swap have completed.
+ */
+const uint64_t* ch_placement_set_down(
+    struct ch_placement_instance *instance,
+    const uint64_t *down);
+
+/* assigns each server index to a failure domain (host, rack, PDU, etc.).
+ * domains must hold one entry per server and is copied by the library;
+ * NULL clears the mapping.  Must not be called concurrently with lookups.
+ * Returns 0 on success, -1 on failure.
+ */
+int ch_placement_set_domains(
+    struct ch_placement_instance *instance,
+    const unsigned long *domains);
+
+/* variant of ch_placement_find_closest() that never places two replicas
+ * on servers in the same failure domain.  Returns 0 on success, or -1 if
+ * the module does not support it, replication exceeds CH_MAX_REPLICATION
+ * or the number of servers, or there are fewer than replication distinct
+ * domains with a server up.
+ */
+int ch_placement_find_closest_domains(
+    struct ch_placement_instance *instance,
+    uint64_t obj,
+    unsigned int replication,
+    unsigned long* server_idxs);
+
+/* pseudo-random number stream (xoshiro256**).  The state is owned by the
+ * caller, so independent streams can be used concurrently without locking
+ * and reproduce the same sequence for the same seed.
+ */
+struct ch_placement_rng
+{
+    uint64_t s[4];
+};
+
+/* initializes rng from a single seed (expanded with splitmix64) */
+void ch_placement_rng_seed(struct ch_placement_rng *rng, uint64_t seed);
+
+uint64_t ch_placement_rng_next(struct ch_placement_rng *rng);
+
+/* advances rng by 2^128 steps; calling this k times on copies of one
+ * seeded state yields k non-overlapping streams, e.g. one per thread
+ */
+void ch_placement_rng_jump(struct ch_placement_rng *rng);
+
+/* draws from a stream private to the calling thread */
 uint64_t ch_placement_random_u64(void);
 
+/* reseeds the calling thread's ch_placement_random_u64() stream */
+void ch_placement_random_seed(uint64_t seed);
+
+/* oids are drawn from the calling thread's random stream.  Sets
+ * *num_objects to 0 if replication exceeds CH_MAX_REPLICATION or the
+ * number of servers.  Stripes are spread over distinct servers as placed
+ * without the down bitmap (see ch_placement_set_down()); a stripe whose
+ * replicas are redirected away from down servers may then share servers
+ * with other stripes of the file.  The same applies to
+ * ch_placement_create_striped_file().
+ */
 void ch_placement_create_striped(
     struct ch_placement_instance *instance,
     unsigned long file_size, 
@@ -41,6 +234,119 @@ void ch_placement_create_striped(
     uint64_t *oids, 
     unsigned long *sizes);
 
+/* like ch_placement_create_striped(), but draws from rng */
+void ch_placement_create_striped_rng(
+    struct ch_placement_instance *instance,
+    struct ch_placement_rng *rng,
+    unsigned long file_size, 
+    unsigned int replication, 
+    unsigned int max_stripe_width, 
+    unsigned int strip_size,
+    unsigned int* num_objects,
+    uint64_t *oids, 
+    unsigned long *sizes);
+
+/* like ch_placement_create_striped(), but every stripe oid is derived from
+ * file_id and the stripe index (see ch_placement_stripe_oid()), so only
+ * file_id needs to be stored to find the objects again.  Consecutive
+ * stripes keep any disjointness the module's striping provides; for
+ * modules without their own striping layout, within each group of 64
+ * stripes.  Returns 0, or -1 if replication exceeds CH_MAX_REPLICATION
+ * or the number of servers, or if memory could not be allocated, in which
+ * case oids is not valid.
+ */
+int ch_placement_create_striped_file(
+    struct ch_placement_instance *instance,
+    uint64_t file_id,
+    unsigned long file_size, 
+    unsigned int replication, 
+    unsigned int max_stripe_width, 
+    unsigned int strip_size,
+    unsigned int* num_objects,
+    uint64_t *oids, 
+    unsigned long *sizes);
+
+/* stores in *oid the oid of stripe stripe_idx of file file_id, as
+ * assigned by ch_placement_create_striped_file() on an instance of the
+ * same configuration.  Multiring computes it directly.  Other modules
+ * replay the placement of the preceding stripes of its group of 64, which
+ * costs up to 64 lookups per replayed stripe, so up to ~4096 lookups per
+ * call.  Returns 0, or -1 if replication exceeds CH_MAX_REPLICATION or
+ * the number of servers, or if memory could not be allocated.
+ */
+int ch_placement_stripe_oid(
+    struct ch_placement_instance *instance,
+    uint64_t file_id,
+    unsigned long stripe_idx,
+    unsigned int replication,
+    uint64_t *oid);
+
+/* Epoch-protected handle for replacing an instance while other threads
+ * are performing lookups.  Readers never block: each registers once for a
+ * reader slot and then brackets lookups with read_begin()/read_end() (or
+ * uses the find_closest helpers, which do so).  A writer publishes a new
+ * instance; replaced instances are finalized once every reader that could
+ * still see them has left its read-side section.  The handle takes
+ * ownership of every instance given to it by a call that succeeds; if the
+ * call fails, the caller still owns the instance.
+ */
+struct ch_placement_handle;
+
+struct ch_placement_handle* ch_placement_handle_create(
+    struct ch_placement_instance *instance,
+    unsigned int max_readers);
+
+/* waits for readers to finish and finalizes all instances */
+void ch_placement_handle_destroy(struct ch_placement_handle *handle);
+
+/* returns a reader slot for the calling thread, or -1 if none are left */
+int ch_placement_handle_register(struct ch_placement_handle *handle);
+
+void ch_placement_handle_unregister(struct ch_placement_handle *handle,
+    int reader);
+
+/* returns the current instance, which remains valid until the matching
+ * read_end(); sections may not be nested on the same reader slot
+ */
+struct ch_placement_instance* ch_placement_handle_read_begin(
+    struct ch_placement_handle *handle, int reader);
+
+void ch_placement_handle_read_end(struct ch_placement_handle *handle,
+    int reader);
+
+void ch_placement_handle_find_closest(
+    struct ch_placement_handle *handle,
+    int reader,
+    uint64_t obj,
+    unsigned int replication,
+    unsigned long* server_idxs);
+
+/* looks an object up in both the current instance and the one it
+ * replaced, for reads during a migration.  Returns 1 if a migration is in
+ * progress, or 0 (with old_server_idxs a copy of new_server_idxs) if not.
+ */
+int ch_placement_handle_find_closest_dual(
+    struct ch_placement_handle *handle,
+    int reader,
+    uint64_t obj,
+    unsigned int replication,
+    unsigned long* old_server_idxs,
+    unsigned long* new_server_idxs);
+
+/* makes instance current; the previous one is kept as the old epoch for
+ * dual lookups until ch_placement_handle_end_migration().  Writers are
+ * serialized.  Returns 0 on success, -1 on failure, in which case the
+ * handle is unchanged and the caller must still finalize instance.
+ */
+int ch_placement_handle_publish(struct ch_placement_handle *handle,
+    struct ch_placement_instance *instance);
+
+/* drops the old epoch once data has been migrated */
+int ch_placement_handle_end_migration(struct ch_placement_handle *handle);
+
+/* blocks until every retired instance has been finalized */
+void ch_placement_handle_synchronize(struct ch_placement_handle *handle);
+
 #ifdef __cplusplus
 }
 #endif
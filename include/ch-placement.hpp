@@ -0,0 +1,321 @@
+/*
+ * Copyright (C) 2015 University of Chicago.
+ * See COPYRIGHT notice in top-level directory.
+ *
+ */
+
+#ifndef CH_PLACEMENT_HPP
+#define CH_PLACEMENT_HPP
+
+/* Header-only C++17 interface to the ring and multiring placement
+ * algorithms.  The replication factor and table layout are template
+ * parameters, so lookups are inlined at the call site with no function
+ * pointer dispatch and replica loops of fixed length.  Placements are
+ * identical to those of ch_placement_initialize("ring"/"multiring", ...)
+ * with the same n_svrs, virt_factor and seed.
+ *
+ * Example:
+ *
+ *     ch_placement::ring<3> r(n_svrs, virt_factor);
+ *     std::array<unsigned long, 3> idxs = r.find_closest(oid);
+ */
+
+#if __cplusplus < 201703L
+#error "ch-placement.hpp requires C++17"
+#endif
+
+#include <stdint.h>
+#include <cstddef>
+#include <array>
+#include <vector>
+#include <algorithm>
+#include <cassert>
+#include <cstring>
+
+#if defined(__has_include)
+#if __has_include(<span>) && __cplusplus > 201703L
+#include <span>
+#endif
+#endif
+
+namespace ch_placement
+{
+
+#if defined(__cpp_lib_span)
+template <class T> using span = std::span<T>;
+#else
+/* minimal stand-in for std::span (C++20) */
+template <class T> class span
+{
+public:
+    constexpr span() noexcept : ptr_(nullptr), size_(0) {}
+    constexpr span(T *ptr, std::size_t size) noexcept : ptr_(ptr), size_(size) {}
+    template <class C>
+    constexpr span(C &c) noexcept : ptr_(c.data()), size_(c.size()) {}
+    template <class C>
+    constexpr span(const C &c) noexcept : ptr_(c.data()), size_(c.size()) {}
+
+    constexpr T* data() const noexcept { return ptr_; }
+    constexpr std::size_t size() const noexcept { return size_; }
+    constexpr T& operator[](std::size_t i) const { return ptr_[i]; }
+    constexpr T* begin() const noexcept { return ptr_; }
+    constexpr T* end() const noexcept { return ptr_ + size_; }
+
+private:
+    T *ptr_;
+    std::size_t size_;
+};
+#endif
+
+/* Table layouts.  layout_aos keeps each virtual node's id and server index
+ * together; layout_soa keeps the ids in their own array so the binary
+ * search touches only ids, which halves the cache lines it pulls in.
+ */
+struct layout_aos {};
+struct layout_soa {};
+
+namespace detail
+{
+
+inline uint32_t rot(uint32_t x, int k)
+{
+    return (x << k) | (x >> (32 - k));
+}
+
+/* lookup3 hashlittle2() specialized for an 8 byte key; generates the same
+ * virtual node ids as the C modules
+ */
+inline uint64_t vnode_id(uint64_t svr, uint32_t initval, uint32_t seed)
+{
+    unsigned char b[8];
+    uint32_t a, bb, c;
+
+    std::memcpy(b, &svr, sizeof(b));
+    a = bb = c = 0xdeadbeef + 8 + initval;
+    c += seed;
+    a += (uint32_t)b[0] | ((uint32_t)b[1] << 8) | ((uint32_t)b[2] << 16) |
+        ((uint32_t)b[3] << 24);
+    bb += (uint32_t)b[4] | ((uint32_t)b[5] << 8) | ((uint32_t)b[6] << 16) |
+        ((uint32_t)b[7] << 24);
+
+    c ^= bb; c -= rot(bb, 14);
+    a ^= c;  a -= rot(c, 11);
+    bb ^= a; bb -= rot(a, 25);
+    c ^= bb; c -= rot(bb, 16);
+    a ^= c;  a -= rot(c, 4);
+    bb ^= a; bb -= rot(a, 14);
+    c ^= bb; c -= rot(bb, 24);
+
+    return (uint64_t)c + ((uint64_t)bb << 32);
+}
+
+struct vnode
+{
+    uint64_t id;
+    uint32_t svr_idx;
+};
+
+/* sorted virtual node table in the requested layout */
+template <class Layout> class table;
+
+template <> class table<layout_aos>
+{
+public:
+    void assign(std::vector<vnode> &&v) { nodes_ = std::move(v); }
+    std::size_t size() const { return nodes_.size(); }
+    uint32_t svr(std::size_t i) const { return nodes_[i].svr_idx; }
+
+    /* index of the virtual node whose arc contains obj */
+    std::size_t owner(uint64_t obj) const
+    {
+        auto it = std::upper_bound(nodes_.begin(), nodes_.end(), obj,
+            [](uint64_t o, const vnode &v) { return o < v.id; });
+        return it == nodes_.begin() ? nodes_.size() - 1 :
+            (std::size_t)(it - nodes_.begin()) - 1;
+    }
+
+private:
+    std::vector<vnode> nodes_;
+};
+
+template <> class table<layout_soa>
+{
+public:
+    void assign(std::vector<vnode> &&v)
+    {
+        ids_.resize(v.size());
+        svrs_.resize(v.size());
+        for (std::size_t i = 0; i < v.size(); i++)
+        {
+            ids_[i] = v[i].id;
+            svrs_[i] = v[i].svr_idx;
+        }
+    }
+    std::size_t size() const { return ids_.size(); }
+    uint32_t svr(std::size_t i) const { return svrs_[i]; }
+
+    std::size_t owner(uint64_t obj) const
+    {
+        auto it = std::upper_bound(ids_.begin(), ids_.end(), obj);
+        return it == ids_.begin() ? ids_.size() - 1 :
+            (std::size_t)(it - ids_.begin()) - 1;
+    }
+
+private:
+    std::vector<uint64_t> ids_;
+    std::vector<uint32_t> svrs_;
+};
+
+inline void sort_vnodes(std::vector<vnode> &v)
+{
+    std::sort(v.begin(), v.end(),
+        [](const vnode &x, const vnode &y) { return x.id < y.id; });
+}
+
+} /* namespace detail */
+
+/* consistent hashing ring with virt_factor virtual nodes per server; the
+ * replicas of an object are the next R distinct servers clockwise
+ */
+template <unsigned int R, class Layout = layout_soa>
+class ring
+{
+    static_assert(R >= 1, "replication must be at least 1");
+
+public:
+    ring(unsigned int n_svrs, unsigned int virt_factor, int seed = 0)
+        : n_svrs_(n_svrs)
+    {
+        std::vector<detail::vnode> v;
+
+        assert(n_svrs >= R);
+        v.reserve((std::size_t)n_svrs * virt_factor);
+        for (uint64_t i = 0; i < n_svrs; i++)
+            for (uint32_t j = 0; j < virt_factor; j++)
+                v.push_back({detail::vnode_id(i, j, (uint32_t)seed),
+                    (uint32_t)i});
+        detail::sort_vnodes(v);
+        table_.assign(std::move(v));
+    }
+
+    unsigned int n_svrs() const { return n_svrs_; }
+
+    void find_closest(uint64_t obj, unsigned long *server_idxs) const
+    {
+        std::size_t n = table_.size();
+        std::size_t cur = table_.owner(obj);
+
+        for (unsigned int i = 0; i < R; i++)
+        {
+            unsigned long svr;
+            bool dup;
+
+            /* skip virtual nodes of servers that already hold a replica */
+            do
+            {
+                svr = table_.svr(cur);
+                dup = false;
+                for (unsigned int j = 0; j < i; j++)
+                    dup |= (server_idxs[j] == svr);
+                if (++cur == n)
+                    cur = 0;
+            } while (dup);
+            server_idxs[i] = svr;
+        }
+    }
+
+    std::array<unsigned long, R> find_closest(uint64_t obj) const
+    {
+        std::array<unsigned long, R> idxs;
+        find_closest(obj, idxs.data());
+        return idxs;
+    }
+
+    /* server_idxs receives R entries per object */
+    void find_closest(span<const uint64_t> objs,
+        span<unsigned long> server_idxs) const
+    {
+        assert(server_idxs.size() >= objs.size() * R);
+        for (std::size_t i = 0; i < objs.size(); i++)
+            find_closest(objs[i], &server_idxs[i * R]);
+    }
+
+private:
+    unsigned int n_svrs_;
+    detail::table<Layout> table_;
+};
+
+/* virt_factor independent rings with one virtual node per server each;
+ * an object uses ring (oid % virt_factor)
+ */
+template <unsigned int R, class Layout = layout_soa>
+class multiring
+{
+    static_assert(R >= 1, "replication must be at least 1");
+
+public:
+    multiring(unsigned int n_svrs, unsigned int virt_factor, int seed = 0)
+        : n_svrs_(n_svrs), rings_(virt_factor)
+    {
+        assert(n_svrs >= R);
+        for (uint32_t j = 0; j < virt_factor; j++)
+        {
+            std::vector<detail::vnode> v;
+
+            v.reserve(n_svrs);
+            for (uint64_t i = 0; i < n_svrs; i++)
+                v.push_back({detail::vnode_id(i, j, (uint32_t)seed),
+                    (uint32_t)i});
+            detail::sort_vnodes(v);
+            rings_[j].assign(std::move(v));
+        }
+    }
+
+    unsigned int n_svrs() const { return n_svrs_; }
+
+    void find_closest(uint64_t obj, unsigned long *server_idxs) const
+    {
+        const detail::table<Layout> &t = rings_[obj % rings_.size()];
+        std::size_t cur = t.owner(obj);
+
+        /* each server appears once per ring; no duplicates to skip */
+        for (unsigned int i = 0; i < R; i++)
+        {
+            server_idxs[i] = t.svr(cur);
+            if (++cur == n_svrs_)
+                cur = 0;
+        }
+    }
+
+    std::array<unsigned long, R> find_closest(uint64_t obj) const
+    {
+        std::array<unsigned long, R> idxs;
+        find_closest(obj, idxs.data());
+        return idxs;
+    }
+
+    void find_closest(span<const uint64_t> objs,
+        span<unsigned long> server_idxs) const
+    {
+        assert(server_idxs.size() >= objs.size() * R);
+        for (std::size_t i = 0; i < objs.size(); i++)
+            find_closest(objs[i], &server_idxs[i * R]);
+    }
+
+private:
+    unsigned int n_svrs_;
+    std::vector<detail::table<Layout>> rings_;
+};
+
+} /* namespace ch_placement */
+
+#endif /* CH_PLACEMENT_HPP */
+
+/*
+ * Local variables:
+ *  c-indent-level: 4
+ *  c-basic-offset: 4
+ * End:
+ *
+ * vim: ft=cpp ts=8 sts=4 sw=4 expandtab
+ */
@@ -0,0 +1,190 @@
+/*
+ * Copyright (C) 2015 University of Chicago.
+ * See COPYRIGHT notice in top-level directory.
+ *
+ */
+
+#ifndef AFFINITY_H
+#define AFFINITY_H
+
+/* includers must define _GNU_SOURCE before their first include */
+
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <dirent.h>
+#include <sched.h>
+#include <pthread.h>
+
+/* Thread placement for benchmark sweeps.  CPU topology comes from
+ * /sys/devices/system/cpu; only CPUs in the process's affinity mask are
+ * used.
+ *
+ *   compact: fill one core, then the next core on the same package, then
+ *            the next package
+ *   scatter: one thread per core, alternating packages, before any core
+ *            gets a second hardware thread
+ *   numa:    thread t may run on any CPU of NUMA node (t % nodes)
+ *   none:    leave placement to the scheduler
+ */
+enum affinity_policy {
+    AFFINITY_NONE,
+    AFFINITY_COMPACT,
+    AFFINITY_SCATTER,
+    AFFINITY_NUMA
+};
+
+static const char *affinity_names[] = {"none", "compact", "scatter", "numa"};
+
+struct affinity_cpu {
+    int cpu;
+    int package;
+    int core;
+    int node;
+    int sibling;    /* rank among the hardware threads of its core */
+};
+
+static inline int affinity_parse(const char *name){
+    int i;
+
+    for (i = 0; i < (int)(sizeof(affinity_names)/sizeof(affinity_names[0])); i++){
+        if (strcmp(name, affinity_names[i]) == 0)
+            return i;
+    }
+    return -1;
+}
+
+static inline int affinity_read_int(int cpu, const char *file){
+    char path[256];
+    FILE *f;
+    int val = 0;
+
+    snprintf(path, sizeof(path), "/sys/devices/system/cpu/cpu%d/topology/%s",
+        cpu, file);
+    f = fopen(path, "r");
+    if (f){
+        if (fscanf(f, "%d", &val) != 1)
+            val = 0;
+        fclose(f);
+    }
+    return val;
+}
+
+/* node of a cpu, from its nodeN link; 0 if there is none */
+static inline int affinity_read_node(int cpu){
+    char path[256];
+    DIR *dir;
+    struct dirent *ent;
+    int node = 0;
+
+    snprintf(path, sizeof(path), "/sys/devices/system/cpu/cpu%d", cpu);
+    dir = opendir(path);
+    if (!dir)
+        return 0;
+    while ((ent = readdir(dir)) != NULL){
+        if (strncmp(ent->d_name, "node", 4) == 0 &&
+            sscanf(ent->d_name + 4, "%d", &node) == 1)
+            break;
+    }
+    closedir(dir);
+    return node;
+}
+
+static int affinity_compact_cmp(const void *a, const void *b){
+    const struct affinity_cpu *x = a, *y = b;
+
+    if (x->package != y->package) return x->package - y->package;
+    if (x->core != y->core) return x->core - y->core;
+    return x->cpu - y->cpu;
+}
+
+static int affinity_scatter_cmp(const void *a, const void *b){
+    const struct affinity_cpu *x = a, *y = b;
+
+    if (x->sibling != y->sibling) return x->sibling - y->sibling;
+    if (x->core != y->core) return x->core - y->core;
+    if (x->package != y->package) return x->package - y->package;
+    return x->cpu - y->cpu;
+}
+
+/* returns the usable CPUs in the order the policy hands them out, and
+ * their count in *n; NULL on failure
+ */
+static inline struct affinity_cpu* affinity_topology(int policy, int *n){
+    struct affinity_cpu *cpus;
+    cpu_set_t set;
+    int cpu, i, count = 0;
+
+    if (sched_getaffinity(0, sizeof(set), &set) != 0)
+        return NULL;
+    cpus = calloc(CPU_COUNT(&set), sizeof(*cpus));
+    if (!cpus)
+        return NULL;
+    for (cpu = 0; cpu < CPU_SETSIZE; cpu++){
+        if (!CPU_ISSET(cpu, &set))
+            continue;
+        cpus[count].cpu = cpu;
+        cpus[count].package = affinity_read_int(cpu, "physical_package_id");
+        cpus[count].core = affinity_read_int(cpu, "core_id");
+        cpus[count].node = affinity_read_node(cpu);
+        count++;
+    }
+
+    /* cpus are in ascending order, so earlier entries of the same core
+     * are lower ranked siblings
+     */
+    for (cpu = 0; cpu < count; cpu++){
+        for (i = 0; i < cpu; i++){
+            if (cpus[i].package == cpus[cpu].package &&
+                cpus[i].core == cpus[cpu].core)
+                cpus[cpu].sibling++;
+        }
+    }
+
+    if (policy == AFFINITY_SCATTER)
+        qsort(cpus, count, sizeof(*cpus), affinity_scatter_cmp);
+    else
+        qsort(cpus, count, sizeof(*cpus), affinity_compact_cmp);
+    *n = count;
+    return cpus;
+}
+
+/* pins the calling thread, the t'th of a run, according to policy */
+static inline int affinity_pin(int policy, const struct affinity_cpu *cpus,
+        int n, int t){
+    cpu_set_t set;
+    int nodes[CPU_SETSIZE];
+    int n_nodes = 0;
+    int i, j;
+
+    if (policy == AFFINITY_NONE || n == 0)
+        return 0;
+
+    CPU_ZERO(&set);
+    if (policy == AFFINITY_NUMA){
+        for (i = 0; i < n; i++){
+            for (j = 0; j < n_nodes && nodes[j] != cpus[i].node; j++);
+            if (j == n_nodes)
+                nodes[n_nodes++] = cpus[i].node;
+        }
+        for (i = 0; i < n; i++){
+            if (cpus[i].node == nodes[t % n_nodes])
+                CPU_SET(cpus[i].cpu, &set);
+        }
+    }
+    else
+        CPU_SET(cpus[t % n].cpu, &set);
+
+    return pthread_setaffinity_np(pthread_self(), sizeof(set), &set) == 0 ? 0 : -1;
+}
+
+#endif /* AFFINITY_H */
+
+/*
+ * Local variables:
+ *  c-indent-level: 4
+ *  c-basic-offset: 4
+ * End:
+ *
+ * vim: ft=c ts=8 sts=4 sw=4 expandtab
+ */
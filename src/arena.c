@@ -0,0 +1,178 @@
+/*
+ * Copyright (C) 2015 University of Chicago.
+ * See COPYRIGHT notice in top-level directory.
+ *
+ */
+
+#define _GNU_SOURCE
+
+#include <stdint.h>
+#include <unistd.h>
+#include <sys/mman.h>
+
+#include "ch-placement.h"
+#include "src/arena.h"
+
+#define ARENA_HUGE_2M (1UL << 21)
+#define ARENA_HUGE_1G (1UL << 30)
+
+/* lives at the start of its own mapping */
+struct placement_arena
+{
+    void *base;
+    size_t mapped;     /* bytes mapped at base */
+    size_t used;
+    size_t page_size;
+    int transparent;   /* transparent huge pages were requested */
+};
+
+static void* arena_map_hugetlb(size_t size, size_t page_size, int shift);
+static void* arena_map_aligned(size_t size, size_t align);
+
+struct placement_arena* placement_arena_create(size_t size)
+{
+    struct placement_arena *arena;
+    size_t total;
+    size_t base_page = sysconf(_SC_PAGESIZE);
+    size_t page_size = base_page;
+    size_t mapped;
+    void *base = NULL;
+    int transparent = 0;
+
+    total = placement_arena_span(sizeof(*arena)) + size;
+
+    /* explicit huge pages only come from a preallocated pool, so each
+     * attempt fails quickly when the pool is empty; only worth it when the
+     * rounding wastes at most an eighth of the mapping
+     */
+    if(total >= ARENA_HUGE_1G && (-total & (ARENA_HUGE_1G-1)) <= total/8)
+    {
+        page_size = ARENA_HUGE_1G;
+        base = arena_map_hugetlb(total, page_size, 30);
+    }
+    if(!base && total >= ARENA_HUGE_2M && (-total & (ARENA_HUGE_2M-1)) <= total/8)
+    {
+        page_size = ARENA_HUGE_2M;
+        base = arena_map_hugetlb(total, page_size, 21);
+    }
+    if(base)
+        mapped = (total + page_size - 1) & ~(page_size - 1);
+    else
+    {
+        page_size = base_page;
+        mapped = (total + base_page - 1) & ~(base_page - 1);
+        if(mapped >= ARENA_HUGE_2M)
+        {
+            /* 2 MiB aligned so the kernel can back it with huge pages */
+            base = arena_map_aligned(mapped, ARENA_HUGE_2M);
+#ifdef MADV_HUGEPAGE
+            if(base && madvise(base, mapped, MADV_HUGEPAGE) == 0)
+                transparent = 1;
+#endif
+        }
+        else
+        {
+            base = mmap(NULL, mapped, PROT_READ|PROT_WRITE,
+                MAP_PRIVATE|MAP_ANONYMOUS, -1, 0);
+            if(base == MAP_FAILED)
+                base = NULL;
+        }
+    }
+    if(!base)
+        return(NULL);
+
+    arena = base;
+    arena->base = base;
+    arena->mapped = mapped;
+    arena->used = placement_arena_span(sizeof(*arena));
+    arena->page_size = page_size;
+    arena->transparent = transparent;
+
+    return(arena);
+}
+
+void* placement_arena_alloc(struct placement_arena *arena, size_t size)
+{
+    void *ptr;
+
+    size = placement_arena_span(size);
+    if(size > arena->mapped - arena->used)
+        return(NULL);
+
+    /* fresh anonymous memory is already zeroed */
+    ptr = (char*)arena->base + arena->used;
+    arena->used += size;
+
+    return(ptr);
+}
+
+void placement_arena_destroy(struct placement_arena *arena)
+{
+    if(arena)
+        munmap(arena->base, arena->mapped);
+
+    return;
+}
+
+void placement_arena_footprint(const struct placement_arena *arena,
+    struct ch_placement_footprint *fp)
+{
+    fp->bytes += arena->mapped;
+    fp->used += arena->used;
+    if(arena->page_size > fp->page_size)
+        fp->page_size = arena->page_size;
+    fp->transparent |= arena->transparent;
+
+    return;
+}
+
+static void* arena_map_hugetlb(size_t size, size_t page_size, int shift)
+{
+#if defined(MAP_HUGETLB) && defined(MAP_HUGE_SHIFT)
+    void *base;
+
+    size = (size + page_size - 1) & ~(page_size - 1);
+    base = mmap(NULL, size, PROT_READ|PROT_WRITE,
+        MAP_PRIVATE|MAP_ANONYMOUS|MAP_HUGETLB|(shift << MAP_HUGE_SHIFT),
+        -1, 0);
+    if(base == MAP_FAILED)
+        return(NULL);
+
+    return(base);
+#else
+    (void)size;
+    (void)page_size;
+    (void)shift;
+    return(NULL);
+#endif
+}
+
+/* maps size bytes at an align boundary by over-mapping and trimming */
+static void* arena_map_aligned(size_t size, size_t align)
+{
+    char *raw;
+    char *base;
+    size_t head;
+
+    raw = mmap(NULL, size + align, PROT_READ|PROT_WRITE,
+        MAP_PRIVATE|MAP_ANONYMOUS, -1, 0);
+    if(raw == MAP_FAILED)
+        return(NULL);
+
+    base = (char*)(((uintptr_t)raw + align - 1) & ~((uintptr_t)align - 1));
+    head = base - raw;
+    if(head)
+        munmap(raw, head);
+    munmap(base + size, align - head);
+
+    return(base);
+}
+
+/*
+ * Local variables:
+ *  c-indent-level: 4
+ *  c-basic-offset: 4
+ * End:
+ *
+ * vim: ft=c ts=8 sts=4 sw=4 expandtab
+ */
@@ -0,0 +1,61 @@
+/*
+ * Copyright (C) 2015 University of Chicago.
+ * See COPYRIGHT notice in top-level directory.
+ *
+ */
+
+#ifndef PLACEMENT_ARENA_H
+#define PLACEMENT_ARENA_H
+
+#include <stddef.h>
+
+#include "ch-placement.h"
+
+/* Single block allocator for module state.  A module adds up the
+ * placement_arena_span() of everything it needs, creates one arena of that
+ * size, and carves its mod, state and tables out of it; the whole
+ * instance is then released with one placement_arena_destroy().  Large
+ * arenas are backed by huge pages when the system provides them, so that
+ * lookups over big tables take few dTLB misses.
+ */
+
+/* alignment of every allocation */
+#define PLACEMENT_ARENA_ALIGN 64
+
+struct placement_arena;
+
+/* bytes that an allocation of size bytes takes from an arena */
+static inline size_t placement_arena_span(size_t size)
+{
+    return((size + PLACEMENT_ARENA_ALIGN - 1) &
+        ~((size_t)PLACEMENT_ARENA_ALIGN - 1));
+}
+
+/* maps an arena with room for size bytes of spans; tries 1 GiB and 2 MiB
+ * hugetlb pages first, then ordinary pages with transparent huge pages
+ * requested.  Returns NULL on failure.
+ */
+struct placement_arena* placement_arena_create(size_t size);
+
+/* returns size zeroed bytes aligned to PLACEMENT_ARENA_ALIGN, or NULL if
+ * the arena is full
+ */
+void* placement_arena_alloc(struct placement_arena *arena, size_t size);
+
+/* unmaps the arena and everything allocated from it */
+void placement_arena_destroy(struct placement_arena *arena);
+
+/* adds the arena's mapping to a footprint report */
+void placement_arena_footprint(const struct placement_arena *arena,
+    struct ch_placement_footprint *fp);
+
+#endif /* PLACEMENT_ARENA_H */
+
+/*
+ * Local variables:
+ *  c-indent-level: 4
+ *  c-basic-offset: 4
+ * End:
+ *
+ * vim: ft=c ts=8 sts=4 sw=4 expandtab
+ */
@@ -0,0 +1,600 @@
+/*
+ * Copyright (C) 2015 University of Chicago.
+ * See COPYRIGHT notice in top-level directory.
+ *
+ */
+
+#include <string.h>
+#include <stdio.h>
+#include <stdlib.h>
+#include <ctype.h>
+#include <math.h>
+#include <unistd.h>
+
+/* Compares a ch-placement-benchmark -J result against a stored baseline
+ * and reports every metric that moved by more than the noise allows.
+ *
+ * Throughput metrics carry the rate of each pass.  One of them regresses
+ * if its mean rate dropped by more than the larger of the tolerance and
+ * k standard errors of the difference between the two means, so that a
+ * noisy baseline does not produce false alarms and a quiet one still
+ * catches small drops.  Single valued metrics (latency percentiles,
+ * cache mode lookup times, construction time, table memory, instructions
+ * per lookup) only have the tolerance.  The maximum latency is a single sample and the other
+ * hardware counters vary with the machine's state, so they are only shown.
+ * Exits with 1 if anything regressed.
+ */
+
+struct options
+{
+    double tolerance;       /* percent, throughput and memory */
+    double single_tolerance;/* percent, single valued timings */
+    double sigmas;
+    char* baseline;
+    char* current;
+};
+
+/* one value of a flattened JSON document: "metrics.ring.rate" etc. */
+struct entry
+{
+    char path[256];
+    char *str;              /* string value, or NULL */
+    unsigned int n;         /* numbers; more than one for arrays */
+    double *vals;
+};
+
+struct doc
+{
+    struct entry *entries;
+    unsigned int n;
+    unsigned int size;
+};
+
+struct parser
+{
+    const char *p;
+    struct doc *doc;
+};
+
+static int usage (char *exename);
+static struct options *parse_args(int argc, char *argv[]);
+
+static struct entry* doc_add(struct doc *doc, const char *path)
+{
+    struct entry *e;
+
+    if(doc->n == doc->size)
+    {
+        doc->size = doc->size ? doc->size*2 : 64;
+        e = realloc(doc->entries, doc->size*sizeof(*e));
+        if(!e)
+            return(NULL);
+        doc->entries = e;
+    }
+    e = &doc->entries[doc->n++];
+    memset(e, 0, sizeof(*e));
+    snprintf(e->path, sizeof(e->path), "%s", path);
+
+    return(e);
+}
+
+static struct entry* doc_find(struct doc *doc, const char *path)
+{
+    unsigned int i;
+
+    for(i=0; i<doc->n; i++)
+    {
+        if(strcmp(doc->entries[i].path, path) == 0)
+            return(&doc->entries[i]);
+    }
+
+    return(NULL);
+}
+
+static int entry_push(struct entry *e, double val)
+{
+    double *vals;
+
+    vals = realloc(e->vals, (e->n+1)*sizeof(*vals));
+    if(!vals)
+        return(-1);
+    e->vals = vals;
+    e->vals[e->n++] = val;
+
+    return(0);
+}
+
+static void skip_ws(struct parser *ps)
+{
+    while(isspace((unsigned char)*ps->p))
+        ps->p++;
+}
+
+/* strings written by the benchmark have no escapes other than \" and \\ */
+static char* parse_string(struct parser *ps)
+{
+    const char *start;
+    char *str, *out;
+
+    if(*ps->p != '"')
+        return(NULL);
+    start = ++ps->p;
+    while(*ps->p && *ps->p != '"')
+    {
+        if(*ps->p == '\\' && ps->p[1])
+            ps->p++;
+        ps->p++;
+    }
+    if(*ps->p != '"')
+        return(NULL);
+    str = malloc(ps->p - start + 1);
+    if(!str)
+        return(NULL);
+    for(out = str; start < ps->p; start++)
+    {
+        if(*start == '\\')
+            start++;
+        *out++ = *start;
+    }
+    *out = '\0';
+    ps->p++;
+
+    return(str);
+}
+
+static int parse_number(struct parser *ps, double *val)
+{
+    char *end;
+
+    *val = strtod(ps->p, &end);
+    if(end == ps->p)
+        return(-1);
+    ps->p = end;
+
+    return(0);
+}
+
+static int parse_value(struct parser *ps, const char *path)
+{
+    struct entry *e;
+    char child[256];
+    char *key;
+    double val;
+
+    skip_ws(ps);
+    if(*ps->p == '{')
+    {
+        ps->p++;
+        skip_ws(ps);
+        if(*ps->p == '}')
+        {
+            ps->p++;
+            return(0);
+        }
+        while(1)
+        {
+            skip_ws(ps);
+            key = parse_string(ps);
+            if(!key)
+                return(-1);
+            snprintf(child, sizeof(child), "%s%s%s", path, path[0] ? "." : "",
+                key);
+            free(key);
+            skip_ws(ps);
+            if(*ps->p++ != ':')
+                return(-1);
+            if(parse_value(ps, child) < 0)
+                return(-1);
+            skip_ws(ps);
+            if(*ps->p == ',')
+                ps->p++;
+            else if(*ps->p == '}')
+            {
+                ps->p++;
+                return(0);
+            }
+            else
+                return(-1);
+        }
+    }
+
+    e = doc_add(ps->doc, path);
+    if(!e)
+        return(-1);
+    if(*ps->p == '[')
+    {
+        /* only arrays of numbers are written */
+        ps->p++;
+        skip_ws(ps);
+        if(*ps->p == ']')
+        {
+            ps->p++;
+            return(0);
+        }
+        while(1)
+        {
+            skip_ws(ps);
+            if(parse_number(ps, &val) < 0 || entry_push(e, val) < 0)
+                return(-1);
+            skip_ws(ps);
+            if(*ps->p == ',')
+                ps->p++;
+            else if(*ps->p == ']')
+            {
+                ps->p++;
+                return(0);
+            }
+            else
+                return(-1);
+        }
+    }
+    if(*ps->p == '"')
+    {
+        e->str = parse_string(ps);
+        return(e->str ? 0 : -1);
+    }
+    if(strncmp(ps->p, "true", 4) == 0 || strncmp(ps->p, "false", 5) == 0)
+    {
+        val = (*ps->p == 't');
+        ps->p += val ? 4 : 5;
+        return(entry_push(e, val));
+    }
+    if(strncmp(ps->p, "null", 4) == 0)
+    {
+        ps->p += 4;
+        return(0);
+    }
+    if(parse_number(ps, &val) < 0)
+        return(-1);
+
+    return(entry_push(e, val));
+}
+
+static int load_doc(const char *file, struct doc *doc)
+{
+    struct parser ps;
+    FILE *f;
+    char *buf;
+    long len;
+    int ret;
+
+    f = fopen(file, "r");
+    if(!f)
+    {
+        perror(file);
+        return(-1);
+    }
+    fseek(f, 0, SEEK_END);
+    len = ftell(f);
+    fseek(f, 0, SEEK_SET);
+    buf = malloc(len + 1);
+    if(!buf || fread(buf, 1, len, f) != (size_t)len)
+    {
+        fprintf(stderr, "Error: failed to read %s\n", file);
+        fclose(f);
+        free(buf);
+        return(-1);
+    }
+    buf[len] = '\0';
+    fclose(f);
+
+    memset(doc, 0, sizeof(*doc));
+    ps.p = buf;
+    ps.doc = doc;
+    ret = parse_value(&ps, "");
+    skip_ws(&ps);
+    if(ret < 0 || *ps.p != '\0')
+    {
+        fprintf(stderr, "Error: %s is not a benchmark result (parse error at offset %ld)\n",
+            file, (long)(ps.p - buf));
+        ret = -1;
+    }
+    free(buf);
+
+    return(ret);
+}
+
+static double mean(const struct entry *e)
+{
+    double sum = 0;
+    unsigned int i;
+
+    for(i=0; i<e->n; i++)
+        sum += e->vals[i];
+
+    return(sum/e->n);
+}
+
+/* squared standard error of the mean */
+static double sq_error(const struct entry *e, double m)
+{
+    double var = 0;
+    unsigned int i;
+
+    if(e->n < 2)
+        return(0);
+    for(i=0; i<e->n; i++)
+        var += (e->vals[i] - m)*(e->vals[i] - m);
+
+    return(var/(e->n-1)/e->n);
+}
+
+/* prints one comparison line; returns 1 if it is a regression */
+static int report(const char *metric, double base, double cur,
+    double threshold, int higher_is_better)
+{
+    double change = base != 0 ? (cur - base)/base*100.0 : 0;
+    double loss = higher_is_better ? -change : change;
+    const char *status = "ok";
+
+    if(loss > threshold)
+        status = "REGRESSION";
+    else if(-loss > threshold)
+        status = "improved";
+    printf("%s\t%.6g\t%.6g\t%+.2f\t%.2f\t%s\n", metric, base, cur, change,
+        threshold, status);
+
+    return(loss > threshold);
+}
+
+/* config entries that must agree for the runs to be comparable */
+static const char *workload_keys[] = {"config.algorithm", "config.objects",
+    "config.replication", "config.servers", "config.virt_factor",
+    "config.numa_replicate", NULL};
+
+static int check_config(struct doc *base, struct doc *cur)
+{
+    struct entry *b, *c;
+    unsigned int i, j;
+    int workload, same;
+
+    for(i=0; i<base->n; i++)
+    {
+        b = &base->entries[i];
+        if(strncmp(b->path, "config.", 7) != 0)
+            continue;
+        c = doc_find(cur, b->path);
+        same = c && ((b->str && c->str && strcmp(b->str, c->str) == 0) ||
+            (!b->str && !c->str && b->n == 1 && c->n == 1 &&
+             b->vals[0] == c->vals[0]));
+        if(same)
+            continue;
+        workload = 0;
+        for(j=0; workload_keys[j]; j++)
+            workload |= (strcmp(b->path, workload_keys[j]) == 0);
+        if(workload)
+        {
+            fprintf(stderr, "Error: %s differs; the runs measure different workloads.\n",
+                b->path);
+            return(-1);
+        }
+        printf("# Note: %s differs from the baseline\n", b->path);
+    }
+
+    return(0);
+}
+
+static int per_call_matches(struct doc *base, struct doc *cur,
+    const char *prefix)
+{
+    const char *names[] = {"oids_per_call", "key_bytes", NULL};
+    char path[256];
+    struct entry *b, *c;
+    int i;
+
+    for(i=0; names[i]; i++)
+    {
+        snprintf(path, sizeof(path), "%s.%s", prefix, names[i]);
+        b = doc_find(base, path);
+        c = doc_find(cur, path);
+        if(b && (!c || b->n != 1 || c->n != 1 || b->vals[0] != c->vals[0]))
+            return(0);
+    }
+
+    return(1);
+}
+
+int main(
+    int argc,
+    char **argv)
+{
+    struct options *ig_opts = NULL;
+    struct doc base, cur;
+    struct entry *b, *c;
+    char prefix[256];
+    /* prefix plus the longest suffix appended to it */
+    char path[sizeof(prefix) + sizeof(".samples")];
+    const char *singles[] = {"construction_time", "latency.p50_ns",
+        "latency.p90_ns", "latency.p99_ns", "latency.p999_ns",
+        "cache.warm_random_ns", "cache.warm_sorted_ns",
+        "cache.flush_random_ns", "cache.flush_sorted_ns",
+        "cache.cycle_random_ns", "cache.cycle_sorted_ns", NULL};
+    const char *sizes[] = {"memory.used", "tables.bytes",
+        "counters.instructions", NULL};
+    const char *shown[] = {"counters.cycles", "counters.llc_misses",
+        "counters.dtlb_misses", "counters.branch_misses", NULL};
+    double bm, cm, noise, threshold;
+    unsigned int i;
+    int regressions = 0;
+    size_t len;
+
+    ig_opts = parse_args(argc, argv);
+    if(!ig_opts)
+    {
+        usage(argv[0]);
+        return(-1);
+    }
+
+    if(load_doc(ig_opts->baseline, &base) < 0 ||
+        load_doc(ig_opts->current, &cur) < 0)
+        return(-1);
+    if(check_config(&base, &cur) < 0)
+        return(-1);
+
+    printf("# <metric>\t<baseline>\t<current>\t<change %%>\t<threshold %%>\t<status>\n");
+
+    /* throughput: metrics.<name>.rate, with the per pass samples */
+    for(i=0; i<base.n; i++)
+    {
+        b = &base.entries[i];
+        len = strlen(b->path);
+        if(strncmp(b->path, "metrics.", 8) != 0 || len < 5 ||
+            strcmp(b->path + len - 5, ".rate") != 0)
+            continue;
+        snprintf(prefix, sizeof(prefix), "%.*s", (int)(len - 5), b->path);
+        if(!doc_find(&cur, b->path))
+        {
+            printf("# Note: %s was not measured in the current run\n", prefix);
+            continue;
+        }
+        if(!per_call_matches(&base, &cur, prefix))
+        {
+            printf("# Note: %s used a different call size; not compared\n",
+                prefix);
+            continue;
+        }
+        snprintf(path, sizeof(path), "%s.samples", prefix);
+        b = doc_find(&base, path);
+        c = doc_find(&cur, path);
+        if(!b || !c || !b->n || !c->n)
+        {
+            /* no samples; fall back to the summary rate */
+            snprintf(path, sizeof(path), "%s.rate", prefix);
+            b = doc_find(&base, path);
+            c = doc_find(&cur, path);
+            if(!b->n || !c->n)
+                continue;
+        }
+        bm = mean(b);
+        cm = mean(c);
+        noise = bm != 0 ? ig_opts->sigmas*sqrt(sq_error(b, bm) +
+            sq_error(c, cm))/bm*100.0 : 0;
+        threshold = noise > ig_opts->tolerance ? noise : ig_opts->tolerance;
+        regressions += report(prefix + 8, bm, cm, threshold, 1);
+    }
+
+    if(!per_call_matches(&base, &cur, "latency"))
+        printf("# Note: latency used a different call size; not compared\n");
+    if(!per_call_matches(&base, &cur, "cache"))
+        printf("# Note: cache modes used a different batch size; not compared\n");
+    for(i=0; singles[i]; i++)
+    {
+        b = doc_find(&base, singles[i]);
+        c = doc_find(&cur, singles[i]);
+        if(!b || !c || b->n != 1 || c->n != 1)
+            continue;
+        if(strncmp(singles[i], "latency.", 8) == 0 &&
+            !per_call_matches(&base, &cur, "latency"))
+            continue;
+        if(strncmp(singles[i], "cache.", 6) == 0 &&
+            !per_call_matches(&base, &cur, "cache"))
+            continue;
+        regressions += report(singles[i], b->vals[0], c->vals[0],
+            ig_opts->single_tolerance, 0);
+    }
+
+    b = doc_find(&base, "latency.max_ns");
+    c = doc_find(&cur, "latency.max_ns");
+    if(b && c && b->n == 1 && c->n == 1 &&
+        per_call_matches(&base, &cur, "latency"))
+        printf("latency.max_ns\t%.6g\t%.6g\t%+.2f\t-\tnot checked\n",
+            b->vals[0], c->vals[0],
+            b->vals[0] != 0 ? (c->vals[0] - b->vals[0])/b->vals[0]*100.0 : 0);
+
+    /* memory and instruction counts are (nearly) deterministic for a
+     * given configuration
+     */
+    for(i=0; sizes[i]; i++)
+    {
+        b = doc_find(&base, sizes[i]);
+        c = doc_find(&cur, sizes[i]);
+        if(b && c && b->n == 1 && c->n == 1)
+            regressions += report(sizes[i], b->vals[0], c->vals[0],
+                ig_opts->tolerance, 0);
+    }
+    for(i=0; shown[i]; i++)
+    {
+        b = doc_find(&base, shown[i]);
+        c = doc_find(&cur, shown[i]);
+        if(b && c && b->n == 1 && c->n == 1)
+            printf("%s\t%.6g\t%.6g\t%+.2f\t-\tnot checked\n", shown[i],
+                b->vals[0], c->vals[0], b->vals[0] != 0 ?
+                (c->vals[0] - b->vals[0])/b->vals[0]*100.0 : 0);
+    }
+
+    printf("# %d regression(s)\n", regressions);
+
+    return(regressions ? 1 : 0);
+}
+
+static int usage (char *exename)
+{
+    fprintf(stderr, "Usage: %s [options] <baseline.json> <current.json>\n", exename);
+    fprintf(stderr, "    -t <tolerance for throughput and memory, percent (default 5)>\n");
+    fprintf(stderr, "    -T <tolerance for latency, cache modes and construction time, percent\n"
+        "        (default 50)>\n");
+    fprintf(stderr, "    -k <standard errors of noise allowed on throughput (default 3)>\n");
+    fprintf(stderr, "  Inputs are written by ch-placement-benchmark -J.  Exits with 1 if\n");
+    fprintf(stderr, "  any metric regressed.\n");
+
+    /* not 1, which reports a regression */
+    exit(-1);
+}
+
+static struct options *parse_args(int argc, char *argv[])
+{
+    struct options *opts = NULL;
+    int ret = -1;
+    int one_opt = 0;
+
+    opts = (struct options*)malloc(sizeof(*opts));
+    if(!opts)
+        return(NULL);
+    memset(opts, 0, sizeof(*opts));
+    opts->tolerance = 5;
+    opts->single_tolerance = 50;
+    opts->sigmas = 3;
+
+    while((one_opt = getopt(argc, argv, "t:T:k:h")) != EOF)
+    {
+        switch(one_opt)
+        {
+            case 't':
+                ret = sscanf(optarg, "%lf", &opts->tolerance);
+                if(ret != 1)
+                    return(NULL);
+                break;
+            case 'T':
+                ret = sscanf(optarg, "%lf", &opts->single_tolerance);
+                if(ret != 1)
+                    return(NULL);
+                break;
+            case 'k':
+                ret = sscanf(optarg, "%lf", &opts->sigmas);
+                if(ret != 1)
+                    return(NULL);
+                break;
+            case '?':
+            case 'h':
+                usage(argv[0]);
+        }
+    }
+
+    if(argc - optind != 2)
+        return(NULL);
+    opts->baseline = argv[optind];
+    opts->current = argv[optind+1];
+    if(opts->tolerance < 0 || opts->single_tolerance < 0 || opts->sigmas < 0)
+        return(NULL);
+
+    return(opts);
+}
+
+/*
+ * Local variables:
+ *  c-indent-level: 4
+ *  c-basic-offset: 4
+ * End:
+ *
+ * vim: ft=c ts=8 sts=4 sw=4 expandtab
+ */
@@ -4,6 +4,8 @@
  *
  */
 
+#define _GNU_SOURCE
+
 #include <string.h>
 #include <assert.h>
 #include <stdio.h>
@@ -14,7 +16,12 @@
 #include <sys/stat.h>
 #include <fcntl.h>
 #include <limits.h>
+#include <math.h>
 #include <sys/time.h>
+#include <pthread.h>
+#ifdef _OPENMP
+#include <omp.h>
+#endif
 
 #include "ch-placement-oid-gen.h"
 #include "ch-placement.h"
@@ -22,23 +29,124 @@
 #include "ch-placement-crush.h"
 #endif
 #include "comb.h"
+#include "latency.h"
+#include "affinity.h"
+#include "perfctr.h"
 
 struct options
 {
     unsigned int num_servers;
-    unsigned int num_objs;
+    unsigned long num_objs;
     unsigned int replication;
     char* placement;
     unsigned int virt_factor;
     char* comb_name;
+    unsigned int key_len;
+    unsigned int batch;
+    int parallel;
+    unsigned int latency;
+    unsigned int sweep;
+    int affinity;
+    unsigned int flags;
+    unsigned int runs;
+    char* json_name;
+    char* csv_name;
+    int counters;
+    unsigned int cache_batch;
+    unsigned long chunk;
+    /* -s and -v may list several values, for a table sweep */
+    unsigned int *server_list;
+    unsigned int n_server_list;
+    unsigned int *virt_list;
+    unsigned int n_virt_list;
 };
 
-struct comb_stats {
-    unsigned long count;
-    unsigned long bytes;
+/* timed passes are repeated up to this many times (-n) */
+#define BENCH_MAX_RUNS 64
+
+/* objects generated at a time unless -G says otherwise */
+#define BENCH_DEFAULT_CHUNK (1UL<<20)
+
+/* cache behaviour modes (-w): tables left in cache, caches flushed by a
+ * scratch sweep before every batch, and several instances used in turn
+ */
+#define BENCH_CACHE_MODES 3
+static const char *cache_modes[BENCH_CACHE_MODES] = {"warm", "flush", "cycle"};
+/* flushing is slow; at most this many batches are measured with it */
+#define BENCH_CACHE_FLUSH_BATCHES 64
+/* at most this many instances are cycled */
+#define BENCH_CACHE_MAX_INSTANCES 64
+
+/* one measurement, repeated ig_opts->runs times */
+struct bench_metric
+{
+    unsigned int runs;              /* 0 if it was not measured */
+    unsigned int per_call;          /* oids (or key bytes) per call */
+    double time[BENCH_MAX_RUNS];    /* seconds per pass */
+};
+
+/* everything written by -J and -C */
+struct bench_results
+{
+    double construct_time;
+    int have_footprint;
+    struct ch_placement_footprint fp;
+    int have_stats;
+    struct ch_placement_stats stats;
+    struct bench_metric placement;
+    struct bench_metric batch;
+    struct bench_metric parallel;
+    struct bench_metric key_hash;
+    struct bench_metric key_place;
+    unsigned int latency_per_call;  /* 0 if latency was not measured */
+    unsigned long latency_calls;
+    double latency_ns[5];           /* p50, p90, p99, p99.9, max */
+    int have_counters;
+    struct perfctr_counts counters; /* one pass of ig_opts->num_objs lookups */
+    unsigned int cache_batch;       /* 0 if cache modes were not measured */
+    double cache_ns[BENCH_CACHE_MODES][2];  /* per lookup, random and sorted
+                                             * order; < 0 if not measured */
+};
+
+/* the object population, generated one chunk at a time so that memory
+ * use does not grow with the number of objects.  Every pass over the
+ * population restarts the stream, which yields the same objects again.
+ */
+struct bench_chunks
+{
+    struct oid_stream *stream;
+    struct obj *objs;
+    uint64_t *oids;             /* oids of objs[] */
+    unsigned long *server_idxs; /* replication entries per object */
+    unsigned long n;            /* objects in the current chunk */
 };
 
 static int comb_cmp (const void *a, const void *b);
+static void key_benchmark(struct options *ig_opts,
+    struct ch_placement_instance *instance, struct bench_results *res);
+static void batch_benchmark(struct options *ig_opts,
+    struct ch_placement_instance *instance, struct bench_chunks *chunks,
+    struct bench_results *res);
+static void parallel_benchmark(struct options *ig_opts,
+    struct ch_placement_instance *instance, struct bench_chunks *chunks,
+    struct bench_results *res);
+static void latency_benchmark(struct options *ig_opts,
+    struct ch_placement_instance *instance, struct bench_chunks *chunks,
+    struct bench_results *res);
+static void counters_benchmark(struct options *ig_opts,
+    struct ch_placement_instance *instance, struct bench_chunks *chunks,
+    struct bench_results *res);
+static void cache_benchmark(struct options *ig_opts,
+    struct ch_placement_instance *instance, struct bench_chunks *chunks,
+    struct bench_results *res);
+static void counters_pass(struct ch_placement_instance *instance,
+    const uint64_t *oids, unsigned long n, unsigned int replication,
+    unsigned long *server_idxs, struct perfctr_counts *total);
+static int bench_threads(void);
+static int write_json(struct options *ig_opts, struct bench_results *res);
+static int write_csv(struct options *ig_opts, struct bench_results *res);
+static int sweep_benchmark(struct options *ig_opts);
+static int table_benchmark(struct options *ig_opts);
 static int usage (char *exename);
 static struct options *parse_args(int argc, char *argv[]);
 
@@ -49,6 +157,86 @@ static double Wtime(void)
     return((double)t.tv_sec + (double)(t.tv_usec) / 1000000);
 }
 
+static double metric_mean_time(const struct bench_metric *m)
+{
+    double sum = 0;
+    unsigned int i;
+
+    for(i=0; i<m->runs; i++)
+        sum += m->time[i];
+    return(sum/m->runs);
+}
+
+/* mean and sample standard deviation of the per-pass rate */
+static double metric_rate(const struct bench_metric *m, unsigned long n,
+    double *stddev)
+{
+    double mean = 0, var = 0;
+    unsigned int i;
+
+    for(i=0; i<m->runs; i++)
+        mean += n/m->time[i];
+    mean /= m->runs;
+    for(i=0; i<m->runs; i++)
+        var += (n/m->time[i] - mean)*(n/m->time[i] - mean);
+    *stddev = m->runs > 1 ? sqrt(var/(m->runs-1)) : 0;
+
+    return(mean);
+}
+
+static void chunks_init(struct options *ig_opts, struct bench_chunks *chunks)
+{
+    memset(chunks, 0, sizeof(*chunks));
+    chunks->objs = malloc(ig_opts->chunk*sizeof(*chunks->objs));
+    chunks->oids = malloc(ig_opts->chunk*sizeof(*chunks->oids));
+    chunks->server_idxs = malloc(ig_opts->chunk*ig_opts->replication*
+        sizeof(*chunks->server_idxs));
+    assert(chunks->objs && chunks->oids && chunks->server_idxs);
+
+    return;
+}
+
+/* starts a pass over the population */
+static void chunks_begin(struct options *ig_opts, struct bench_chunks *chunks)
+{
+    if(chunks->stream)
+        oid_stream_finalize(chunks->stream, NULL, NULL, NULL);
+    chunks->stream = oid_stream_init("random", ig_opts->num_objs, ULONG_MAX,
+        8675309, ig_opts->replication, ig_opts->chunk, 0);
+    assert(chunks->stream);
+    chunks->n = 0;
+
+    return;
+}
+
+/* generates the next chunk; returns its length, 0 at the end of the pass */
+static unsigned long chunks_next(struct bench_chunks *chunks)
+{
+    unsigned long i;
+
+    chunks->n = oid_stream_next_batch(chunks->stream, chunks->objs);
+    for(i=0; i<chunks->n; i++)
+        chunks->oids[i] = chunks->objs[i].oid;
+    if(!chunks->n)
+    {
+        oid_stream_finalize(chunks->stream, NULL, NULL, NULL);
+        chunks->stream = NULL;
+    }
+
+    return(chunks->n);
+}
+
+static void chunks_free(struct bench_chunks *chunks)
+{
+    if(chunks->stream)
+        oid_stream_finalize(chunks->stream, NULL, NULL, NULL);
+    free(chunks->objs);
+    free(chunks->oids);
+    free(chunks->server_idxs);
+
+    return;
+}
+
 #ifdef CH_ENABLE_CRUSH
 #include <hash.h>
 static int setup_crush(struct options *ig_opts,
@@ -117,16 +305,17 @@ int main(
     char **argv)
 {
     struct options *ig_opts = NULL;
-    unsigned long total_byte_count = 0;
     unsigned long total_obj_count = 0;
-    struct obj* total_objs = NULL;
-    unsigned int i;
-    double t1, t2;
+    struct bench_chunks chunks;
+    unsigned long i;
+    unsigned int run;
+    double t1, t2, rate, stddev;
     struct ch_placement_instance *instance;
+    struct bench_results res;
     int fd;
-    struct comb_stats *cs;
+    struct comb_binom binom = {0};
+    struct comb_counts cs = {0};
     uint64_t num_combs;
-    unsigned long comb_tmp[CH_MAX_REPLICATION];
     int ret;
 #ifdef CH_ENABLE_CRUSH
     struct crush_map *map;
@@ -141,6 +330,13 @@ int main(
         return(-1);
     }
 
+    if(ig_opts->sweep)
+        return(sweep_benchmark(ig_opts));
+    if(ig_opts->n_server_list > 1 || ig_opts->n_virt_list > 1)
+        return(table_benchmark(ig_opts));
+
+    memset(&res, 0, sizeof(res));
+
     if (ig_opts->comb_name){
         /* set up state to count replica combinations and store results */
         fd = open(ig_opts->comb_name, O_WRONLY|O_CREAT|O_EXCL, 
@@ -150,15 +346,18 @@ int main(
             return(-1);
         }
         
-        num_combs = choose(ig_opts->num_servers, ig_opts->replication);
-        cs = calloc(num_combs, sizeof(*cs));
-        assert(cs);
+        ret = comb_binom_init(&binom, ig_opts->num_servers,
+                ig_opts->replication);
+        assert(ret == 0);
+        ret = comb_counts_init(&cs);
+        assert(ret == 0);
+        num_combs = comb_binom_get(&binom, ig_opts->num_servers,
+                ig_opts->replication);
         printf("# Total possible combinations for %u servers and %u replication: %lu\n",
                 ig_opts->num_servers, ig_opts->replication, num_combs);
-        printf("#  Combo state metrics consuming %lu MiB of memory\n", (num_combs*sizeof(*cs))/(1024*1024));
-
     }
 
+    t1 = Wtime();
     if(strcmp(ig_opts->placement, "crush") == 0 ||
        strcmp(ig_opts->placement, "crush-vring") == 0)
     {
@@ -177,67 +376,153 @@ int main(
     }
     else
     {
-        instance = ch_placement_initialize(ig_opts->placement, 
+        instance = ch_placement_initialize_flags(ig_opts->placement, 
             ig_opts->num_servers,
             ig_opts->virt_factor,
-            0);
+            0, ig_opts->flags);
     }
+    res.construct_time = Wtime() - t1;
 
-    /* generate random set of objects for testing */
-    printf("# Generating random object IDs...\n");
-    oid_gen("random", instance, ig_opts->num_objs, ULONG_MAX,
-        8675309, ig_opts->replication, ig_opts->num_servers,
-        NULL,
-        &total_byte_count, &total_obj_count, &total_objs);
-    printf("# Done.\n");
-    printf("#  Object population consuming approximately %lu MiB of memory.\n", (ig_opts->num_objs*sizeof(*total_objs))/(1024*1024));
-
-    assert(total_obj_count == ig_opts->num_objs);
+    /* random objects for testing, streamed in chunks by every pass */
+    chunks_init(ig_opts, &chunks);
+    printf("# Generating random object IDs in chunks of %lu objects...\n",
+        ig_opts->chunk);
+    printf("#  Object population consuming approximately %lu MiB of memory.\n",
+        (ig_opts->chunk*sizeof(*chunks.objs))/(1024*1024));
 
     sleep(1);
 
     printf("# Calculating placement for each object ID...\n");
-    /* run placement benchmark */
-    t1 = Wtime();
-#pragma omp parallel for
-    for(i=0; i<ig_opts->num_objs; i++)
-    {
-        ch_placement_find_closest(instance, total_objs[i].oid, ig_opts->replication, total_objs[i].server_idxs);
-        /* compute the index corresponding to this combination of servers */
-        if (ig_opts->comb_name){
-            memcpy(comb_tmp, total_objs[i].server_idxs, 
-                    ig_opts->replication*sizeof(*comb_tmp));
-            rev_ins_sort(ig_opts->replication, comb_tmp);
-            uint64_t idx = comb_index(ig_opts->replication, comb_tmp);
-            cs[idx].count++;
-            cs[idx].bytes += total_objs[i].size;
+    /* run placement benchmark; generating a chunk is not timed */
+    res.placement.per_call = 1;
+    for(run=0; run<ig_opts->runs; run++)
+    {
+        res.placement.time[res.placement.runs] = 0;
+        chunks_begin(ig_opts, &chunks);
+        while(chunks_next(&chunks))
+        {
+            t1 = Wtime();
+#pragma omp parallel
+            {
+                /* combinations are counted per thread and merged at the end */
+                struct comb_counts thread_cs = {0};
+                unsigned long comb_tmp[CH_MAX_REPLICATION];
+                int cs_ret;
+
+                if (ig_opts->comb_name){
+                    cs_ret = comb_counts_init(&thread_cs);
+                    assert(cs_ret == 0);
+                }
+
+#pragma omp for
+                for(i=0; i<chunks.n; i++)
+                {
+                    unsigned long wide_idxs[CH_MAX_REPLICATION];
+                    /* wide (erasure coded) layouts do not fit in the obj cache */
+                    unsigned long *server_idxs = (ig_opts->replication <= CH_OBJ_MAX_REPLICATION) ?
+                        chunks.objs[i].server_idxs : wide_idxs;
+
+                    ch_placement_find_closest(instance, chunks.objs[i].oid, ig_opts->replication, server_idxs);
+                    /* compute the index corresponding to this combination of servers */
+                    if (ig_opts->comb_name){
+                        memcpy(comb_tmp, server_idxs, 
+                                ig_opts->replication*sizeof(*comb_tmp));
+                        rev_ins_sort(ig_opts->replication, comb_tmp);
+                        uint64_t idx = comb_index(&binom, ig_opts->replication, comb_tmp);
+                        cs_ret = comb_counts_add(&thread_cs, idx, 1, chunks.objs[i].size);
+                        assert(cs_ret == 0);
+                    }
+                }
+
+                if (ig_opts->comb_name){
+#pragma omp critical
+                    {
+                        cs_ret = comb_counts_merge(&cs, &thread_cs);
+                        assert(cs_ret == 0);
+                    }
+                    comb_counts_free(&thread_cs);
+                }
+            }
+            t2 = Wtime();
+            res.placement.time[res.placement.runs] += t2-t1;
+            total_obj_count += chunks.n;
         }
+        res.placement.runs++;
     }
-    t2 = Wtime();
     printf("# Done.\n");
+    /* the stream totals are the same on every pass */
+    total_obj_count /= ig_opts->runs;
+    assert(total_obj_count == ig_opts->num_objs);
 
+    printf("# Scan kernels: %s\n", ch_placement_isa());
+    if(ch_placement_get_footprint(instance, &res.fp) == 0)
+    {
+        res.have_footprint = 1;
+        printf("# Table footprint: %zu bytes mapped, %zu used, %zu byte pages%s\n",
+            res.fp.bytes, res.fp.used, res.fp.page_size,
+            res.fp.transparent ? " (transparent huge pages requested)" : "");
+    }
+    if(ch_placement_get_stats(instance, &res.stats) == 0)
+    {
+        /* the library's own timing leaves out CRUSH map setup */
+        res.have_stats = 1;
+        res.construct_time = res.stats.construction_time;
+        printf("# Placement tables: %lu entries, %zu bytes in %d cop%s, built in %f s\n",
+            res.stats.entries, res.stats.bytes, res.stats.replicas,
+            res.stats.replicas == 1 ? "y" : "ies",
+            res.stats.construction_time);
+        printf("#  <table>\t<entries>\t<bytes>\n");
+        for(i=0; i<res.stats.n_tables; i++)
+            printf("#  %s\t%lu\t%zu\n", res.stats.tables[i].name,
+                res.stats.tables[i].entries, res.stats.tables[i].bytes);
+    }
+    else
+        printf("# Construction time: %f s\n", res.construct_time);
     if(!ig_opts->comb_name)
     {
+        /* with -n, the mean over the passes */
+        rate = metric_rate(&res.placement, ig_opts->num_objs, &stddev);
         printf("# <objects>\t<replication>\t<servers>\t<virt_factor>\t<algorithm>\t<time (s)>\t<rate oids/s>\n");
-        printf("%u\t%d\t%u\t%u\t%s\t%f\t%f\n",
+        printf("%lu\t%d\t%u\t%u\t%s\t%f\t%f\n",
             ig_opts->num_objs,
             ig_opts->replication,
             ig_opts->num_servers,
             ig_opts->virt_factor,
             ig_opts->placement,
-            t2-t1,
-            (double)ig_opts->num_objs/(t2-t1));
+            metric_mean_time(&res.placement),
+            rate);
+        if(ig_opts->runs > 1)
+            printf("# %u passes, rate standard deviation %f oids/s\n",
+                ig_opts->runs, stddev);
     }
     else
     {
         printf("# NOTE: computational performance not shown.\n");
         printf("#  Calculating combinations and outputing to %s.\n", ig_opts->comb_name);
+        /* counting the combinations makes the timing meaningless */
+        res.placement.runs = 0;
     }
 
-    /* we don't need the global list any more */
-    free(total_objs);
-    total_obj_count = 0;
-    total_byte_count = 0;
+    if(ig_opts->counters)
+        counters_benchmark(ig_opts, instance, &chunks, &res);
+    if(ig_opts->batch)
+        batch_benchmark(ig_opts, instance, &chunks, &res);
+    if(ig_opts->parallel)
+        parallel_benchmark(ig_opts, instance, &chunks, &res);
+    if(ig_opts->latency)
+        latency_benchmark(ig_opts, instance, &chunks, &res);
+    if(ig_opts->cache_batch)
+        cache_benchmark(ig_opts, instance, &chunks, &res);
+    if(ig_opts->key_len)
+        key_benchmark(ig_opts, instance, &res);
+
+    if(ig_opts->json_name && write_json(ig_opts, &res) < 0)
+        return(-1);
+    if(ig_opts->csv_name && write_csv(ig_opts, &res) < 0)
+        return(-1);
+
+    /* the object buffers are not needed any more */
+    chunks_free(&chunks);
 
     /* print out the counts of used combinations */
     if (ig_opts->comb_name){
@@ -245,27 +530,28 @@ int main(
         char *buf = malloc(sz);
         int written = 0;
         uint64_t total = 0;
-        uint64_t num_zeros;
+        uint64_t num_used = 0;
 
         printf("Sorting/writing server combinations\n");
-        qsort(cs, num_combs, sizeof(*cs), comb_cmp);
-
-        /* find the number of 0 entries - we aren't printing them */
-        for (num_zeros = 0;
-             cs[num_zeros].count == 0 && num_zeros < num_combs;
-             num_zeros++);
+        printf("#  %lu combinations used, counters consumed %lu MiB of memory\n",
+                cs.used, (cs.size*sizeof(*cs.slots))/(1024*1024));
+        /* only combinations that were used have a slot; pack them */
+        for (total = 0; total < cs.size; total++){
+            if (cs.slots[total].key)
+                cs.slots[num_used++] = cs.slots[total];
+        }
+        qsort(cs.slots, num_used, sizeof(*cs.slots), comb_cmp);
 
         /* print the header - the number of possible combinations and the
          * number of non-zero entries */
         written = snprintf(buf+written, sz, "%lu %lu\n", num_combs,
-                num_combs-num_zeros);
+                num_used);
         assert(written < sz);
 
-        /* start the counter where we left off */
-        total = num_zeros;
-        while (total < num_combs){
+        total = 0;
+        while (total < num_used){
             int w = snprintf(buf+written, sz-written, "%lu %lu\n", 
-                    cs[total].count, cs[total].bytes);
+                    cs.slots[total].count, cs.slots[total].bytes);
             if (w >= sz-written){
                 ret = write(fd, buf, written);
                 assert(ret == written);
@@ -281,6 +567,1032 @@ int main(
             assert(ret == written);
         }
         close(fd);
+        free(buf);
+        comb_counts_free(&cs);
+        comb_binom_free(&binom);
+    }
+
+    return(0);
+}
+
+struct sweep_arg
+{
+    struct ch_placement_instance *instance;
+    const uint64_t *oids;
+    unsigned long *server_idxs;
+    unsigned int replication;
+    unsigned long first;
+    unsigned long last;
+    int thread;
+    int policy;
+    const struct affinity_cpu *cpus;
+    int n_cpus;
+    pthread_barrier_t *barrier;
+    double start;
+    double end;
+};
+
+static void* sweep_thread(void *arg)
+{
+    struct sweep_arg *sa = arg;
+    unsigned long i;
+
+    affinity_pin(sa->policy, sa->cpus, sa->n_cpus, sa->thread);
+    pthread_barrier_wait(sa->barrier);
+    sa->start = Wtime();
+    for(i=sa->first; i<sa->last; i++)
+        ch_placement_find_closest(sa->instance, sa->oids[i], sa->replication,
+            &sa->server_idxs[i*sa->replication]);
+    sa->end = Wtime();
+
+    return(NULL);
+}
+
+/* times one pass over n oids with n_threads pinned threads, each taking
+ * an equal contiguous share, from the first thread starting to the last
+ * one finishing
+ */
+static double sweep_run(struct options *ig_opts,
+    struct ch_placement_instance *instance, const uint64_t *oids,
+    unsigned long n, unsigned long *server_idxs,
+    const struct affinity_cpu *cpus, int n_cpus, unsigned int n_threads)
+{
+    struct sweep_arg *args;
+    pthread_t *threads;
+    pthread_barrier_t barrier;
+    unsigned int t;
+    double t1, t2;
+
+    args = calloc(n_threads, sizeof(*args));
+    threads = calloc(n_threads, sizeof(*threads));
+    assert(args && threads);
+    pthread_barrier_init(&barrier, NULL, n_threads);
+
+    for(t=0; t<n_threads; t++)
+    {
+        args[t].instance = instance;
+        args[t].oids = oids;
+        args[t].server_idxs = server_idxs;
+        args[t].replication = ig_opts->replication;
+        args[t].first = n*t/n_threads;
+        args[t].last = n*(t+1)/n_threads;
+        args[t].thread = t;
+        args[t].policy = ig_opts->affinity;
+        args[t].cpus = cpus;
+        args[t].n_cpus = n_cpus;
+        args[t].barrier = &barrier;
+        pthread_create(&threads[t], NULL, sweep_thread, &args[t]);
+    }
+    for(t=0; t<n_threads; t++)
+        pthread_join(threads[t], NULL);
+    /* from the first thread to start to the last one to finish */
+    t1 = args[0].start;
+    t2 = args[0].end;
+    for(t=1; t<n_threads; t++)
+    {
+        if(args[t].start < t1)
+            t1 = args[t].start;
+        if(args[t].end > t2)
+            t2 = args[t].end;
+    }
+
+    pthread_barrier_destroy(&barrier);
+    free(args);
+    free(threads);
+
+    return(t2-t1);
+}
+
+/* times a pass over the whole population, one chunk at a time; only the
+ * lookups are timed
+ */
+static double sweep_pass(struct options *ig_opts,
+    struct ch_placement_instance *instance, struct bench_chunks *chunks,
+    const struct affinity_cpu *cpus, int n_cpus, unsigned int n_threads)
+{
+    double t = 0;
+
+    chunks_begin(ig_opts, chunks);
+    while(chunks_next(chunks))
+        t += sweep_run(ig_opts, instance, chunks->oids, chunks->n,
+            chunks->server_idxs, cpus, n_cpus, n_threads);
+
+    return(t);
+}
+
+/* runs the placement loop at 1, 2, 4, ... ig_opts->sweep threads for each
+ * module in the comma separated ig_opts->placement, and reports the
+ * scaling relative to one thread
+ */
+static int sweep_benchmark(struct options *ig_opts)
+{
+    struct ch_placement_instance *instance;
+    struct bench_chunks chunks;
+    struct affinity_cpu *cpus;
+    int n_cpus;
+    char *placements, *placement, *saveptr;
+    unsigned int n_threads;
+    double t, t_one;
+
+    cpus = affinity_topology(ig_opts->affinity, &n_cpus);
+    placements = strdup(ig_opts->placement);
+    assert(cpus && placements);
+    chunks_init(ig_opts, &chunks);
+
+    printf("# Thread sweep: %d usable CPUs, affinity %s\n", n_cpus,
+        affinity_names[ig_opts->affinity]);
+    printf("# <objects>\t<replication>\t<servers>\t<virt_factor>\t<algorithm>\t<threads>\t<time (s)>\t<rate oids/s>\t<speedup>\t<efficiency>\n");
+    for(placement = strtok_r(placements, ",", &saveptr); placement;
+        placement = strtok_r(NULL, ",", &saveptr))
+    {
+        instance = ch_placement_initialize_flags(placement,
+            ig_opts->num_servers, ig_opts->virt_factor, 0, ig_opts->flags);
+        if(!instance)
+        {
+            fprintf(stderr, "Error: failed to initialize %s\n", placement);
+            return(-1);
+        }
+
+        /* warm up caches and page tables before the first timed run */
+        sweep_pass(ig_opts, instance, &chunks, cpus, n_cpus, 1);
+
+        t_one = 0;
+        for(n_threads=1; ; n_threads*=2)
+        {
+            if(n_threads > ig_opts->sweep)
+                n_threads = ig_opts->sweep;
+            t = sweep_pass(ig_opts, instance, &chunks, cpus, n_cpus,
+                n_threads);
+            if(n_threads == 1)
+                t_one = t;
+            printf("%lu\t%d\t%u\t%u\t%s\t%u\t%f\t%f\t%f\t%f\n",
+                ig_opts->num_objs,
+                ig_opts->replication,
+                ig_opts->num_servers,
+                ig_opts->virt_factor,
+                placement,
+                n_threads,
+                t,
+                (double)ig_opts->num_objs/t,
+                t_one/t,
+                t_one/t/n_threads);
+            if(n_threads == ig_opts->sweep)
+                break;
+        }
+
+        ch_placement_finalize(instance);
+    }
+
+    free(cpus);
+    chunks_free(&chunks);
+    free(placements);
+
+    return(0);
+}
+
+/* builds an instance for every combination of the listed modules, server
+ * counts and virtual node factors, and reports the size and construction
+ * time of its tables next to its placement rate
+ */
+static int table_benchmark(struct options *ig_opts)
+{
+    struct ch_placement_instance *instance;
+    struct ch_placement_stats stats;
+    struct bench_chunks chunks;
+    char *placements, *placement, *saveptr;
+    unsigned int s, v;
+    unsigned long i;
+    double t, t1;
+    struct perfctr_counts counts;
+
+    placements = strdup(ig_opts->placement);
+    assert(placements);
+    chunks_init(ig_opts, &chunks);
+
+    printf("# <objects>\t<replication>\t<servers>\t<virt_factor>\t<algorithm>\t<entries>\t<table bytes>\t<construction (s)>\t<time (s)>\t<rate oids/s>%s\n",
+        ig_opts->counters ? PERFCTR_HEADER : "");
+    for(placement = strtok_r(placements, ",", &saveptr); placement;
+        placement = strtok_r(NULL, ",", &saveptr))
+    {
+        for(s=0; s<ig_opts->n_server_list; s++)
+        {
+            for(v=0; v<ig_opts->n_virt_list; v++)
+            {
+                instance = ch_placement_initialize_flags(placement,
+                    ig_opts->server_list[s], ig_opts->virt_list[v], 0,
+                    ig_opts->flags);
+                if(!instance)
+                {
+                    fprintf(stderr, "Error: failed to initialize %s\n",
+                        placement);
+                    return(-1);
+                }
+                if(ch_placement_get_stats(instance, &stats) != 0)
+                    memset(&stats, 0, sizeof(stats));
+
+                t = 0;
+                chunks_begin(ig_opts, &chunks);
+                while(chunks_next(&chunks))
+                {
+                    t1 = Wtime();
+#pragma omp parallel for
+                    for(i=0; i<chunks.n; i++)
+                        ch_placement_find_closest(instance, chunks.oids[i],
+                            ig_opts->replication,
+                            &chunks.server_idxs[i*ig_opts->replication]);
+                    t += Wtime() - t1;
+                }
+
+                printf("%lu\t%d\t%u\t%u\t%s\t%lu\t%zu\t%f\t%f\t%f",
+                    ig_opts->num_objs,
+                    ig_opts->replication,
+                    ig_opts->server_list[s],
+                    ig_opts->virt_list[v],
+                    placement,
+                    stats.entries,
+                    stats.bytes,
+                    stats.construction_time,
+                    t,
+                    (double)ig_opts->num_objs/t);
+                if(ig_opts->counters)
+                {
+                    /* per lookup, from a separate pass */
+                    memset(&counts, 0, sizeof(counts));
+                    chunks_begin(ig_opts, &chunks);
+                    while(chunks_next(&chunks))
+                        counters_pass(instance, chunks.oids, chunks.n,
+                            ig_opts->replication, chunks.server_idxs, &counts);
+                    perfctr_print(stdout, &counts, ig_opts->num_objs);
+                }
+                printf("\n");
+
+                ch_placement_finalize(instance);
+            }
+        }
+    }
+
+    chunks_free(&chunks);
+    free(placements);
+
+    return(0);
+}
+
+/* places oids once more, with hardware counters running on every thread
+ * for exactly its share of the loop.  The pass is separate from the timed
+ * ones so that opening and reading the counters does not show in their
+ * times.
+ */
+static void counters_pass(struct ch_placement_instance *instance,
+    const uint64_t *oids, unsigned long n, unsigned int replication,
+    unsigned long *server_idxs, struct perfctr_counts *total)
+{
+    unsigned long i;
+
+#pragma omp parallel
+    {
+        struct perfctr pc;
+        struct perfctr_counts thread_counts;
+        int have_pc;
+
+        memset(&thread_counts, 0, sizeof(thread_counts));
+        have_pc = (perfctr_open(&pc) == 0);
+        if(have_pc)
+            perfctr_start(&pc);
+        else
+            thread_counts.error = errno;
+
+        /* no barrier: threads that finish early must not count the wait */
+#pragma omp for nowait
+        for(i=0; i<n; i++)
+            ch_placement_find_closest(instance, oids[i], replication,
+                &server_idxs[i*replication]);
+
+        if(have_pc)
+        {
+            perfctr_stop(&pc, &thread_counts);
+            perfctr_close(&pc);
+        }
+#pragma omp critical
+        perfctr_merge(total, &thread_counts);
+    }
+
+    return;
+}
+
+/* reports hardware counters per lookup for the placement loop */
+static void counters_benchmark(struct options *ig_opts,
+    struct ch_placement_instance *instance, struct bench_chunks *chunks,
+    struct bench_results *res)
+{
+    memset(&res->counters, 0, sizeof(res->counters));
+    chunks_begin(ig_opts, chunks);
+    while(chunks_next(chunks))
+        counters_pass(instance, chunks->oids, chunks->n, ig_opts->replication,
+            chunks->server_idxs, &res->counters);
+
+    if(!res->counters.valid)
+        printf("# Hardware counters not available: %s\n",
+            strerror(res->counters.error));
+    else
+    {
+        res->have_counters = 1;
+        printf("# Hardware counters per lookup, %d thread(s), user space only\n",
+            bench_threads());
+        printf("# <algorithm>%s\n", PERFCTR_HEADER);
+        printf("%s", ig_opts->placement);
+        perfctr_print(stdout, &res->counters, ig_opts->num_objs);
+        printf("\n");
+    }
+
+    return;
+}
+
+/* ascending oid order, which is ring order for the ring modules */
+static int oid_cmp(const void *a, const void *b)
+{
+    uint64_t x = *(const uint64_t*)a, y = *(const uint64_t*)b;
+
+    return(x < y ? -1 : x > y);
+}
+
+/* size of the last level cache, or a guess if the system does not say */
+static size_t bench_llc_bytes(void)
+{
+    long llc = -1;
+
+#ifdef _SC_LEVEL3_CACHE_SIZE
+    llc = sysconf(_SC_LEVEL3_CACHE_SIZE);
+    if(llc <= 0)
+        llc = sysconf(_SC_LEVEL2_CACHE_SIZE);
+#endif
+    if(llc <= 0)
+        llc = 32*1024*1024;
+    return((size_t)llc);
+}
+
+/* progress of one cache mode over the chunks of a pass */
+struct cache_acc
+{
+    unsigned long batch;
+    unsigned long lookups;
+    uint64_t ticks;
+};
+
+/* looks up n oids in batches of ig_opts->cache_batch, each batch on the
+ * next of the n_instances instances.  If scratch is given it is swept
+ * before every batch, and no more than BENCH_CACHE_FLUSH_BATCHES batches
+ * are run in the whole pass.  Only the lookups are timed.
+ */
+static void cache_pass(struct options *ig_opts,
+    struct ch_placement_instance **instances, unsigned int n_instances,
+    const uint64_t *oids, unsigned long n, unsigned long *server_idxs,
+    volatile unsigned char *scratch, size_t scratch_bytes,
+    struct cache_acc *acc)
+{
+    unsigned long i, j, len;
+    uint64_t t1;
+    size_t k;
+
+    for(i=0; i<n; i+=ig_opts->cache_batch, acc->batch++)
+    {
+        if(scratch)
+        {
+            if(acc->batch == BENCH_CACHE_FLUSH_BATCHES)
+                break;
+            /* dirty every line so that it has to be written back */
+            for(k=0; k<scratch_bytes; k+=64)
+                scratch[k]++;
+        }
+        len = n - i;
+        if(len > ig_opts->cache_batch)
+            len = ig_opts->cache_batch;
+        t1 = latency_ticks();
+        for(j=i; j<i+len; j++)
+            ch_placement_find_closest(instances[acc->batch % n_instances],
+                oids[j], ig_opts->replication,
+                &server_idxs[j*ig_opts->replication]);
+        acc->ticks += latency_ticks() - t1;
+        acc->lookups += len;
+    }
+
+    return;
+}
+
+/* measures lookups with the tables in and out of cache, with the oids in
+ * random and in sorted order (sorted within each chunk).  Runs on one
+ * thread, so that the flush really empties the caches the lookups use.
+ */
+static void cache_benchmark(struct options *ig_opts,
+    struct ch_placement_instance *instance, struct bench_chunks *chunks,
+    struct bench_results *res)
+{
+    struct ch_placement_instance *instances[BENCH_CACHE_MAX_INSTANCES];
+    struct cache_acc acc[BENCH_CACHE_MODES][2];
+    unsigned int n_instances = 0;
+    unsigned char *scratch;
+    size_t llc, scratch_bytes, table_bytes;
+    double ns_per_tick;
+    unsigned long i;
+    int mode, order;
+
+    llc = bench_llc_bytes();
+    scratch_bytes = 2*llc;
+    scratch = calloc(scratch_bytes, 1);
+    assert(scratch);
+    memset(acc, 0, sizeof(acc));
+
+    /* enough identical instances that together they do not fit in the
+     * last level cache twice over; CRUSH maps are not rebuilt
+     */
+    table_bytes = res->have_stats && res->stats.bytes ? res->stats.bytes : llc;
+    if(strcmp(ig_opts->placement, "crush") != 0 &&
+       strcmp(ig_opts->placement, "crush-vring") != 0)
+    {
+        n_instances = 2*llc/table_bytes + 1;
+        if(n_instances < 2)
+            n_instances = 2;
+        if(n_instances > BENCH_CACHE_MAX_INSTANCES)
+            n_instances = BENCH_CACHE_MAX_INSTANCES;
+        for(i=0; i<n_instances; i++)
+        {
+            instances[i] = ch_placement_initialize_flags(ig_opts->placement,
+                ig_opts->num_servers, ig_opts->virt_factor, 0,
+                ig_opts->flags);
+            assert(instances[i]);
+        }
+    }
+
+    ns_per_tick = latency_calibrate();
+    chunks_begin(ig_opts, chunks);
+    while(chunks_next(chunks))
+    {
+        for(order=0; order<2; order++)
+        {
+            if(order)
+                qsort(chunks->oids, chunks->n, sizeof(*chunks->oids), oid_cmp);
+            cache_pass(ig_opts, &instance, 1, chunks->oids, chunks->n,
+                chunks->server_idxs, NULL, 0, &acc[0][order]);
+            cache_pass(ig_opts, &instance, 1, chunks->oids, chunks->n,
+                chunks->server_idxs, scratch, scratch_bytes, &acc[1][order]);
+            if(n_instances)
+                cache_pass(ig_opts, instances, n_instances, chunks->oids,
+                    chunks->n, chunks->server_idxs, NULL, 0, &acc[2][order]);
+        }
+    }
+
+    res->cache_batch = ig_opts->cache_batch;
+    for(mode=0; mode<BENCH_CACHE_MODES; mode++)
+    {
+        for(order=0; order<2; order++)
+        {
+            if(acc[mode][order].lookups)
+                res->cache_ns[mode][order] = acc[mode][order].ticks*
+                    ns_per_tick/acc[mode][order].lookups;
+            else
+                res->cache_ns[mode][order] = -1;
+        }
+    }
+
+    printf("# Cache behaviour: one thread, %u oids per batch, %zu byte last level cache, %zu byte flush, %u instances cycled\n",
+        ig_opts->cache_batch, llc, scratch_bytes, n_instances);
+    printf("# <cache>\t<order>\t<ns per lookup>\t<rate oids/s>\n");
+    for(mode=0; mode<BENCH_CACHE_MODES; mode++)
+    {
+        for(order=0; order<2; order++)
+        {
+            if(res->cache_ns[mode][order] < 0)
+                continue;
+            printf("%s\t%s\t%f\t%f\n", cache_modes[mode],
+                order ? "sorted" : "random", res->cache_ns[mode][order],
+                1e9/res->cache_ns[mode][order]);
+        }
+    }
+
+    for(i=0; i<n_instances; i++)
+        ch_placement_finalize(instances[i]);
+    free(scratch);
+
+    return;
+}
+
+/* places the same objects again through the batch interface, batch oids
+ * per call
+ */
+static void batch_benchmark(struct options *ig_opts,
+    struct ch_placement_instance *instance, struct bench_chunks *chunks,
+    struct bench_results *res)
+{
+    unsigned long i, n;
+    unsigned int run;
+    double t1, t2, rate, stddev;
+
+    res->batch.per_call = ig_opts->batch;
+    for(run=0; run<ig_opts->runs; run++)
+    {
+        res->batch.time[res->batch.runs] = 0;
+        chunks_begin(ig_opts, chunks);
+        while(chunks_next(chunks))
+        {
+            t1 = Wtime();
+#pragma omp parallel for private(n)
+            for(i=0; i<chunks->n; i+=ig_opts->batch)
+            {
+                n = chunks->n - i;
+                if(n > ig_opts->batch)
+                    n = ig_opts->batch;
+                ch_placement_find_closest_batch(instance, n, &chunks->oids[i],
+                    ig_opts->replication,
+                    &chunks->server_idxs[i*ig_opts->replication]);
+            }
+            t2 = Wtime();
+            res->batch.time[res->batch.runs] += t2-t1;
+        }
+        res->batch.runs++;
+    }
+    rate = metric_rate(&res->batch, ig_opts->num_objs, &stddev);
+
+    printf("# <objects>\t<batch size>\t<batch time (s)>\t<rate oids/s>\n");
+    printf("%lu\t%u\t%f\t%f\n",
+        ig_opts->num_objs,
+        ig_opts->batch,
+        metric_mean_time(&res->batch),
+        rate);
+
+    return;
+}
+
+/* places the same objects again in one call to the library's own thread
+ * pool
+ */
+static void parallel_benchmark(struct options *ig_opts,
+    struct ch_placement_instance *instance, struct bench_chunks *chunks,
+    struct bench_results *res)
+{
+    unsigned int run;
+    double t1, t2, rate, stddev;
+
+    /* the first call starts the pool; keep that out of the timing */
+    chunks_begin(ig_opts, chunks);
+    chunks_next(chunks);
+    ch_placement_find_closest_parallel(instance, 1, chunks->oids,
+        ig_opts->replication, chunks->server_idxs);
+
+    /* one call per chunk */
+    res->parallel.per_call = ig_opts->chunk;
+    for(run=0; run<ig_opts->runs; run++)
+    {
+        res->parallel.time[res->parallel.runs] = 0;
+        chunks_begin(ig_opts, chunks);
+        while(chunks_next(chunks))
+        {
+            t1 = Wtime();
+            ch_placement_find_closest_parallel(instance, chunks->n,
+                chunks->oids, ig_opts->replication, chunks->server_idxs);
+            t2 = Wtime();
+            res->parallel.time[res->parallel.runs] += t2-t1;
+        }
+        res->parallel.runs++;
+    }
+    rate = metric_rate(&res->parallel, ig_opts->num_objs, &stddev);
+
+    printf("# <objects>\t<parallel time (s)>\t<rate oids/s>\n");
+    printf("%lu\t%f\t%f\n",
+        ig_opts->num_objs,
+        metric_mean_time(&res->parallel),
+        rate);
+
+    return;
+}
+
+/* times every lookup call (one oid, or a batch of ig_opts->latency oids)
+ * and reports percentiles of the per-call latency.  Each thread fills its
+ * own histogram; they are merged at the end.
+ */
+static void latency_benchmark(struct options *ig_opts,
+    struct ch_placement_instance *instance, struct bench_chunks *chunks,
+    struct bench_results *res)
+{
+    struct latency_hist *total;
+    const uint64_t *oids;
+    unsigned long *server_idxs;
+    unsigned long num_oids;
+    double ns_per_tick;
+    uint64_t overhead = UINT64_MAX;
+    uint64_t t;
+    unsigned long i;
+
+    total = malloc(sizeof(*total));
+    assert(total);
+    latency_hist_init(total);
+
+    ns_per_tick = latency_calibrate();
+    /* cost of the timestamps themselves, which is included in every
+     * sample
+     */
+    for(i=0; i<1000; i++)
+    {
+        t = latency_ticks();
+        t = latency_ticks() - t;
+        if(t < overhead)
+            overhead = t;
+    }
+
+    chunks_begin(ig_opts, chunks);
+    while(chunks_next(chunks))
+    {
+        oids = chunks->oids;
+        server_idxs = chunks->server_idxs;
+        num_oids = chunks->n;
+#pragma omp parallel private(i)
+        {
+            struct latency_hist *hist = malloc(sizeof(*hist));
+            unsigned long n;
+            uint64_t t1, t2;
+
+            assert(hist);
+            latency_hist_init(hist);
+#pragma omp for
+            for(i=0; i<num_oids; i+=ig_opts->latency)
+            {
+                n = num_oids - i;
+                if(n > ig_opts->latency)
+                    n = ig_opts->latency;
+                t1 = latency_ticks();
+                if(ig_opts->latency == 1)
+                    ch_placement_find_closest(instance, oids[i],
+                        ig_opts->replication,
+                        &server_idxs[i*ig_opts->replication]);
+                else
+                    ch_placement_find_closest_batch(instance, n, &oids[i],
+                        ig_opts->replication,
+                        &server_idxs[i*ig_opts->replication]);
+                t2 = latency_ticks();
+                latency_hist_add(hist, t2-t1);
+            }
+#pragma omp critical
+            latency_hist_merge(total, hist);
+            free(hist);
+        }
+    }
+
+    res->latency_per_call = ig_opts->latency;
+    res->latency_calls = total->count;
+    res->latency_ns[0] = latency_hist_quantile(total, 0.5)*ns_per_tick;
+    res->latency_ns[1] = latency_hist_quantile(total, 0.9)*ns_per_tick;
+    res->latency_ns[2] = latency_hist_quantile(total, 0.99)*ns_per_tick;
+    res->latency_ns[3] = latency_hist_quantile(total, 0.999)*ns_per_tick;
+    res->latency_ns[4] = total->max*ns_per_tick;
+
+    printf("# Latency per call of %u oid(s), %lu calls, timer %s, %.1f ns timer overhead included\n",
+        ig_opts->latency, (unsigned long)total->count, LATENCY_TIMER,
+        overhead*ns_per_tick);
+    printf("# <algorithm>\t<p50 (ns)>\t<p90 (ns)>\t<p99 (ns)>\t<p99.9 (ns)>\t<max (ns)>\n");
+    printf("%s\t%.0f\t%.0f\t%.0f\t%.0f\t%.0f\n",
+        ig_opts->placement,
+        res->latency_ns[0],
+        res->latency_ns[1],
+        res->latency_ns[2],
+        res->latency_ns[3],
+        res->latency_ns[4]);
+
+    free(total);
+
+    return;
+}
+
+/* measures hashing and placement of byte string keys of the requested
+ * length, separately and combined through the batch key interface
+ */
+static void key_benchmark(struct options *ig_opts,
+    struct ch_placement_instance *instance, struct bench_results *res)
+{
+    struct ch_placement_rng rng;
+    unsigned char *key_buf;
+    const void **keys;
+    size_t *key_lens;
+    unsigned long *server_idxs;
+    uint64_t sum = 0;
+    uint64_t rnd;
+    size_t key_bytes;
+    unsigned long i, j, n, done;
+    unsigned int run;
+    double t1, t2, t3, hash_rate, place_rate, stddev;
+
+    /* like the oids, the keys are generated (untimed) one chunk at a time */
+    key_buf = malloc((size_t)ig_opts->chunk*ig_opts->key_len);
+    keys = malloc((size_t)ig_opts->chunk*sizeof(*keys));
+    key_lens = malloc((size_t)ig_opts->chunk*sizeof(*key_lens));
+    server_idxs = malloc((size_t)ig_opts->chunk*ig_opts->replication*
+        sizeof(*server_idxs));
+    assert(key_buf && keys && key_lens && server_idxs);
+    for(i=0; i<ig_opts->chunk; i++)
+    {
+        keys[i] = &key_buf[i*ig_opts->key_len];
+        key_lens[i] = ig_opts->key_len;
+    }
+
+    printf("# Generating %lu random %u byte keys in chunks of %lu...\n",
+        ig_opts->num_objs, ig_opts->key_len, ig_opts->chunk);
+
+    res->key_hash.per_call = ig_opts->key_len;
+    res->key_place.per_call = ig_opts->key_len;
+    for(run=0; run<ig_opts->runs; run++)
+    {
+        res->key_hash.time[res->key_hash.runs] = 0;
+        res->key_place.time[res->key_place.runs] = 0;
+        /* every pass sees the same keys */
+        ch_placement_rng_seed(&rng, 8675309);
+        for(done=0; done<ig_opts->num_objs; done+=n)
+        {
+            n = ig_opts->num_objs - done;
+            if(n > ig_opts->chunk)
+                n = ig_opts->chunk;
+            key_bytes = (size_t)n*ig_opts->key_len;
+            for(i=0; i<key_bytes; i+=sizeof(rnd))
+            {
+                rnd = ch_placement_rng_next(&rng);
+                for(j=0; j<sizeof(rnd) && i+j<key_bytes; j++)
+                    key_buf[i+j] = (unsigned char)(rnd >> (8*j));
+            }
+
+            t1 = Wtime();
+            for(i=0; i<n; i++)
+                sum += ch_placement_hash_key(keys[i], key_lens[i]);
+            t2 = Wtime();
+            ch_placement_find_closest_key_batch(instance, n, keys, key_lens,
+                ig_opts->replication, server_idxs);
+            t3 = Wtime();
+            res->key_hash.time[res->key_hash.runs] += t2-t1;
+            res->key_place.time[res->key_place.runs] += t3-t2;
+        }
+        res->key_hash.runs++;
+        res->key_place.runs++;
+    }
+    hash_rate = metric_rate(&res->key_hash, ig_opts->num_objs, &stddev);
+    place_rate = metric_rate(&res->key_place, ig_opts->num_objs, &stddev);
+
+    /* keep the hash loop from being optimized away */
+    if(sum == 0)
+        printf("# (all keys hashed to zero)\n");
+
+    printf("# <objects>\t<key bytes>\t<hash time (s)>\t<rate keys/s>\t<key placement time (s)>\t<rate keys/s>\n");
+    printf("%lu\t%u\t%f\t%f\t%f\t%f\n",
+        ig_opts->num_objs,
+        ig_opts->key_len,
+        metric_mean_time(&res->key_hash),
+        hash_rate,
+        metric_mean_time(&res->key_place),
+        place_rate);
+
+    free(key_buf);
+    free(keys);
+    free(key_lens);
+    free(server_idxs);
+
+    return;
+}
+
+/* number of threads the placement loops run on */
+static int bench_threads(void)
+{
+#ifdef _OPENMP
+    return(omp_get_max_threads());
+#else
+    return(1);
+#endif
+}
+
+static void json_string(FILE *f, const char *str)
+{
+    fputc('"', f);
+    for(; *str; str++)
+    {
+        if(*str == '"' || *str == '\\')
+            fputc('\\', f);
+        fputc(*str, f);
+    }
+    fputc('"', f);
+}
+
+static void json_metric(FILE *f, const char *name, const char *per_call_name,
+    const struct bench_metric *m, unsigned long n, int *first)
+{
+    double rate, stddev;
+    unsigned int i;
+
+    if(!m->runs)
+        return;
+    rate = metric_rate(m, n, &stddev);
+    fprintf(f, "%s\n    \"%s\": {\n", *first ? "" : ",", name);
+    fprintf(f, "      \"%s\": %u,\n", per_call_name, m->per_call);
+    fprintf(f, "      \"time\": %.9g,\n", metric_mean_time(m));
+    fprintf(f, "      \"rate\": %.9g,\n", rate);
+    fprintf(f, "      \"stddev\": %.9g,\n", stddev);
+    fprintf(f, "      \"samples\": [");
+    for(i=0; i<m->runs; i++)
+        fprintf(f, "%s%.9g", i ? ", " : "", n/m->time[i]);
+    fprintf(f, "]\n    }");
+    *first = 0;
+
+    return;
+}
+
+/* writes the configuration and results as one JSON object, the input of
+ * ch-placement-bench-compare.  Rates are per second; each metric keeps
+ * the rate of every pass in "samples".
+ */
+static int write_json(struct options *ig_opts, struct bench_results *res)
+{
+    FILE *f;
+    char host[256];
+    int first = 1;
+    int i;
+
+    f = fopen(ig_opts->json_name, "w");
+    if(!f)
+    {
+        perror(ig_opts->json_name);
+        return(-1);
+    }
+    if(gethostname(host, sizeof(host)) != 0)
+        strcpy(host, "unknown");
+    host[sizeof(host)-1] = '\0';
+
+    fprintf(f, "{\n");
+    fprintf(f, "  \"benchmark\": \"ch-placement-benchmark\",\n");
+    fprintf(f, "  \"config\": {\n");
+    fprintf(f, "    \"algorithm\": ");
+    json_string(f, ig_opts->placement);
+    fprintf(f, ",\n");
+    fprintf(f, "    \"objects\": %lu,\n", ig_opts->num_objs);
+    fprintf(f, "    \"replication\": %u,\n", ig_opts->replication);
+    fprintf(f, "    \"servers\": %u,\n", ig_opts->num_servers);
+    fprintf(f, "    \"virt_factor\": %u,\n", ig_opts->virt_factor);
+    fprintf(f, "    \"numa_replicate\": %d,\n",
+        (ig_opts->flags & CH_PLACEMENT_NUMA_REPLICATE) ? 1 : 0);
+    fprintf(f, "    \"runs\": %u,\n", ig_opts->runs);
+    fprintf(f, "    \"threads\": %d,\n", bench_threads());
+    fprintf(f, "    \"isa\": ");
+    json_string(f, ch_placement_isa());
+    fprintf(f, ",\n");
+    fprintf(f, "    \"host\": ");
+    json_string(f, host);
+    fprintf(f, "\n  },\n");
+    fprintf(f, "  \"construction_time\": %.9g,\n", res->construct_time);
+    if(res->have_footprint)
+        fprintf(f, "  \"memory\": {\"bytes\": %zu, \"used\": %zu, \"page_size\": %zu, \"transparent\": %d},\n",
+            res->fp.bytes, res->fp.used, res->fp.page_size,
+            res->fp.transparent);
+    if(res->have_stats)
+        fprintf(f, "  \"tables\": {\"entries\": %lu, \"bytes\": %zu, \"replicas\": %d},\n",
+            res->stats.entries, res->stats.bytes, res->stats.replicas);
+    if(res->latency_per_call)
+        fprintf(f, "  \"latency\": {\"oids_per_call\": %u, \"calls\": %lu, \"p50_ns\": %.0f, \"p90_ns\": %.0f, \"p99_ns\": %.0f, \"p999_ns\": %.0f, \"max_ns\": %.0f},\n",
+            res->latency_per_call, res->latency_calls, res->latency_ns[0],
+            res->latency_ns[1], res->latency_ns[2], res->latency_ns[3],
+            res->latency_ns[4]);
+    if(res->cache_batch)
+    {
+        fprintf(f, "  \"cache\": {\"oids_per_call\": %u", res->cache_batch);
+        for(i=0; i<BENCH_CACHE_MODES; i++)
+        {
+            if(res->cache_ns[i][0] >= 0)
+                fprintf(f, ", \"%s_random_ns\": %.1f, \"%s_sorted_ns\": %.1f",
+                    cache_modes[i], res->cache_ns[i][0], cache_modes[i],
+                    res->cache_ns[i][1]);
+        }
+        fprintf(f, "},\n");
+    }
+    if(res->have_counters)
+    {
+        /* per lookup; events that could not be counted are left out */
+        fprintf(f, "  \"counters\": {");
+        for(i=0; i<PERFCTR_EVENTS; i++)
+        {
+            if(perfctr_per(&res->counters, i, ig_opts->num_objs) < 0)
+                continue;
+            fprintf(f, "%s\"%s\": %.9g", first ? "" : ", ", perfctr_name(i),
+                perfctr_per(&res->counters, i, ig_opts->num_objs));
+            first = 0;
+        }
+        fprintf(f, "},\n");
+        first = 1;
+    }
+    fprintf(f, "  \"metrics\": {");
+    json_metric(f, "placement", "oids_per_call", &res->placement,
+        ig_opts->num_objs, &first);
+    json_metric(f, "batch", "oids_per_call", &res->batch,
+        ig_opts->num_objs, &first);
+    json_metric(f, "parallel", "oids_per_call", &res->parallel,
+        ig_opts->num_objs, &first);
+    json_metric(f, "key_hash", "key_bytes", &res->key_hash,
+        ig_opts->num_objs, &first);
+    json_metric(f, "key_placement", "key_bytes", &res->key_place,
+        ig_opts->num_objs, &first);
+    fprintf(f, "\n  }\n}\n");
+
+    if(fclose(f) != 0)
+    {
+        perror(ig_opts->json_name);
+        return(-1);
+    }
+
+    return(0);
+}
+
+static void csv_metric(FILE *f, const struct bench_metric *m, unsigned long n)
+{
+    double rate, stddev;
+
+    if(!m->runs)
+    {
+        fprintf(f, ",,,");
+        return;
+    }
+    rate = metric_rate(m, n, &stddev);
+    fprintf(f, ",%.9g,%.9g,%.9g", metric_mean_time(m), rate, stddev);
+
+    return;
+}
+
+/* appends one row of results to a CSV file, writing the header first if
+ * the file is new, so that repeated runs accumulate in one table.  Columns
+ * of measurements that were not taken are left empty.
+ */
+static int write_csv(struct options *ig_opts, struct bench_results *res)
+{
+    FILE *f;
+    int i;
+
+    f = fopen(ig_opts->csv_name, "a");
+    if(!f)
+    {
+        perror(ig_opts->csv_name);
+        return(-1);
+    }
+    if(ftell(f) == 0)
+        fprintf(f, "algorithm,objects,replication,servers,virt_factor,numa_replicate,runs,threads,isa,"
+            "construction_time,memory_bytes,memory_used,page_size,table_entries,table_bytes,"
+            "placement_time,placement_rate,placement_stddev,"
+            "batch_size,batch_time,batch_rate,batch_stddev,"
+            "parallel_time,parallel_rate,parallel_stddev,"
+            "key_bytes,key_hash_time,key_hash_rate,key_hash_stddev,"
+            "key_placement_time,key_placement_rate,key_placement_stddev,"
+            "latency_oids_per_call,p50_ns,p90_ns,p99_ns,p999_ns,max_ns,"
+            "cycles,instructions,llc_misses,dtlb_misses,branch_misses\n");
+
+    fprintf(f, "%s,%lu,%u,%u,%u,%d,%u,%d,%s,%.9g",
+        ig_opts->placement, ig_opts->num_objs, ig_opts->replication,
+        ig_opts->num_servers, ig_opts->virt_factor,
+        (ig_opts->flags & CH_PLACEMENT_NUMA_REPLICATE) ? 1 : 0,
+        ig_opts->runs, bench_threads(), ch_placement_isa(),
+        res->construct_time);
+    if(res->have_footprint)
+        fprintf(f, ",%zu,%zu,%zu", res->fp.bytes, res->fp.used,
+            res->fp.page_size);
+    else
+        fprintf(f, ",,,");
+    if(res->have_stats)
+        fprintf(f, ",%lu,%zu", res->stats.entries, res->stats.bytes);
+    else
+        fprintf(f, ",,");
+    csv_metric(f, &res->placement, ig_opts->num_objs);
+    if(res->batch.runs)
+        fprintf(f, ",%u", res->batch.per_call);
+    else
+        fprintf(f, ",");
+    csv_metric(f, &res->batch, ig_opts->num_objs);
+    csv_metric(f, &res->parallel, ig_opts->num_objs);
+    if(res->key_hash.runs)
+        fprintf(f, ",%u", res->key_hash.per_call);
+    else
+        fprintf(f, ",");
+    csv_metric(f, &res->key_hash, ig_opts->num_objs);
+    csv_metric(f, &res->key_place, ig_opts->num_objs);
+    if(res->latency_per_call)
+    {
+        fprintf(f, ",%u", res->latency_per_call);
+        for(i=0; i<5; i++)
+            fprintf(f, ",%.0f", res->latency_ns[i]);
+    }
+    else
+        fprintf(f, ",,,,,,");
+    /* per lookup */
+    for(i=0; i<PERFCTR_EVENTS; i++)
+    {
+        if(res->have_counters &&
+            perfctr_per(&res->counters, i, ig_opts->num_objs) >= 0)
+            fprintf(f, ",%.9g", perfctr_per(&res->counters, i,
+                ig_opts->num_objs));
+        else
+            fprintf(f, ",");
+    }
+    fprintf(f, "\n");
+
+    if(fclose(f) != 0)
+    {
+        perror(ig_opts->csv_name);
+        return(-1);
     }
 
     return(0);
@@ -290,44 +1602,98 @@ static int usage (char *exename)
 {
     fprintf(stderr, "Usage: %s [options]\n", exename);
     fprintf(stderr, "    -s <number of servers>\n");
+    fprintf(stderr, "        (-s and -v may list several comma separated values: reports\n");
+    fprintf(stderr, "        table size, construction time and placement rate for each\n");
+    fprintf(stderr, "        combination, and -p may list several algorithms)\n");
     fprintf(stderr, "    -o <number of objects>\n");
+    fprintf(stderr, "    -G <objects per chunk: the objects are generated in chunks of this\n");
+    fprintf(stderr, "        size to bound memory use, default %lu>\n", BENCH_DEFAULT_CHUNK);
     fprintf(stderr, "    -r <replication factor>\n");
     fprintf(stderr, "    -p <placement algorithm>\n");
     fprintf(stderr, "    -v <virtual nodes per physical node>\n");
     fprintf(stderr, "    -c <output file for combinatorial statistics>\n");
+    fprintf(stderr, "    -k <key length in bytes: also benchmark byte string keys>\n");
+    fprintf(stderr, "    -b <oids per call: also benchmark batch lookups>\n");
+    fprintf(stderr, "    -P (also benchmark the library thread pool)\n");
+    fprintf(stderr, "    -l <oids per call: also report per-call latency percentiles>\n");
+    fprintf(stderr, "    -S <max threads: sweep 1, 2, 4, ... threads instead; -p may list\n");
+    fprintf(stderr, "        several comma separated algorithms>\n");
+    fprintf(stderr, "    -a <sweep thread affinity: compact (default), scatter, numa, none>\n");
+    fprintf(stderr, "    -N (replicate placement tables on each NUMA node)\n");
+    fprintf(stderr, "    -n <passes: repeat each timed measurement, at most %d>\n", BENCH_MAX_RUNS);
+    fprintf(stderr, "    -J <write results as JSON to this file>\n");
+    fprintf(stderr, "    -C <append results as a CSV row to this file>\n");
+    fprintf(stderr, "    -w <oids per batch: also time lookups with warm caches, with caches\n");
+    fprintf(stderr, "        flushed before every batch, and cycling through instances that\n");
+    fprintf(stderr, "        exceed the last level cache, in random and sorted oid order>\n");
+    fprintf(stderr, "    -H (also report hardware counters per lookup: cycles, instructions,\n");
+    fprintf(stderr, "        LLC, dTLB and branch misses, from an extra untimed pass)\n");
 
     exit(1);
 }
 
+/* parses a comma separated list of positive integers */
+static int parse_list(const char *arg, unsigned int **list, unsigned int *n)
+{
+    char *copy, *tok, *saveptr;
+    unsigned int val;
+
+    copy = strdup(arg);
+    if(!copy)
+        return(-1);
+    free(*list);
+    *list = NULL;
+    *n = 0;
+    for(tok = strtok_r(copy, ",", &saveptr); tok;
+        tok = strtok_r(NULL, ",", &saveptr))
+    {
+        if(sscanf(tok, "%u", &val) != 1)
+            break;
+        *list = realloc(*list, (*n+1)*sizeof(**list));
+        if(!*list)
+            break;
+        (*list)[(*n)++] = val;
+    }
+    free(copy);
+
+    return(tok || *n == 0 ? -1 : 0);
+}
+
 static struct options *parse_args(int argc, char *argv[])
 {
     struct options *opts = NULL;
     int ret = -1;
     int one_opt = 0;
+    unsigned int i;
 
     opts = (struct options*)malloc(sizeof(*opts));
     if(!opts)
         return(NULL);
     memset(opts, 0, sizeof(*opts));
+    opts->affinity = AFFINITY_COMPACT;
+    opts->runs = 1;
+    opts->chunk = BENCH_DEFAULT_CHUNK;
 
-    while((one_opt = getopt(argc, argv, "s:o:r:hp:v:c:")) != EOF)
+    while((one_opt = getopt(argc, argv, "s:o:r:hp:v:c:k:b:Pl:S:a:Nn:J:C:Hw:G:")) != EOF)
     {
         switch(one_opt)
         {
             case 's':
-                ret = sscanf(optarg, "%u", &opts->num_servers);
-                if(ret != 1)
+                if(parse_list(optarg, &opts->server_list,
+                    &opts->n_server_list) < 0)
                     return(NULL);
+                opts->num_servers = opts->server_list[0];
                 break;
             case 'o':
-                ret = sscanf(optarg, "%u", &opts->num_objs);
+                ret = sscanf(optarg, "%lu", &opts->num_objs);
                 if(ret != 1)
                     return(NULL);
                 break;
             case 'v':
-                ret = sscanf(optarg, "%u", &opts->virt_factor);
-                if(ret != 1)
+                if(parse_list(optarg, &opts->virt_list,
+                    &opts->n_virt_list) < 0)
                     return(NULL);
+                opts->virt_factor = opts->virt_list[0];
                 break;
             case 'r':
                 ret = sscanf(optarg, "%u", &opts->replication);
@@ -344,6 +1710,65 @@ static struct options *parse_args(int argc, char *argv[])
                 if(!opts->comb_name)
                     return(NULL);
                 break;
+            case 'k':
+                ret = sscanf(optarg, "%u", &opts->key_len);
+                if(ret != 1)
+                    return(NULL);
+                break;
+            case 'b':
+                ret = sscanf(optarg, "%u", &opts->batch);
+                if(ret != 1)
+                    return(NULL);
+                break;
+            case 'P':
+                opts->parallel = 1;
+                break;
+            case 'l':
+                ret = sscanf(optarg, "%u", &opts->latency);
+                if(ret != 1)
+                    return(NULL);
+                break;
+            case 'S':
+                ret = sscanf(optarg, "%u", &opts->sweep);
+                if(ret != 1)
+                    return(NULL);
+                break;
+            case 'a':
+                opts->affinity = affinity_parse(optarg);
+                if(opts->affinity < 0)
+                    return(NULL);
+                break;
+            case 'N':
+                opts->flags |= CH_PLACEMENT_NUMA_REPLICATE;
+                break;
+            case 'H':
+                opts->counters = 1;
+                break;
+            case 'w':
+                ret = sscanf(optarg, "%u", &opts->cache_batch);
+                if(ret != 1 || opts->cache_batch < 1)
+                    return(NULL);
+                break;
+            case 'G':
+                ret = sscanf(optarg, "%lu", &opts->chunk);
+                if(ret != 1 || opts->chunk < 1)
+                    return(NULL);
+                break;
+            case 'n':
+                ret = sscanf(optarg, "%u", &opts->runs);
+                if(ret != 1)
+                    return(NULL);
+                break;
+            case 'J':
+                opts->json_name = strdup(optarg);
+                if(!opts->json_name)
+                    return(NULL);
+                break;
+            case 'C':
+                opts->csv_name = strdup(optarg);
+                if(!opts->csv_name)
+                    return(NULL);
+                break;
             case '?':
                 usage(argv[0]);
                 exit(1);
@@ -352,14 +1777,37 @@ static struct options *parse_args(int argc, char *argv[])
 
     if(opts->replication < 2)
         return(NULL);
-    if(opts->num_servers < (opts->replication+1))
+    for(i=0; i<opts->n_server_list; i++)
+    {
+        if(opts->server_list[i] < (opts->replication+1))
+            return(NULL);
+    }
+    if(opts->n_server_list < 1)
         return(NULL);
     if(opts->num_objs < 1)
         return(NULL);
-    if(opts->virt_factor < 1)
+    if(opts->chunk > opts->num_objs)
+        opts->chunk = opts->num_objs;
+    for(i=0; i<opts->n_virt_list; i++)
+    {
+        if(opts->virt_list[i] < 1)
+            return(NULL);
+    }
+    if(opts->n_virt_list < 1)
         return(NULL);
     if(!opts->placement)
         return(NULL);
+    if(opts->runs < 1 || opts->runs > BENCH_MAX_RUNS)
+        return(NULL);
+    /* the sweeps have their own output format */
+    if((opts->sweep || opts->n_server_list > 1 || opts->n_virt_list > 1) &&
+        (opts->json_name || opts->csv_name))
+        return(NULL);
+    if(opts->sweep && (opts->n_server_list > 1 || opts->n_virt_list > 1))
+        return(NULL);
+    /* combinations are only counted once */
+    if(opts->comb_name)
+        opts->runs = 1;
 
     assert(opts->replication <= CH_MAX_REPLICATION);
 
@@ -367,8 +1815,8 @@ static struct options *parse_args(int argc, char *argv[])
 }
 
 static int comb_cmp (const void *a, const void *b){
-    unsigned long au = ((struct comb_stats*)a)->count;
-    unsigned long bu = ((struct comb_stats*)b)->count; 
+    unsigned long au = ((struct comb_count*)a)->count;
+    unsigned long bu = ((struct comb_count*)b)->count; 
     int rtn;
     if (au < bu)       rtn = -1;
     else if (au == bu) rtn = 0;
@@ -0,0 +1,435 @@
+/*
+ * Copyright (C) 2015 University of Chicago.
+ * See COPYRIGHT notice in top-level directory.
+ *
+ */
+
+#include <string.h>
+#include <assert.h>
+#include <stdio.h>
+#include <stdint.h>
+#include <unistd.h>
+#include <stdlib.h>
+#include <limits.h>
+#include <sys/time.h>
+
+#include "ch-placement-oid-gen.h"
+#include "ch-placement.h"
+
+/* Membership churn benchmark: places a population of objects, then applies
+ * a sequence of membership changes.  For each step it reports how long the
+ * instance took to update, and how many objects, replicas and bytes moved
+ * compared with the minimum any placement must move to keep the load even
+ * over the servers that are up.
+ *
+ * Steps (comma separated):
+ *   +N  add N servers (rebuild)
+ *   -N  remove the last N servers (rebuild)
+ *   dK  mark server K down (ch_placement_set_down(), no rebuild)
+ *   uK  bring server K back up
+ *   vN  change the virtual nodes per server to N (rebuild)
+ */
+
+struct options
+{
+    unsigned int num_servers;
+    unsigned int num_objs;
+    unsigned int replication;
+    char* placement;
+    unsigned int virt_factor;
+    char* steps;
+    int seed;
+};
+
+/* membership at one point of the sequence */
+struct churn_state
+{
+    struct ch_placement_instance *instance;
+    unsigned int num_servers;
+    unsigned int virt_factor;
+    uint64_t *down;         /* servers that are down, or NULL; installed
+                             * in instance only if a server is down */
+};
+
+static int usage (char *exename);
+static struct options *parse_args(int argc, char *argv[]);
+static int apply_step(struct options *ig_opts, const char *step,
+    struct churn_state *state, const char **update);
+static unsigned int count_up(const struct churn_state *state);
+static unsigned int count_up_both(const struct churn_state *a,
+    const struct churn_state *b);
+
+static double Wtime(void)
+{
+    struct timeval t;
+    gettimeofday(&t, NULL);
+    return((double)t.tv_sec + (double)(t.tv_usec) / 1000000);
+}
+
+int main(
+    int argc,
+    char **argv)
+{
+    struct options *ig_opts = NULL;
+    unsigned long total_byte_count = 0;
+    unsigned long total_obj_count = 0;
+    struct obj* total_objs = NULL;
+    struct churn_state state, prev;
+    char *step, *saveptr;
+    const char *update;
+    unsigned int i, n_step = 0;
+    unsigned int up_prev, up_next, up_both;
+    unsigned long objs_moved, replicas_moved;
+    uint64_t bytes_moved, total_moved = 0;
+    double t1, t2, t3;
+    double fraction, minimum;
+
+    ig_opts = parse_args(argc, argv);
+    if(!ig_opts)
+    {
+        usage(argv[0]);
+        return(-1);
+    }
+
+    memset(&state, 0, sizeof(state));
+    state.num_servers = ig_opts->num_servers;
+    state.virt_factor = ig_opts->virt_factor;
+    state.instance = ch_placement_initialize(ig_opts->placement,
+        state.num_servers, state.virt_factor, ig_opts->seed);
+    if(!state.instance)
+    {
+        fprintf(stderr, "Error: failed to initialize %s\n", ig_opts->placement);
+        return(-1);
+    }
+
+    /* generate random set of objects for testing */
+    printf("# Generating random object IDs...\n");
+    oid_gen("random", state.instance, ig_opts->num_objs, ULONG_MAX,
+        ig_opts->seed, ig_opts->replication, ig_opts->num_servers,
+        NULL,
+        &total_byte_count, &total_obj_count, &total_objs);
+    printf("# Done.\n");
+    assert(total_obj_count == ig_opts->num_objs);
+
+#pragma omp parallel for
+    for(i=0; i<ig_opts->num_objs; i++)
+        ch_placement_find_closest(state.instance, total_objs[i].oid,
+            ig_opts->replication, total_objs[i].server_idxs);
+
+    printf("# %s, %u servers, %u virt_factor, %u objects, %lu bytes, replication %u\n",
+        ig_opts->placement, ig_opts->num_servers, ig_opts->virt_factor,
+        ig_opts->num_objs, total_byte_count, ig_opts->replication);
+    printf("# minimum: fraction of replicas that must move to keep every server that is up evenly loaded\n");
+    printf("# <step>\t<change>\t<servers>\t<up>\t<update>\t<update (s)>\t<placement (s)>\t<objects moved>\t<object fraction>\t<replica fraction>\t<minimum>\t<ratio>\t<bytes moved>\n");
+
+    for(step = strtok_r(ig_opts->steps, ",", &saveptr); step;
+        step = strtok_r(NULL, ",", &saveptr))
+    {
+        prev = state;
+        /* apply_step() frees the bitmap; keep a copy for the minimum */
+        if(state.down)
+        {
+            prev.down = malloc(CH_PLACEMENT_DOWN_WORDS(state.num_servers)*
+                sizeof(*prev.down));
+            assert(prev.down);
+            memcpy(prev.down, state.down,
+                CH_PLACEMENT_DOWN_WORDS(state.num_servers)*sizeof(*prev.down));
+        }
+
+        t1 = Wtime();
+        if(apply_step(ig_opts, step, &state, &update) < 0)
+        {
+            fprintf(stderr, "Error: bad or impossible step: %s\n", step);
+            return(-1);
+        }
+        t2 = Wtime();
+
+        objs_moved = 0;
+        replicas_moved = 0;
+        bytes_moved = 0;
+#pragma omp parallel for reduction(+:objs_moved,replicas_moved,bytes_moved)
+        for(i=0; i<ig_opts->num_objs; i++)
+        {
+            unsigned long new_idxs[CH_OBJ_MAX_REPLICATION];
+            unsigned int j, k, moved = 0;
+
+            ch_placement_find_closest(state.instance, total_objs[i].oid,
+                ig_opts->replication, new_idxs);
+            /* a replica moves if its server did not hold the object.  The
+             * scan modules may pick two vnodes of one server, so each
+             * server is counted once.
+             */
+            for(j=0; j<ig_opts->replication; j++)
+            {
+                for(k=0; k<j; k++)
+                {
+                    if(new_idxs[j] == new_idxs[k])
+                        break;
+                }
+                if(k < j)
+                    continue;
+                for(k=0; k<ig_opts->replication; k++)
+                {
+                    if(new_idxs[j] == total_objs[i].server_idxs[k])
+                        break;
+                }
+                if(k == ig_opts->replication)
+                    moved++;
+            }
+            if(moved)
+            {
+                objs_moved++;
+                replicas_moved += moved;
+                bytes_moved += moved*total_objs[i].size;
+            }
+            memcpy(total_objs[i].server_idxs, new_idxs,
+                ig_opts->replication*sizeof(*new_idxs));
+        }
+        t3 = Wtime();
+
+        up_prev = count_up(&prev);
+        up_next = count_up(&state);
+        up_both = count_up_both(&prev, &state);
+        minimum = 1.0 - (double)up_both /
+            (up_prev > up_next ? up_prev : up_next);
+        fraction = (double)replicas_moved /
+            ((double)ig_opts->num_objs*ig_opts->replication);
+        total_moved += bytes_moved;
+
+        printf("%u\t%s\t%u\t%u\t%s\t%f\t%f\t%lu\t%f\t%f\t%f\t",
+            n_step++, step, state.num_servers, up_next, update, t2-t1, t3-t2,
+            objs_moved, (double)objs_moved/ig_opts->num_objs, fraction,
+            minimum);
+        if(minimum > 0)
+            printf("%f", fraction/minimum);
+        else
+            printf("-");
+        printf("\t%lu\n", bytes_moved);
+
+        free(prev.down);
+    }
+    printf("# Total bytes moved: %lu (%f of the data set per step on average)\n",
+        total_moved, n_step ? (double)total_moved/n_step/total_byte_count : 0);
+
+    free(total_objs);
+    ch_placement_finalize(state.instance);
+    free(state.down);
+
+    return(0);
+}
+
+/* applies one step to state, rebuilding the instance or updating its down
+ * bitmap in place.  Sets *update to the kind of update.  Returns -1 if the
+ * step cannot be parsed or would leave fewer than replication servers up.
+ */
+static int apply_step(struct options *ig_opts, const char *step,
+    struct churn_state *state, const char **update)
+{
+    struct churn_state next = *state;
+    unsigned int val, i;
+    uint64_t *down = NULL;
+    int rebuild = 1;
+
+    if(sscanf(step+1, "%u", &val) != 1)
+        return(-1);
+    switch(step[0])
+    {
+        case '+':
+            next.num_servers += val;
+            break;
+        case '-':
+            if(val >= next.num_servers)
+                return(-1);
+            next.num_servers -= val;
+            break;
+        case 'v':
+            if(val < 1)
+                return(-1);
+            next.virt_factor = val;
+            break;
+        case 'd':
+        case 'u':
+            if(val >= next.num_servers)
+                return(-1);
+            rebuild = 0;
+            break;
+        default:
+            return(-1);
+    }
+
+    /* carry the down servers that still exist over to the new bitmap */
+    down = calloc(CH_PLACEMENT_DOWN_WORDS(next.num_servers), sizeof(*down));
+    if(!down)
+        return(-1);
+    if(state->down)
+    {
+        for(i=0; i<next.num_servers && i<state->num_servers; i++)
+        {
+            if(state->down[i/64] & (1ULL << (i%64)))
+                down[i/64] |= (1ULL << (i%64));
+        }
+    }
+    if(step[0] == 'd')
+        down[val/64] |= (1ULL << (val%64));
+    else if(step[0] == 'u')
+        down[val/64] &= ~(1ULL << (val%64));
+    next.down = down;
+    if(count_up(&next) < ig_opts->replication)
+    {
+        free(down);
+        return(-1);
+    }
+
+    if(rebuild)
+    {
+        *update = "rebuild";
+        next.instance = ch_placement_initialize(ig_opts->placement,
+            next.num_servers, next.virt_factor, ig_opts->seed);
+        if(!next.instance)
+        {
+            free(down);
+            return(-1);
+        }
+        ch_placement_finalize(state->instance);
+    }
+    else
+        *update = "set_down";
+    /* with every server up, lookups skip the down checks entirely */
+    ch_placement_set_down(next.instance,
+        count_up(&next) < next.num_servers ? down : NULL);
+    /* no lookups are in flight, so the old bitmap can go right away */
+    free(state->down);
+    *state = next;
+
+    return(0);
+}
+
+static unsigned int count_up(const struct churn_state *state)
+{
+    unsigned int i, up = 0;
+
+    for(i=0; i<state->num_servers; i++)
+    {
+        if(!state->down || !(state->down[i/64] & (1ULL << (i%64))))
+            up++;
+    }
+    return(up);
+}
+
+/* servers that are up in both a and b */
+static unsigned int count_up_both(const struct churn_state *a,
+    const struct churn_state *b)
+{
+    unsigned int i, n, up = 0;
+
+    n = a->num_servers < b->num_servers ? a->num_servers : b->num_servers;
+    for(i=0; i<n; i++)
+    {
+        if((!a->down || !(a->down[i/64] & (1ULL << (i%64)))) &&
+           (!b->down || !(b->down[i/64] & (1ULL << (i%64)))))
+            up++;
+    }
+    return(up);
+}
+
+static int usage (char *exename)
+{
+    fprintf(stderr, "Usage: %s [options]\n", exename);
+    fprintf(stderr, "    -s <number of servers to start with>\n");
+    fprintf(stderr, "    -o <number of objects>\n");
+    fprintf(stderr, "    -r <replication factor>\n");
+    fprintf(stderr, "    -p <placement algorithm>\n");
+    fprintf(stderr, "    -v <virtual nodes per physical node>\n");
+    fprintf(stderr, "    -c <comma separated steps (default: +1,-1,d0,u0)>\n");
+    fprintf(stderr, "        +N add N servers, -N remove the last N servers,\n");
+    fprintf(stderr, "        dK mark server K down, uK bring server K back up,\n");
+    fprintf(stderr, "        vN change the virtual nodes per server to N\n");
+    fprintf(stderr, "    -z <random seed/hash salt>\n");
+
+    exit(1);
+}
+
+static struct options *parse_args(int argc, char *argv[])
+{
+    struct options *opts = NULL;
+    int ret = -1;
+    int one_opt = 0;
+
+    opts = (struct options*)malloc(sizeof(*opts));
+    if(!opts)
+        return(NULL);
+    memset(opts, 0, sizeof(*opts));
+
+    while((one_opt = getopt(argc, argv, "s:o:r:hp:v:c:z:")) != EOF)
+    {
+        switch(one_opt)
+        {
+            case 's':
+                ret = sscanf(optarg, "%u", &opts->num_servers);
+                if(ret != 1)
+                    return(NULL);
+                break;
+            case 'o':
+                ret = sscanf(optarg, "%u", &opts->num_objs);
+                if(ret != 1)
+                    return(NULL);
+                break;
+            case 'v':
+                ret = sscanf(optarg, "%u", &opts->virt_factor);
+                if(ret != 1)
+                    return(NULL);
+                break;
+            case 'z':
+                ret = sscanf(optarg, "%d", &opts->seed);
+                if(ret != 1)
+                    return(NULL);
+                break;
+            case 'r':
+                ret = sscanf(optarg, "%u", &opts->replication);
+                if(ret != 1)
+                    return(NULL);
+                break;
+            case 'p':
+                opts->placement = strdup(optarg);
+                if(!opts->placement)
+                    return(NULL);
+                break;
+            case 'c':
+                opts->steps = strdup(optarg);
+                if(!opts->steps)
+                    return(NULL);
+                break;
+            case '?':
+                usage(argv[0]);
+                exit(1);
+        }
+    }
+
+    if(opts->replication < 1)
+        return(NULL);
+    if(opts->num_servers < (opts->replication+1))
+        return(NULL);
+    if(opts->num_objs < 1)
+        return(NULL);
+    if(opts->virt_factor < 1)
+        return(NULL);
+    if(!opts->placement)
+        return(NULL);
+    if(!opts->steps)
+        opts->steps = strdup("+1,-1,d0,u0");
+
+    /* placement is cached in struct obj */
+    if(opts->replication > CH_OBJ_MAX_REPLICATION)
+        return(NULL);
+
+    return(opts);
+}
+
+/*
+ * Local variables:
+ *  c-indent-level: 4
+ *  c-basic-offset: 4
+ * End:
+ *
+ * vim: ft=c ts=8 sts=4 sw=4 expandtab
+ */
@@ -18,32 +18,48 @@
 
 #include "ch-placement-oid-gen.h"
 #include "ch-placement.h"
+#include "perfctr.h"
 
 struct options
 {
     unsigned int num_servers;
-    unsigned int num_objs;
+    unsigned long num_objs;
+    unsigned long chunk;
     unsigned int replication;
     char* placement;
     unsigned int virt_factor;
     unsigned int kill_svr;
     int seed;
+    int counters;
 };
 
+/* default objects generated and checked at a time */
+#define DECLUSTER_DEFAULT_CHUNK (1UL<<20)
+
 static int usage (char *exename);
 static struct options *parse_args(int argc, char *argv[]);
+static void counters_begin(struct options *ig_opts, struct perfctr *pc,
+    struct perfctr_counts *thread_counts);
+static void counters_end(struct options *ig_opts, struct perfctr *pc,
+    struct perfctr_counts *thread_counts, struct perfctr_counts *total);
 
 int main(
     int argc,
     char **argv)
 {
     struct options *ig_opts = NULL;
-    unsigned long total_byte_count = 0;
+    uint64_t total_byte_count = 0;
     unsigned long total_obj_count = 0;
-    struct obj* total_objs = NULL;
-    unsigned int i;
+    struct oid_stream *stream;
+    struct obj* objs = NULL;
+    unsigned long n_objs;
+    unsigned long i;
     struct ch_placement_instance *instance;
     unsigned long *replica_targets;
+    uint64_t *down;
+    unsigned long n_failover = 0;
+    /* -H: counted separately for the two phases */
+    struct perfctr_counts place_counts, failover_counts;
 
     ig_opts = parse_args(argc, argv);
     if(!ig_opts)
@@ -60,71 +76,189 @@ int main(
     }
     memset(replica_targets, 0, ig_opts->num_servers*sizeof(*replica_targets));
 
+    down = calloc(CH_PLACEMENT_DOWN_WORDS(ig_opts->num_servers), sizeof(*down));
+    if(!down)
+    {
+        perror("calloc");
+        return(-1);
+    }
+    down[ig_opts->kill_svr/64] |= (1ULL << (ig_opts->kill_svr%64));
+
     instance = ch_placement_initialize(ig_opts->placement, 
         ig_opts->num_servers,
         ig_opts->virt_factor,
         ig_opts->seed);
 
-    /* generate random set of objects for testing */
-    printf("# Generating random object IDs...\n");
-    oid_gen("random", instance, ig_opts->num_objs, ULONG_MAX,
-        ig_opts->seed, ig_opts->replication+1, ig_opts->num_servers,
-        NULL,
-        &total_byte_count, &total_obj_count, &total_objs);
-    printf("# Done.\n");
-    printf("#  Object population consuming approximately %lu MiB of memory.\n", (ig_opts->num_objs*sizeof(*total_objs))/(1024*1024));
+    /* random objects for testing, generated and checked one chunk at a
+     * time so that memory use does not grow with the population
+     */
+    if(ig_opts->chunk > ig_opts->num_objs)
+        ig_opts->chunk = ig_opts->num_objs;
+    objs = malloc(ig_opts->chunk*sizeof(*objs));
+    stream = oid_stream_init("random", ig_opts->num_objs, ULONG_MAX,
+        ig_opts->seed, ig_opts->replication, ig_opts->chunk, 0);
+    if(!objs || !stream)
+    {
+        perror("oid_stream_init");
+        return(-1);
+    }
+    printf("# Generating random object IDs in chunks of %lu objects...\n",
+        ig_opts->chunk);
+    printf("#  Object population consuming approximately %lu MiB of memory.\n", (ig_opts->chunk*sizeof(*objs))/(1024*1024));
 
-    assert(total_obj_count == ig_opts->num_objs);
+    memset(&place_counts, 0, sizeof(place_counts));
+    memset(&failover_counts, 0, sizeof(failover_counts));
 
     printf("# Calculating placement for each object ID...\n");
-#pragma omp parallel for
-    for(i=0; i<ig_opts->num_objs; i++)
+    while((n_objs = oid_stream_next_batch(stream, objs)) > 0)
     {
-        ch_placement_find_closest(instance, total_objs[i].oid, ig_opts->replication+1, total_objs[i].server_idxs);
-    }
-    printf("# Done.\n");
+#pragma omp parallel
+        {
+            struct perfctr pc;
+            struct perfctr_counts thread_counts;
 
-#pragma omp parallel for
-    for(i=0; i<ig_opts->num_objs; i++)
-    {
-        int j;
-        for(j=0; j<ig_opts->replication; j++)
+            counters_begin(ig_opts, &pc, &thread_counts);
+#pragma omp for nowait
+            for(i=0; i<n_objs; i++)
+            {
+                ch_placement_find_closest(instance, objs[i].oid, ig_opts->replication, objs[i].server_idxs);
+            }
+            counters_end(ig_opts, &pc, &thread_counts, &place_counts);
+        }
+
+        /* mark the server as down and see where the chunk's replicas go */
+        ch_placement_set_down(instance, down);
+
+#pragma omp parallel
         {
-            if(total_objs[i].server_idxs[j] == ig_opts->kill_svr)
+            struct perfctr pc;
+            struct perfctr_counts thread_counts;
+
+            counters_begin(ig_opts, &pc, &thread_counts);
+#pragma omp for nowait reduction(+:n_failover)
+            for(i=0; i<n_objs; i++)
             {
-                replica_targets[total_objs[i].server_idxs[ig_opts->replication]]++;
-                break;
+                unsigned long new_idxs[CH_MAX_REPLICATION];
+                unsigned int j, k;
+                for(j=0; j<ig_opts->replication; j++)
+                {
+                    if(objs[i].server_idxs[j] == ig_opts->kill_svr)
+                        break;
+                }
+                if(j == ig_opts->replication)
+                    continue;
+
+                n_failover++;
+                ch_placement_find_closest(instance, objs[i].oid, ig_opts->replication, new_idxs);
+                for(j=0; j<ig_opts->replication; j++)
+                {
+                    for(k=0; k<ig_opts->replication; k++)
+                    {
+                        if(new_idxs[j] == objs[i].server_idxs[k])
+                            break;
+                    }
+                    if(k == ig_opts->replication)
+                    {
+#pragma omp atomic
+                        replica_targets[new_idxs[j]]++;
+                    }
+                }
             }
+            counters_end(ig_opts, &pc, &thread_counts, &failover_counts);
         }
+
+        ch_placement_set_down(instance, NULL);
     }
+    oid_stream_finalize(stream, &total_byte_count, &total_obj_count, NULL);
+    printf("# Done.\n");
+
+    assert(total_obj_count == ig_opts->num_objs);
 
     printf("# Simulating failure of server %u out of %u\n", ig_opts->kill_svr, ig_opts->num_servers);
-    printf("# Total objects: %u\n", ig_opts->num_objs);
+    printf("# Total objects: %lu\n", ig_opts->num_objs);
     printf("# <svr_idx>\t<num new replicas>\n");
     for(i=0; i<ig_opts->num_servers; i++)
     {
-        printf("%u\t%lu\n", i, replica_targets[i]);
+        printf("%lu\t%lu\n", i, replica_targets[i]);
     }
 
-    /* we don't need the global list any more */
-    free(total_objs);
-    total_obj_count = 0;
-    total_byte_count = 0;
+    if(ig_opts->counters)
+    {
+        if(!place_counts.valid)
+            printf("# Hardware counters not available: %s\n",
+                strerror(place_counts.error));
+        else
+        {
+            /* failover lookups are only those of objects with a replica on
+             * the failed server; the phase also includes the scan for them
+             */
+            printf("# Hardware counters per lookup, user space only\n");
+            printf("# <algorithm>\t<phase>\t<lookups>%s\n", PERFCTR_HEADER);
+            printf("%s\tplacement\t%lu", ig_opts->placement,
+                ig_opts->num_objs);
+            perfctr_print(stdout, &place_counts, ig_opts->num_objs);
+            printf("\n%s\tfailover\t%lu", ig_opts->placement, n_failover);
+            perfctr_print(stdout, &failover_counts, n_failover);
+            printf("\n");
+        }
+    }
+
+    free(objs);
     free(replica_targets);
+    free(down);
+    ch_placement_finalize(instance);
 
     return(0);
 }
 
+/* starts the calling thread's counters for one phase, if -H was given */
+static void counters_begin(struct options *ig_opts, struct perfctr *pc,
+    struct perfctr_counts *thread_counts)
+{
+    memset(thread_counts, 0, sizeof(*thread_counts));
+    pc->leader = -1;
+    pc->n = 0;
+    if(!ig_opts->counters)
+        return;
+    if(perfctr_open(pc) == 0)
+        perfctr_start(pc);
+    else
+        thread_counts->error = errno;
+
+    return;
+}
+
+/* stops the calling thread's counters and adds them to the phase total */
+static void counters_end(struct options *ig_opts, struct perfctr *pc,
+    struct perfctr_counts *thread_counts, struct perfctr_counts *total)
+{
+    if(!ig_opts->counters)
+        return;
+    if(pc->leader >= 0)
+    {
+        perfctr_stop(pc, thread_counts);
+        perfctr_close(pc);
+    }
+#pragma omp critical
+    perfctr_merge(total, thread_counts);
+
+    return;
+}
+
 static int usage (char *exename)
 {
     fprintf(stderr, "Usage: %s [options]\n", exename);
     fprintf(stderr, "    -s <number of servers>\n");
     fprintf(stderr, "    -o <number of objects>\n");
+    fprintf(stderr, "    -G <objects per chunk: the objects are generated and checked in\n");
+    fprintf(stderr, "        chunks of this size to bound memory use, default %lu>\n", DECLUSTER_DEFAULT_CHUNK);
     fprintf(stderr, "    -r <replication factor>\n");
     fprintf(stderr, "    -p <placement algorithm>\n");
     fprintf(stderr, "    -v <virtual nodes per physical node>\n");
     fprintf(stderr, "    -k <server to kill>\n");
     fprintf(stderr, "    -z <random seed/hash salt>\n");
+    fprintf(stderr, "    -H (also report hardware counters per lookup for the initial\n");
+    fprintf(stderr, "        placement and the failover)\n");
 
     exit(1);
 }
@@ -139,8 +273,9 @@ static struct options *parse_args(int argc, char *argv[])
     if(!opts)
         return(NULL);
     memset(opts, 0, sizeof(*opts));
+    opts->chunk = DECLUSTER_DEFAULT_CHUNK;
 
-    while((one_opt = getopt(argc, argv, "s:o:r:hp:v:k:z:")) != EOF)
+    while((one_opt = getopt(argc, argv, "s:o:r:hp:v:k:z:HG:")) != EOF)
     {
         switch(one_opt)
         {
@@ -155,10 +290,15 @@ static struct options *parse_args(int argc, char *argv[])
                     return(NULL);
                 break;
             case 'o':
-                ret = sscanf(optarg, "%u", &opts->num_objs);
+                ret = sscanf(optarg, "%lu", &opts->num_objs);
                 if(ret != 1)
                     return(NULL);
                 break;
+            case 'G':
+                ret = sscanf(optarg, "%lu", &opts->chunk);
+                if(ret != 1 || opts->chunk < 1)
+                    return(NULL);
+                break;
             case 'v':
                 ret = sscanf(optarg, "%u", &opts->virt_factor);
                 if(ret != 1)
@@ -169,6 +309,9 @@ static struct options *parse_args(int argc, char *argv[])
                 if(ret != 1)
                     return(NULL);
                 break;
+            case 'H':
+                opts->counters = 1;
+                break;
             case 'r':
                 ret = sscanf(optarg, "%u", &opts->replication);
                 if(ret != 1)
@@ -198,7 +341,8 @@ static struct options *parse_args(int argc, char *argv[])
     if(opts->kill_svr >= opts->num_servers)
         return(NULL);
 
-    assert((opts->replication+1) <= CH_MAX_REPLICATION);
+    /* placement is cached in struct obj */
+    assert(opts->replication <= CH_OBJ_MAX_REPLICATION);
 
     return(opts);
 }
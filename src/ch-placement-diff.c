@@ -0,0 +1,336 @@
+/*
+ * Copyright (C) 2015 University of Chicago.
+ * See COPYRIGHT notice in top-level directory.
+ *
+ */
+
+#include <string.h>
+#include <assert.h>
+#include <stdio.h>
+#include <stdint.h>
+#include <unistd.h>
+#include <stdlib.h>
+#include <sys/time.h>
+
+#include "ch-placement.h"
+#include "ch-placement-diff.h"
+
+/* Migration planner: compares the placement produced by two instance
+ * configurations and prints the resulting source -> destination transfer
+ * matrix, with byte estimates for a data set of the given size.
+ */
+
+struct options
+{
+    char* placement;
+    unsigned int old_servers;
+    unsigned int new_servers;
+    unsigned int old_virt_factor;
+    unsigned int new_virt_factor;
+    unsigned int replication;
+    char* old_down;
+    char* new_down;
+    double total_bytes;
+    unsigned long samples;
+    int threads;
+    int print_arcs;
+    int force_sampling;
+    int seed;
+};
+
+static int usage (char *exename);
+static struct options *parse_args(int argc, char *argv[]);
+static uint64_t* parse_down(const char *list, unsigned int n_svrs);
+
+static double Wtime(void)
+{
+    struct timeval t;
+    gettimeofday(&t, NULL);
+    return((double)t.tv_sec + (double)(t.tv_usec) / 1000000);
+}
+
+int main(
+    int argc,
+    char **argv)
+{
+    struct options *ig_opts = NULL;
+    struct ch_placement_instance *old_inst, *new_inst;
+    struct ch_placement_diff *diff;
+    uint64_t *old_down = NULL;
+    uint64_t *new_down = NULL;
+    unsigned long i, j;
+    double t1, t2;
+    double fraction;
+    int ret;
+
+    ig_opts = parse_args(argc, argv);
+    if(!ig_opts)
+    {
+        usage(argv[0]);
+        return(-1);
+    }
+
+    old_inst = ch_placement_initialize(ig_opts->placement,
+        ig_opts->old_servers, ig_opts->old_virt_factor, ig_opts->seed);
+    new_inst = ch_placement_initialize(ig_opts->placement,
+        ig_opts->new_servers, ig_opts->new_virt_factor, ig_opts->seed);
+    if(!old_inst || !new_inst)
+    {
+        fprintf(stderr, "Error: failed to initialize %s\n", ig_opts->placement);
+        return(-1);
+    }
+
+    if(ig_opts->old_down)
+    {
+        old_down = parse_down(ig_opts->old_down, ig_opts->old_servers);
+        if(!old_down)
+        {
+            fprintf(stderr, "Error: bad server list: %s\n", ig_opts->old_down);
+            return(-1);
+        }
+        ch_placement_set_down(old_inst, old_down);
+    }
+    if(ig_opts->new_down)
+    {
+        new_down = parse_down(ig_opts->new_down, ig_opts->new_servers);
+        if(!new_down)
+        {
+            fprintf(stderr, "Error: bad server list: %s\n", ig_opts->new_down);
+            return(-1);
+        }
+        ch_placement_set_down(new_inst, new_down);
+    }
+
+    t1 = Wtime();
+    if(ig_opts->force_sampling)
+        ret = ch_placement_diff_sampled(old_inst, new_inst,
+            ig_opts->replication, ig_opts->samples, ig_opts->threads, &diff);
+    else
+        ret = ch_placement_diff(old_inst, new_inst, ig_opts->replication,
+            ig_opts->samples, ig_opts->threads, &diff);
+    t2 = Wtime();
+    if(ret < 0)
+    {
+        fprintf(stderr, "Error: failed to compare placements.\n");
+        return(-1);
+    }
+
+    printf("# old: %s, %u servers, %u virt_factor, down: %s\n",
+        ig_opts->placement, ig_opts->old_servers, ig_opts->old_virt_factor,
+        ig_opts->old_down ? ig_opts->old_down : "none");
+    printf("# new: %s, %u servers, %u virt_factor, down: %s\n",
+        ig_opts->placement, ig_opts->new_servers, ig_opts->new_virt_factor,
+        ig_opts->new_down ? ig_opts->new_down : "none");
+    if(diff->exact)
+        printf("# Method: exact, %lu arcs compared, %lu moved arc transfers.\n",
+            diff->examined, diff->n_arcs);
+    else
+        printf("# Method: sampled, %lu objects compared.\n", diff->examined);
+    printf("# Time: %f s\n", t2-t1);
+    printf("# Objects with a changed replica set: %f%%\n", diff->moved_fraction*100.0);
+
+    if(ig_opts->print_arcs && diff->exact)
+    {
+        printf("# <ring>\t<arc start>\t<arc end>\t<src>\t<dst>\n");
+        for(i=0; i<diff->n_arcs; i++)
+        {
+            printf("%u\t%lu\t%lu\t%lu\t%lu\n", diff->arcs[i].ring,
+                diff->arcs[i].start, diff->arcs[i].end,
+                diff->arcs[i].src, diff->arcs[i].dst);
+        }
+    }
+
+    printf("# <src>\t<dst>\t<fraction of objects>\t<bytes>\n");
+    for(i=0; i<diff->n_svrs; i++)
+    {
+        for(j=0; j<diff->n_svrs; j++)
+        {
+            fraction = diff->matrix[i*diff->n_svrs + j];
+            if(fraction > 0)
+                printf("%lu\t%lu\t%f\t%.0f\n", i, j, fraction,
+                    fraction*ig_opts->total_bytes);
+        }
+    }
+
+    ch_placement_diff_free(diff);
+    ch_placement_finalize(old_inst);
+    ch_placement_finalize(new_inst);
+    free(old_down);
+    free(new_down);
+
+    return(0);
+}
+
+/* converts a comma separated list of server indices into a down bitmap */
+static uint64_t* parse_down(const char *list, unsigned int n_svrs)
+{
+    uint64_t *down;
+    char *dup_list;
+    char *svr;
+    unsigned int idx;
+    int ret;
+
+    down = calloc(CH_PLACEMENT_DOWN_WORDS(n_svrs), sizeof(*down));
+    dup_list = strdup(list);
+    if(!down || !dup_list)
+    {
+        free(down);
+        free(dup_list);
+        return(NULL);
+    }
+
+    svr = strtok(dup_list, ",");
+    while(svr)
+    {
+        ret = sscanf(svr, "%u", &idx);
+        if(ret != 1 || idx >= n_svrs)
+        {
+            free(down);
+            free(dup_list);
+            return(NULL);
+        }
+        down[idx/64] |= (1ULL << (idx%64));
+        svr = strtok(NULL, ",");
+    }
+    free(dup_list);
+
+    return(down);
+}
+
+static int usage (char *exename)
+{
+    fprintf(stderr, "Usage: %s [options]\n", exename);
+    fprintf(stderr, "    -p <placement algorithm>\n");
+    fprintf(stderr, "    -s <number of servers before>\n");
+    fprintf(stderr, "    -S <number of servers after (default: same)>\n");
+    fprintf(stderr, "    -v <virtual nodes per physical node before>\n");
+    fprintf(stderr, "    -V <virtual nodes per physical node after (default: same)>\n");
+    fprintf(stderr, "    -r <replication factor>\n");
+    fprintf(stderr, "    -x <comma separated servers down before>\n");
+    fprintf(stderr, "    -X <comma separated servers down after>\n");
+    fprintf(stderr, "    -b <total bytes stored (default: 1 TiB)>\n");
+    fprintf(stderr, "    -n <objects to sample if no exact method (default: 1000000)>\n");
+    fprintf(stderr, "    -t <threads for sampling (default: one per CPU)>\n");
+    fprintf(stderr, "    -z <random seed/hash salt>\n");
+    fprintf(stderr, "    -a (list every moved arc)\n");
+    fprintf(stderr, "    -e (estimate by sampling even if an exact method exists)\n");
+
+    exit(1);
+}
+
+static struct options *parse_args(int argc, char *argv[])
+{
+    struct options *opts = NULL;
+    int ret = -1;
+    int one_opt = 0;
+
+    opts = (struct options*)malloc(sizeof(*opts));
+    if(!opts)
+        return(NULL);
+    memset(opts, 0, sizeof(*opts));
+    opts->total_bytes = 1099511627776.0;
+    opts->samples = 1000000;
+
+    while((one_opt = getopt(argc, argv, "p:s:S:v:V:r:x:X:b:n:t:z:aeh")) != EOF)
+    {
+        switch(one_opt)
+        {
+            case 'p':
+                opts->placement = strdup(optarg);
+                if(!opts->placement)
+                    return(NULL);
+                break;
+            case 's':
+                ret = sscanf(optarg, "%u", &opts->old_servers);
+                if(ret != 1)
+                    return(NULL);
+                break;
+            case 'S':
+                ret = sscanf(optarg, "%u", &opts->new_servers);
+                if(ret != 1)
+                    return(NULL);
+                break;
+            case 'v':
+                ret = sscanf(optarg, "%u", &opts->old_virt_factor);
+                if(ret != 1)
+                    return(NULL);
+                break;
+            case 'V':
+                ret = sscanf(optarg, "%u", &opts->new_virt_factor);
+                if(ret != 1)
+                    return(NULL);
+                break;
+            case 'r':
+                ret = sscanf(optarg, "%u", &opts->replication);
+                if(ret != 1)
+                    return(NULL);
+                break;
+            case 'x':
+                opts->old_down = strdup(optarg);
+                if(!opts->old_down)
+                    return(NULL);
+                break;
+            case 'X':
+                opts->new_down = strdup(optarg);
+                if(!opts->new_down)
+                    return(NULL);
+                break;
+            case 'b':
+                ret = sscanf(optarg, "%lf", &opts->total_bytes);
+                if(ret != 1)
+                    return(NULL);
+                break;
+            case 'n':
+                ret = sscanf(optarg, "%lu", &opts->samples);
+                if(ret != 1)
+                    return(NULL);
+                break;
+            case 't':
+                ret = sscanf(optarg, "%d", &opts->threads);
+                if(ret != 1)
+                    return(NULL);
+                break;
+            case 'z':
+                ret = sscanf(optarg, "%d", &opts->seed);
+                if(ret != 1)
+                    return(NULL);
+                break;
+            case 'a':
+                opts->print_arcs = 1;
+                break;
+            case 'e':
+                opts->force_sampling = 1;
+                break;
+            case '?':
+                usage(argv[0]);
+                exit(1);
+        }
+    }
+
+    if(!opts->new_servers)
+        opts->new_servers = opts->old_servers;
+    if(!opts->new_virt_factor)
+        opts->new_virt_factor = opts->old_virt_factor;
+
+    if(opts->replication < 1)
+        return(NULL);
+    if(opts->old_servers < opts->replication || opts->new_servers < opts->replication)
+        return(NULL);
+    if(opts->old_virt_factor < 1)
+        return(NULL);
+    if(!opts->placement)
+        return(NULL);
+    if(opts->replication > CH_MAX_REPLICATION)
+        return(NULL);
+
+    return(opts);
+}
+
+/*
+ * Local variables:
+ *  c-indent-level: 4
+ *  c-basic-offset: 4
+ * End:
+ *
+ * vim: ft=c ts=8 sts=4 sw=4 expandtab
+ */
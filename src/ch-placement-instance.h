@@ -0,0 +1,52 @@
+/*
+ * Copyright (C) 2015 University of Chicago.
+ * See COPYRIGHT notice in top-level directory.
+ *
+ */
+
+#ifndef CH_PLACEMENT_INSTANCE_H
+#define CH_PLACEMENT_INSTANCE_H
+
+#include <stdint.h>
+
+#include "src/modules/placement-mod.h"
+#include "src/numa.h"
+
+/* private definition of the opaque handle returned by
+ * ch_placement_initialize(); shared by the library sources only
+ */
+struct ch_placement_instance
+{
+    struct placement_mod *mod;
+    unsigned int n_svrs;
+    unsigned long *domains; /* failure domain of each server, or NULL */
+    const uint64_t *down;   /* servers to skip; swapped atomically */
+    /* per NUMA node copies of mod (CH_PLACEMENT_NUMA_REPLICATE), or NULL;
+     * mod points at the first one
+     */
+    struct placement_mod **node_mods;
+    int n_node_mods;
+    double construction_time;   /* seconds to build mod (or node_mods) */
+};
+
+/* module to use for lookups from the calling thread */
+static inline struct placement_mod* placement_instance_mod(
+    struct ch_placement_instance *instance)
+{
+    if(instance->node_mods)
+        return(instance->node_mods[placement_numa_current_node() %
+            instance->n_node_mods]);
+
+    return(instance->mod);
+}
+
+#endif /* CH_PLACEMENT_INSTANCE_H */
+
+/*
+ * Local variables:
+ *  c-indent-level: 4
+ *  c-basic-offset: 4
+ * End:
+ *
+ * vim: ft=c ts=8 sts=4 sw=4 expandtab
+ */
@@ -17,7 +17,10 @@
  * factor and displays the servers that object would be mapped to.
  */
 
-/* ch-placement-test <module> <n_svrs> <virt_factor> <oid> <replication_factor>
+/* ch-placement-test <module> <n_svrs> <virt_factor> <oid> <replication_factor> [<n_domains>]
+ *
+ * If n_domains is given, server i is assigned to failure domain
+ * (i % n_domains) and replicas are placed in distinct domains.
  */
 
 int main(int argc, char **argv)
@@ -29,42 +32,54 @@ int main(int argc, char **argv)
     unsigned replication_factor;
     struct ch_placement_instance *inst;
     unsigned long server_idxs[CH_MAX_REPLICATION];
-    int i;
+    unsigned n_domains = 0;
+    unsigned long *domains = NULL;
+    unsigned int i, j;
 
     /* argument parsing */
     /**************************/
 
-    if(argc != 6)
+    if(argc != 6 && argc != 7)
     {
-        fprintf(stderr, "Usage: %s <module> <n_svrs> <virt_factor> <oid> <replication_factor>\n", argv[0]);
+        fprintf(stderr, "Usage: %s <module> <n_svrs> <virt_factor> <oid> <replication_factor> [<n_domains>]\n", argv[0]);
         return(-1);
     }
     ret = sscanf(argv[2], "%u", &n_svrs);
     if(ret != 1)
     {
-        fprintf(stderr, "Usage: %s <module> <n_svrs> <virt_factor> <oid> <replication_factor>\n", argv[0]);
+        fprintf(stderr, "Usage: %s <module> <n_svrs> <virt_factor> <oid> <replication_factor> [<n_domains>]\n", argv[0]);
         return(-1);
     }
     ret = sscanf(argv[3], "%u", &virt_factor);
     if(ret != 1)
     {
-        fprintf(stderr, "Usage: %s <module> <n_svrs> <virt_factor> <oid> <replication_factor>\n", argv[0]);
+        fprintf(stderr, "Usage: %s <module> <n_svrs> <virt_factor> <oid> <replication_factor> [<n_domains>]\n", argv[0]);
         return(-1);
     }
     /* TODO: make 32bit portable */
     ret = sscanf(argv[4], "%lu", &oid);
     if(ret != 1)
     {
-        fprintf(stderr, "Usage: %s <module> <n_svrs> <virt_factor> <oid> <replication_factor>\n", argv[0]);
+        fprintf(stderr, "Usage: %s <module> <n_svrs> <virt_factor> <oid> <replication_factor> [<n_domains>]\n", argv[0]);
         return(-1);
     }
     ret = sscanf(argv[5], "%u", &replication_factor);
     if(ret != 1)
     {
-        fprintf(stderr, "Usage: %s <module> <n_svrs> <virt_factor> <oid> <replication_factor>\n", argv[0]);
+        fprintf(stderr, "Usage: %s <module> <n_svrs> <virt_factor> <oid> <replication_factor> [<n_domains>]\n", argv[0]);
         return(-1);
     }
 
+    if(argc == 7)
+    {
+        ret = sscanf(argv[6], "%u", &n_domains);
+        if(ret != 1 || n_domains < 1)
+        {
+            fprintf(stderr, "Usage: %s <module> <n_svrs> <virt_factor> <oid> <replication_factor> [<n_domains>]\n", argv[0]);
+            return(-1);
+        }
+    }
+
     if(replication_factor > CH_MAX_REPLICATION)
     {
         fprintf(stderr, "Error: max replication level is %u\n", CH_MAX_REPLICATION);
@@ -81,11 +96,50 @@ int main(int argc, char **argv)
         return(-1);
     }
 
-    ch_placement_find_closest(inst, oid, replication_factor, server_idxs);
-    printf("<replica> <server index>\n========================\n");
-    for(i=0; i<replication_factor; i++)
+    if(!n_domains)
     {
-        printf("%d\t%lu\n", i, server_idxs[i]);
+        ch_placement_find_closest(inst, oid, replication_factor, server_idxs);
+        printf("<replica> <server index>\n========================\n");
+        for(i=0; i<replication_factor; i++)
+        {
+            printf("%u\t%lu\n", i, server_idxs[i]);
+        }
+    }
+    else
+    {
+        domains = malloc(n_svrs*sizeof(*domains));
+        if(!domains)
+        {
+            perror("malloc");
+            return(-1);
+        }
+        for(i=0; i<n_svrs; i++)
+            domains[i] = i % n_domains;
+
+        ret = ch_placement_set_domains(inst, domains);
+        if(ret == 0)
+            ret = ch_placement_find_closest_domains(inst, oid,
+                replication_factor, server_idxs);
+        if(ret < 0)
+        {
+            fprintf(stderr, "Error: failed to place %u replicas in distinct domains with %s\n", replication_factor, argv[1]);
+            return(-1);
+        }
+
+        printf("<replica> <server index> <domain>\n========================\n");
+        for(i=0; i<replication_factor; i++)
+        {
+            printf("%u\t%lu\t%lu\n", i, server_idxs[i], domains[server_idxs[i]]);
+            for(j=0; j<i; j++)
+            {
+                if(domains[server_idxs[j]] == domains[server_idxs[i]])
+                {
+                    fprintf(stderr, "Error: replicas %u and %u share domain %lu\n", j, i, domains[server_idxs[i]]);
+                    return(-1);
+                }
+            }
+        }
+        free(domains);
     }
 
     ch_placement_finalize(inst);
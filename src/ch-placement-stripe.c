@@ -28,13 +28,17 @@ int main(int argc, char **argv)
     unsigned replication_factor;
     struct ch_placement_instance *inst;
     unsigned long server_idxs[CH_MAX_REPLICATION];
-    int i,j;
+    unsigned int i,j;
     unsigned long file_size = 1099511627776UL; /* 1 TB */
     unsigned int max_stripe_width = 0;
     unsigned int strip_size = 1048576UL; /* 1 MB */
     unsigned int num_objs;
     uint64_t *oids;
     unsigned long *sizes;
+    unsigned long *svr_counts;
+    unsigned long *hist;
+    unsigned long width = 0;
+    unsigned long max_count = 0;
 
     /* argument parsing */
     /**************************/
@@ -95,6 +99,14 @@ int main(int argc, char **argv)
 
     ch_placement_create_striped(inst, file_size, replication_factor,
         max_stripe_width, strip_size, &num_objs, oids, sizes);
+    svr_counts = calloc(n_svrs, sizeof(*svr_counts));
+    hist = calloc(num_objs+1, sizeof(*hist));
+    if(!svr_counts || !hist)
+    {
+        perror("calloc");
+        return(-1);
+    }
+
     printf("<oid> <server indices>\n========================\n");
     for(j=0; j<num_objs; j++)
     {
@@ -103,10 +115,31 @@ int main(int argc, char **argv)
         for(i=0; i<replication_factor; i++)
         {
             printf("\t%lu", server_idxs[i]);
+            svr_counts[server_idxs[i]]++;
         }
         printf("\n");
     }
 
+    /* how many distinct servers the file touches, and how many of its
+     * objects pile up on each server
+     */
+    for(i=0; i<n_svrs; i++)
+    {
+        if(svr_counts[i])
+            width++;
+        if(svr_counts[i] > max_count)
+            max_count = svr_counts[i];
+        hist[svr_counts[i]]++;
+    }
+    printf("# Achieved width: %lu distinct servers for %u objects x %u replicas\n",
+        width, num_objs, replication_factor);
+    printf("# <objects on server>\t<servers>\n");
+    for(i=0; i<=max_count; i++)
+        printf("# %u\t%lu\n", i, hist[i]);
+
+    free(svr_counts);
+    free(hist);
+
     free(oids);
     free(sizes);
 
@@ -8,9 +8,26 @@
 #include <assert.h>
 #include <string.h>
 #include <stdlib.h>
+#include <time.h>
 
 #include "ch-placement.h"
 #include "src/modules/placement-mod.h"
+#include "src/ch-placement-instance.h"
+#include "src/spooky.h"
+
+/* seed used to turn variable length keys into oids */
+#define CH_PLACEMENT_KEY_SEED 0x6368706c6163656dULL
+
+/* number of keys hashed ahead of the corresponding lookups in a batch */
+#define CH_PLACEMENT_KEY_BATCH 64
+
+static double placement_wtime(void)
+{
+    struct timespec ts;
+
+    clock_gettime(CLOCK_MONOTONIC, &ts);
+    return((double)ts.tv_sec + (double)ts.tv_nsec / 1000000000);
+}
 
 /* externs pointing to api for each module */
 extern struct placement_mod_map xor_mod_map;
@@ -34,11 +51,6 @@ static struct placement_mod_map *table[] =
     NULL,
 };
 
-struct ch_placement_instance
-{
-    struct placement_mod *mod;
-};
-
 #ifdef CH_ENABLE_CRUSH
 #include "ch-placement-crush.h"
 extern struct placement_mod* placement_mod_crush(struct crush_map *map, __u32 *weight, int n_weight);
@@ -46,11 +58,19 @@ extern struct placement_mod* placement_mod_crush(struct crush_map *map, __u32 *w
 struct ch_placement_instance* ch_placement_initialize_crush(struct crush_map *map, __u32 *weight, int n_weight)
 {
     struct ch_placement_instance *instance = NULL;
+    double t1;
 
     instance = malloc(sizeof(*instance));
     if(instance)
     {
+        t1 = placement_wtime();
         instance->mod = placement_mod_crush(map, weight, n_weight);
+        instance->construction_time = placement_wtime() - t1;
+        instance->n_svrs = n_weight;
+        instance->domains = NULL;
+        instance->down = NULL;
+        instance->node_mods = NULL;
+        instance->n_node_mods = 0;
         if(!instance->mod)
         {
             free(instance);
@@ -65,8 +85,15 @@ struct ch_placement_instance* ch_placement_initialize_crush(struct crush_map *ma
 
 struct ch_placement_instance* ch_placement_initialize(const char* name,
     int n_svrs, int virt_factor, int seed)
+{
+    return(ch_placement_initialize_flags(name, n_svrs, virt_factor, seed, 0));
+}
+
+struct ch_placement_instance* ch_placement_initialize_flags(const char* name,
+    int n_svrs, int virt_factor, int seed, unsigned int flags)
 {
     struct ch_placement_instance *instance = NULL;
+    double t1;
     int i;
 
     for(i=0; table[i]!= NULL; i++)
@@ -76,7 +103,20 @@ struct ch_placement_instance* ch_placement_initialize(const char* name,
             instance = malloc(sizeof(*instance));
             if(instance)
             {
-                instance->mod = table[i]->initiate(n_svrs, virt_factor, seed);
+                instance->node_mods = NULL;
+                instance->n_node_mods = 0;
+                t1 = placement_wtime();
+                if(flags & CH_PLACEMENT_NUMA_REPLICATE)
+                    instance->node_mods = placement_numa_build(table[i],
+                        n_svrs, virt_factor, seed, &instance->n_node_mods);
+                if(instance->node_mods)
+                    instance->mod = instance->node_mods[0];
+                else
+                    instance->mod = table[i]->initiate(n_svrs, virt_factor, seed);
+                instance->construction_time = placement_wtime() - t1;
+                instance->n_svrs = n_svrs;
+                instance->domains = NULL;
+                instance->down = NULL;
                 if(!instance->mod)
                 {
                     free(instance);
@@ -90,17 +130,15 @@ struct ch_placement_instance* ch_placement_initialize(const char* name,
     return(instance);
 }
 
-void placement_create_striped_random(struct placement_mod *mod, 
-    unsigned long file_size, 
-  unsigned int replication, unsigned int max_stripe_width, 
-  unsigned int strip_size,
-  unsigned int* num_objects,
-  uint64_t *oids, unsigned long *sizes)
+unsigned int placement_stripe_sizes(unsigned long file_size,
+    unsigned int max_stripe_width, unsigned int strip_size,
+    unsigned long *sizes)
 {
     unsigned int stripe_width;
     int i;
     unsigned long size_left = file_size;
     unsigned long full_stripes;
+    unsigned long check_size = 0;
 
     /* how many objects to use */
     stripe_width = file_size / strip_size + 1;
@@ -108,7 +146,6 @@ void placement_create_striped_random(struct placement_mod *mod,
         stripe_width--;
     if(stripe_width > max_stripe_width)
         stripe_width = max_stripe_width;
-    *num_objects = stripe_width;
 
     /* size of each object */
     full_stripes = size_left/(stripe_width*strip_size);
@@ -131,51 +168,331 @@ void placement_create_striped_random(struct placement_mod *mod,
                 size_left = 0;
             }
         }
+        check_size += sizes[i];
     }
+    assert(check_size == file_size);
+    assert(size_left == 0);
 
-    /* oid of each object */
-    for(i=0; i<stripe_width; i++)
+    return(stripe_width);
+}
+
+/* splitmix64; used to expand a single seed into a full xoshiro state */
+static uint64_t rng_splitmix64(uint64_t *x)
+{
+    uint64_t z = (*x += 0x9E3779B97F4A7C15ULL);
+
+    z = (z ^ (z >> 30)) * 0xBF58476D1CE4E5B9ULL;
+    z = (z ^ (z >> 27)) * 0x94D049BB133111EBULL;
+    return(z ^ (z >> 31));
+}
+
+static inline uint64_t rng_rotl(uint64_t x, int k)
+{
+    return((x << k) | (x >> (64 - k)));
+}
+
+void ch_placement_rng_seed(struct ch_placement_rng *rng, uint64_t seed)
+{
+    int i;
+
+    for(i=0; i<4; i++)
+        rng->s[i] = rng_splitmix64(&seed);
+
+    return;
+}
+
+/* xoshiro256** */
+uint64_t ch_placement_rng_next(struct ch_placement_rng *rng)
+{
+    uint64_t *s = rng->s;
+    uint64_t result = rng_rotl(s[1] * 5, 7) * 9;
+    uint64_t t = s[1] << 17;
+
+    s[2] ^= s[0];
+    s[3] ^= s[1];
+    s[1] ^= s[2];
+    s[0] ^= s[3];
+    s[2] ^= t;
+    s[3] = rng_rotl(s[3], 45);
+
+    return(result);
+}
+
+void ch_placement_rng_jump(struct ch_placement_rng *rng)
+{
+    static const uint64_t jump[] = {0x180ec6d33cfd0abaULL,
+        0xd5a61266f0c9392cULL, 0xa9582618e03fc9aaULL, 0x39abdc4529b1661cULL};
+    uint64_t s[4] = {0, 0, 0, 0};
+    int i, b, j;
+
+    for(i=0; i<4; i++)
     {
-        oids[i] = ch_placement_random_u64();
+        for(b=0; b<64; b++)
+        {
+            if(jump[i] & (1ULL << b))
+            {
+                for(j=0; j<4; j++)
+                    s[j] ^= rng->s[j];
+            }
+            ch_placement_rng_next(rng);
+        }
     }
+    memcpy(rng->s, s, sizeof(s));
 
     return;
 }
 
-/* TODO: optimize this */
-uint64_t ch_placement_random_u64(void)
-{
-    uint64_t bigr = 0;
-    uint64_t litr;
-    int i;
+/* stream used by ch_placement_random_u64() in the calling thread.  Each
+ * thread that has not been seeded explicitly starts from its own stream,
+ * derived from the order in which threads first ask for one.
+ */
+static __thread struct ch_placement_rng thread_rng;
+static __thread int thread_rng_seeded = 0;
+static uint64_t thread_rng_count = 0;
 
-    for(i=0; i<8; i++)
+static struct ch_placement_rng* placement_thread_rng(void)
+{
+    if(!thread_rng_seeded)
     {
-        litr = random();
-        litr = litr & 0xFF;
-        bigr += (litr << (i*8));
+        ch_placement_rng_seed(&thread_rng,
+            __atomic_fetch_add(&thread_rng_count, 1, __ATOMIC_RELAXED));
+        thread_rng_seeded = 1;
     }
 
-    return(bigr);
+    return(&thread_rng);
+}
+
+void ch_placement_random_seed(uint64_t seed)
+{
+    ch_placement_rng_seed(&thread_rng, seed);
+    thread_rng_seeded = 1;
+
+    return;
+}
+
+uint64_t ch_placement_random_u64(void)
+{
+    return(ch_placement_rng_next(placement_thread_rng()));
 }
 
 void ch_placement_finalize(struct ch_placement_instance *instance)
 {
-    instance->mod->finalize(instance->mod);
+    int i;
+
+    if(instance->node_mods)
+    {
+        for(i=0; i<instance->n_node_mods; i++)
+            instance->node_mods[i]->finalize(instance->node_mods[i]);
+        free(instance->node_mods);
+    }
+    else
+        instance->mod->finalize(instance->mod);
+    free(instance->domains);
     free(instance);
     return;
 }
 
+int ch_placement_get_footprint(struct ch_placement_instance *instance,
+    struct ch_placement_footprint *fp)
+{
+    int i;
+
+    memset(fp, 0, sizeof(*fp));
+    if(instance->node_mods)
+    {
+        for(i=0; i<instance->n_node_mods; i++)
+            placement_arena_footprint(instance->node_mods[i]->arena, fp);
+    }
+    else if(instance->mod->arena)
+        placement_arena_footprint(instance->mod->arena, fp);
+    else
+        return(-1);
+
+    return(0);
+}
+
+int ch_placement_get_stats(struct ch_placement_instance *instance,
+    struct ch_placement_stats *stats)
+{
+    unsigned int i;
+
+    memset(stats, 0, sizeof(*stats));
+    stats->construction_time = instance->construction_time;
+    stats->replicas = instance->node_mods ? instance->n_node_mods : 1;
+    if(!instance->mod->get_stats)
+        return(-1);
+
+    /* every replica has the same tables */
+    instance->mod->get_stats(instance->mod, stats);
+    for(i=0; i<stats->n_tables; i++)
+        stats->bytes += stats->tables[i].bytes;
+    stats->bytes *= stats->replicas;
+
+    return(0);
+}
+
 void ch_placement_find_closest(
     struct ch_placement_instance *instance,
     uint64_t obj, 
     unsigned int replication, 
     unsigned long* server_idxs)
 {
-    instance->mod->find_closest(instance->mod, obj, replication, server_idxs);
+    struct placement_mod *mod = placement_instance_mod(instance);
+    struct placement_filter filter;
+    int placed;
+
+    /* guarantees that ring walks can find enough distinct servers */
+    assert(replication <= CH_MAX_REPLICATION && replication <= instance->n_svrs);
+
+    filter.down = __atomic_load_n(&instance->down, __ATOMIC_ACQUIRE);
+    if(!filter.down)
+    {
+        mod->find_closest(mod, obj, replication, server_idxs);
+        return;
+    }
+
+    /* some servers are down; walk past them in each module's natural order */
+    assert(mod->find_closest_filtered);
+    filter.domains = NULL;
+    filter.distinct = 0;
+    placed = mod->find_closest_filtered(mod, obj,
+        replication, &filter, server_idxs);
+    /* too few servers up; never leave entries uninitialized */
+    for(; placed < (int)replication; placed++)
+        server_idxs[placed] = CH_PLACEMENT_NO_SERVER;
+
     return;
 }
 
+void ch_placement_find_closest_batch(
+    struct ch_placement_instance *instance,
+    unsigned long n_objs,
+    const uint64_t *objs,
+    unsigned int replication,
+    unsigned long* server_idxs)
+{
+    struct placement_mod *mod = placement_instance_mod(instance);
+    unsigned long i;
+
+    assert(replication <= CH_MAX_REPLICATION && replication <= instance->n_svrs);
+
+    /* down servers go through the filtered path one object at a time */
+    if(mod->find_closest_batch &&
+        !__atomic_load_n(&instance->down, __ATOMIC_ACQUIRE))
+    {
+        mod->find_closest_batch(mod, n_objs, objs, replication, server_idxs);
+        return;
+    }
+
+    for(i=0; i<n_objs; i++)
+        ch_placement_find_closest(instance, objs[i], replication,
+            &server_idxs[i*replication]);
+
+    return;
+}
+
+uint64_t ch_placement_hash_key(const void *key, size_t key_len)
+{
+    if(key_len == 16)
+        return(spooky_hash64_16(key, CH_PLACEMENT_KEY_SEED));
+
+    return(spooky_hash64(key, key_len, CH_PLACEMENT_KEY_SEED));
+}
+
+void ch_placement_find_closest_key(
+    struct ch_placement_instance *instance,
+    const void *key,
+    size_t key_len,
+    unsigned int replication,
+    unsigned long* server_idxs)
+{
+    ch_placement_find_closest(instance, ch_placement_hash_key(key, key_len),
+        replication, server_idxs);
+    return;
+}
+
+void ch_placement_find_closest_key_batch(
+    struct ch_placement_instance *instance,
+    unsigned long n_keys,
+    const void * const *keys,
+    const size_t *key_lens,
+    unsigned int replication,
+    unsigned long* server_idxs)
+{
+    uint64_t objs[CH_PLACEMENT_KEY_BATCH];
+    unsigned long i, j, n;
+
+    /* hash a block of keys first so the hashing loop stays tight and
+     * independent of the (memory bound) table searches that follow
+     */
+    for(i=0; i<n_keys; i+=CH_PLACEMENT_KEY_BATCH)
+    {
+        n = n_keys - i;
+        if(n > CH_PLACEMENT_KEY_BATCH)
+            n = CH_PLACEMENT_KEY_BATCH;
+        for(j=0; j<n; j++)
+            objs[j] = ch_placement_hash_key(keys[i+j], key_lens[i+j]);
+        ch_placement_find_closest_batch(instance, n, objs, replication,
+            &server_idxs[i*replication]);
+    }
+
+    return;
+}
+
+const uint64_t* ch_placement_set_down(
+    struct ch_placement_instance *instance,
+    const uint64_t *down)
+{
+    return(__atomic_exchange_n(&instance->down, down, __ATOMIC_ACQ_REL));
+}
+
+int ch_placement_set_domains(
+    struct ch_placement_instance *instance,
+    const unsigned long *domains)
+{
+    unsigned long *copy = NULL;
+
+    if(domains)
+    {
+        copy = malloc(instance->n_svrs*sizeof(*copy));
+        if(!copy)
+            return(-1);
+        memcpy(copy, domains, instance->n_svrs*sizeof(*copy));
+    }
+
+    free(instance->domains);
+    instance->domains = copy;
+
+    return(0);
+}
+
+int ch_placement_find_closest_domains(
+    struct ch_placement_instance *instance,
+    uint64_t obj,
+    unsigned int replication,
+    unsigned long* server_idxs)
+{
+    struct placement_mod *mod = placement_instance_mod(instance);
+    struct placement_filter filter;
+    int placed;
+
+    if(!mod->find_closest_filtered)
+        return(-1);
+    if(replication > CH_MAX_REPLICATION || replication > instance->n_svrs)
+        return(-1);
+
+    filter.domains = instance->domains;
+    filter.down = __atomic_load_n(&instance->down, __ATOMIC_ACQUIRE);
+    filter.distinct = 1;
+
+    placed = mod->find_closest_filtered(mod, obj,
+        replication, &filter, server_idxs);
+    if(placed < (int)replication)
+        return(-1);
+
+    return(0);
+}
+
 void ch_placement_create_striped(
     struct ch_placement_instance *instance,
     unsigned long file_size, 
@@ -186,12 +503,108 @@ void ch_placement_create_striped(
     uint64_t *oids, 
     unsigned long *sizes)
 {
-    instance->mod->create_striped(instance->mod, file_size,
-        replication, max_stripe_width, strip_size, num_objects, oids,
-        sizes);
+    ch_placement_create_striped_rng(instance, placement_thread_rng(),
+        file_size, replication, max_stripe_width, strip_size, num_objects,
+        oids, sizes);
     return;
 }
 
+void ch_placement_create_striped_rng(
+    struct ch_placement_instance *instance,
+    struct ch_placement_rng *rng,
+    unsigned long file_size, 
+    unsigned int replication, 
+    unsigned int max_stripe_width, 
+    unsigned int strip_size,
+    unsigned int* num_objects,
+    uint64_t *oids, 
+    unsigned long *sizes)
+{
+    struct placement_mod *mod = placement_instance_mod(instance);
+
+    /* the striping engines look up into CH_MAX_REPLICATION sized buffers
+     * and need enough distinct servers
+     */
+    if(replication > CH_MAX_REPLICATION || replication > instance->n_svrs)
+    {
+        *num_objects = 0;
+        return;
+    }
+
+    mod->create_striped(mod, rng, file_size, replication, max_stripe_width,
+        strip_size, num_objects, oids, sizes);
+    return;
+}
+
+int ch_placement_stripe_oid(
+    struct ch_placement_instance *instance,
+    uint64_t file_id,
+    unsigned long stripe_idx,
+    unsigned int replication,
+    uint64_t *oid)
+{
+    struct placement_mod *mod = placement_instance_mod(instance);
+    uint64_t oids[PLACEMENT_STRIPE_GROUP];
+    unsigned long first;
+
+    if(replication > CH_MAX_REPLICATION || replication > instance->n_svrs)
+        return(-1);
+
+    if(mod->stripe_oid)
+    {
+        *oid = mod->stripe_oid(mod, file_id, stripe_idx, replication);
+        return(0);
+    }
+
+    /* each stripe depends on the ones before it in its group; replay them */
+    first = stripe_idx - stripe_idx % PLACEMENT_STRIPE_GROUP;
+    if(placement_stripe_disjoint(mod, NULL, file_id, first,
+        replication, stripe_idx - first + 1, oids) < 0)
+        return(-1);
+    *oid = oids[stripe_idx - first];
+
+    return(0);
+}
+
+int ch_placement_create_striped_file(
+    struct ch_placement_instance *instance,
+    uint64_t file_id,
+    unsigned long file_size, 
+    unsigned int replication, 
+    unsigned int max_stripe_width, 
+    unsigned int strip_size,
+    unsigned int* num_objects,
+    uint64_t *oids, 
+    unsigned long *sizes)
+{
+    struct placement_mod *mod = placement_instance_mod(instance);
+    unsigned int i, n;
+
+    if(replication > CH_MAX_REPLICATION || replication > instance->n_svrs)
+        return(-1);
+
+    *num_objects = placement_stripe_sizes(file_size, max_stripe_width,
+        strip_size, sizes);
+    if(mod->stripe_oid)
+    {
+        for(i=0; i<*num_objects; i++)
+            oids[i] = mod->stripe_oid(mod, file_id, i, replication);
+        return(0);
+    }
+
+    for(i=0; i<*num_objects; i+=PLACEMENT_STRIPE_GROUP)
+    {
+        n = *num_objects - i;
+        if(n > PLACEMENT_STRIPE_GROUP)
+            n = PLACEMENT_STRIPE_GROUP;
+        if(placement_stripe_disjoint(mod, NULL, file_id, i,
+            replication, n, &oids[i]) < 0)
+            return(-1);
+    }
+
+    return(0);
+}
+
 /*
  * Local variables:
  *  c-indent-level: 4
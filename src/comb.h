@@ -9,6 +9,8 @@
 
 #include <limits.h>
 #include <stdint.h>
+#include <stdlib.h>
+#include <string.h>
 
 static inline uint64_t choose(uint64_t n, uint64_t k){
     uint64_t res = 1, i;
@@ -18,6 +20,49 @@ static inline uint64_t choose(uint64_t n, uint64_t k){
     return res;
 }
 
+/* table of binomial coefficients choose(v, j) for v <= n, j <= k.  Built
+ * with Pascal's rule, so no intermediate products overflow; entries that
+ * do not fit saturate at UINT64_MAX.
+ */
+struct comb_binom {
+    unsigned long n;
+    unsigned int k;
+    uint64_t *c;
+};
+
+static inline int comb_binom_init(struct comb_binom *b, unsigned long n,
+        unsigned int k){
+    unsigned long v;
+    unsigned int j;
+    uint64_t sum;
+
+    b->n = n;
+    b->k = k;
+    b->c = calloc((n+1)*(k+1), sizeof(*b->c));
+    if (!b->c)
+        return -1;
+    for (v = 0; v <= n; v++){
+        b->c[v*(k+1)] = 1;
+        for (j = 1; j <= k && v > 0; j++){
+            sum = b->c[(v-1)*(k+1)+j-1] + b->c[(v-1)*(k+1)+j];
+            if (sum < b->c[(v-1)*(k+1)+j])
+                sum = UINT64_MAX;
+            b->c[v*(k+1)+j] = sum;
+        }
+    }
+    return 0;
+}
+
+static inline void comb_binom_free(struct comb_binom *b){
+    free(b->c);
+    b->c = NULL;
+}
+
+static inline uint64_t comb_binom_get(const struct comb_binom *b,
+        unsigned long v, unsigned int j){
+    return b->c[v*(b->k+1)+j];
+}
+
 /* Returns canonical linear index in (N choose k) for arbitrary N
  * The ordering is descending with respect to the reverse
  * lexicographic order of the sets.
@@ -26,12 +71,15 @@ static inline uint64_t choose(uint64_t n, uint64_t k){
  *       indexes:     5,     4,     3,     2,     1,     0
  * k = 3, comb = {4,2,1}
  * index = 4 choose 3 + 2 choose 2 + 1 choose 1 = 7
+ * The binomials come from b, which must cover N and k.
  * NOTE: Function expects inputs in descending order */
-static inline uint64_t comb_index(unsigned long k, unsigned long *vals){
-    unsigned long i, res=0;
+static inline uint64_t comb_index(const struct comb_binom *b, unsigned long k,
+        unsigned long *vals){
+    unsigned long i;
+    uint64_t res=0;
     /* step in reverse order */
     for (i = 0; i < k; i++){
-        res += choose(vals[i],k-i);
+        res += comb_binom_get(b, vals[i], k-i);
     }
     return res;
 }
@@ -49,6 +97,90 @@ static inline void rev_ins_sort(unsigned int n, uint64_t *vals){
     }
 }
 
+/* sparse per-combination counters: an open addressing hash table keyed
+ * by combination index, so memory follows the number of combinations
+ * actually used rather than (N choose k).  Not thread safe; give each
+ * thread its own table and merge them.
+ */
+struct comb_count {
+    uint64_t key;       /* combination index + 1; 0 marks an empty slot */
+    unsigned long count;
+    unsigned long bytes;
+};
+
+struct comb_counts {
+    unsigned long size; /* slots, a power of two */
+    unsigned long used;
+    struct comb_count *slots;
+};
+
+static inline int comb_counts_init(struct comb_counts *c){
+    c->size = 1024;
+    c->used = 0;
+    c->slots = calloc(c->size, sizeof(*c->slots));
+    return c->slots ? 0 : -1;
+}
+
+static inline void comb_counts_free(struct comb_counts *c){
+    free(c->slots);
+    c->slots = NULL;
+}
+
+static inline struct comb_count* comb_counts_slot(struct comb_count *slots,
+        unsigned long size, uint64_t key){
+    unsigned long i = (key * 0x9e3779b97f4a7c15ULL) >> 20 & (size - 1);
+
+    while (slots[i].key != 0 && slots[i].key != key)
+        i = (i + 1) & (size - 1);
+    return &slots[i];
+}
+
+/* adds count and bytes to the counters of combination idx; returns -1 if
+ * the table could not grow
+ */
+static inline int comb_counts_add(struct comb_counts *c, uint64_t idx,
+        unsigned long count, unsigned long bytes){
+    struct comb_count *slot, *slots;
+    unsigned long i;
+
+    /* keep the load factor at or below one half */
+    if (2*(c->used + 1) > c->size){
+        slots = calloc(2*c->size, sizeof(*slots));
+        if (!slots)
+            return -1;
+        for (i = 0; i < c->size; i++){
+            if (c->slots[i].key)
+                *comb_counts_slot(slots, 2*c->size, c->slots[i].key) =
+                    c->slots[i];
+        }
+        free(c->slots);
+        c->slots = slots;
+        c->size *= 2;
+    }
+
+    slot = comb_counts_slot(c->slots, c->size, idx + 1);
+    if (!slot->key){
+        slot->key = idx + 1;
+        c->used++;
+    }
+    slot->count += count;
+    slot->bytes += bytes;
+    return 0;
+}
+
+static inline int comb_counts_merge(struct comb_counts *dst,
+        const struct comb_counts *src){
+    unsigned long i;
+
+    for (i = 0; i < src->size; i++){
+        if (src->slots[i].key &&
+            comb_counts_add(dst, src->slots[i].key - 1, src->slots[i].count,
+                src->slots[i].bytes) < 0)
+            return -1;
+    }
+    return 0;
+}
+
 #endif /* end of include guard: COMB_H */
 
 /*
@@ -0,0 +1,401 @@
+/*
+ * Copyright (C) 2015 University of Chicago.
+ * See COPYRIGHT notice in top-level directory.
+ *
+ */
+
+#include <stdlib.h>
+#include <string.h>
+#include <unistd.h>
+#include <pthread.h>
+
+#include "ch-placement.h"
+#include "ch-placement-diff.h"
+#include "src/modules/placement-mod.h"
+#include "src/ch-placement-instance.h"
+
+/* 2^64, the size of the oid space */
+#define OID_SPACE 18446744073709551616.0
+
+struct diff_sample_arg
+{
+    struct ch_placement_instance *a;
+    struct ch_placement_instance *b;
+    unsigned int replication;
+    unsigned long first;
+    unsigned long last;
+    unsigned int n_svrs;
+    uint64_t *counts;
+    unsigned long moved;
+};
+
+static int u64_cmp(const void* a, const void *b);
+static int diff_exact(struct ch_placement_instance *a,
+    struct ch_placement_instance *b, unsigned int replication,
+    struct ch_placement_diff *diff);
+static int diff_sampled(struct ch_placement_instance *a,
+    struct ch_placement_instance *b, unsigned int replication,
+    unsigned long samples, int n_threads, struct ch_placement_diff *diff);
+static void* diff_sample_thread(void *arg);
+static unsigned int diff_transfers(unsigned int replication,
+    const unsigned long *old_idxs, const unsigned long *new_idxs,
+    unsigned long *srcs, unsigned long *dsts);
+static int diff_run(struct ch_placement_instance *a,
+    struct ch_placement_instance *b, unsigned int replication,
+    unsigned long samples, int n_threads, int try_exact,
+    struct ch_placement_diff **diff);
+
+int ch_placement_diff(
+    struct ch_placement_instance *a,
+    struct ch_placement_instance *b,
+    unsigned int replication,
+    unsigned long samples,
+    int n_threads,
+    struct ch_placement_diff **diff)
+{
+    return(diff_run(a, b, replication, samples, n_threads, 1, diff));
+}
+
+int ch_placement_diff_sampled(
+    struct ch_placement_instance *a,
+    struct ch_placement_instance *b,
+    unsigned int replication,
+    unsigned long samples,
+    int n_threads,
+    struct ch_placement_diff **diff)
+{
+    return(diff_run(a, b, replication, samples, n_threads, 0, diff));
+}
+
+static int diff_run(struct ch_placement_instance *a,
+    struct ch_placement_instance *b, unsigned int replication,
+    unsigned long samples, int n_threads, int try_exact,
+    struct ch_placement_diff **diff)
+{
+    struct ch_placement_diff *d;
+    int ret = -1;
+
+    if(replication > CH_MAX_REPLICATION)
+        return(-1);
+
+    d = malloc(sizeof(*d));
+    if(!d)
+        return(-1);
+    memset(d, 0, sizeof(*d));
+
+    d->n_svrs = a->n_svrs > b->n_svrs ? a->n_svrs : b->n_svrs;
+    d->matrix = calloc((size_t)d->n_svrs*d->n_svrs, sizeof(*d->matrix));
+    if(!d->matrix)
+    {
+        free(d);
+        return(-1);
+    }
+
+    if(try_exact && a->mod->get_arcs && b->mod->get_arcs)
+        ret = diff_exact(a, b, replication, d);
+    if(ret < 0 && samples > 0)
+        ret = diff_sampled(a, b, replication, samples, n_threads, d);
+
+    if(ret < 0)
+    {
+        ch_placement_diff_free(d);
+        return(-1);
+    }
+
+    *diff = d;
+    return(0);
+}
+
+void ch_placement_diff_free(struct ch_placement_diff *diff)
+{
+    free(diff->arcs);
+    free(diff->matrix);
+    free(diff);
+
+    return;
+}
+
+/* merges the arc boundaries of both instances; within each resulting
+ * sub-arc the placement is constant in both, so a single lookup on each
+ * side tells whether (and where) the whole sub-arc moves
+ */
+static int diff_exact(struct ch_placement_instance *a,
+    struct ch_placement_instance *b, unsigned int replication,
+    struct ch_placement_diff *diff)
+{
+    unsigned int n_rings, n_rings_b;
+    unsigned int ring;
+    unsigned long n_a, n_b, n_starts, i, j;
+    uint64_t *starts;
+    uint64_t start, len, oid, skew;
+    unsigned long old_idxs[CH_MAX_REPLICATION];
+    unsigned long new_idxs[CH_MAX_REPLICATION];
+    unsigned long srcs[CH_MAX_REPLICATION];
+    unsigned long dsts[CH_MAX_REPLICATION];
+    unsigned int n_moves;
+    unsigned long arcs_size = 0;
+    struct ch_placement_moved_arc *tmp_arcs;
+    double fraction;
+
+    a->mod->get_arcs(a->mod, 0, &n_rings, NULL);
+    b->mod->get_arcs(b->mod, 0, &n_rings_b, NULL);
+    /* oids would be partitioned differently; no common arc structure */
+    if(n_rings != n_rings_b)
+        return(-1);
+
+    for(ring=0; ring<n_rings; ring++)
+    {
+        n_a = a->mod->get_arcs(a->mod, ring, &n_rings, NULL);
+        n_b = b->mod->get_arcs(b->mod, ring, &n_rings, NULL);
+        starts = malloc((n_a+n_b)*sizeof(*starts));
+        if(!starts)
+            return(-1);
+        a->mod->get_arcs(a->mod, ring, &n_rings, starts);
+        b->mod->get_arcs(b->mod, ring, &n_rings, &starts[n_a]);
+
+        qsort(starts, n_a+n_b, sizeof(*starts), u64_cmp);
+        n_starts = 0;
+        for(i=0; i<n_a+n_b; i++)
+        {
+            if(n_starts == 0 || starts[i] != starts[n_starts-1])
+                starts[n_starts++] = starts[i];
+        }
+
+        for(i=0; i<n_starts; i++)
+        {
+            /* the last sub-arc wraps around to the first start point */
+            start = starts[i];
+            len = starts[(i+1)%n_starts] - start;
+            if(n_starts == 1)
+                fraction = 1.0 / n_rings;
+            else
+                fraction = (double)len / OID_SPACE / n_rings;
+
+            /* pick an oid strictly inside the sub-arc that maps to this
+             * ring; the start point itself is avoided because lookups may
+             * resolve an oid equal to a vnode id to either neighbor
+             */
+            oid = start + 1;
+            skew = (ring + n_rings - oid % n_rings) % n_rings;
+            if(oid + skew < oid)
+                oid = ring; /* wrapped past the top of oid space */
+            else
+                oid += skew;
+            if(n_starts > 1 && oid - start >= len)
+                continue;
+
+            diff->examined++;
+            ch_placement_find_closest(a, oid, replication, old_idxs);
+            ch_placement_find_closest(b, oid, replication, new_idxs);
+            n_moves = diff_transfers(replication, old_idxs, new_idxs, srcs, dsts);
+            if(!n_moves)
+                continue;
+
+            diff->moved_fraction += fraction;
+            for(j=0; j<n_moves; j++)
+            {
+                diff->matrix[srcs[j]*diff->n_svrs + dsts[j]] += fraction;
+
+                if(diff->n_arcs == arcs_size)
+                {
+                    arcs_size = arcs_size ? arcs_size*2 : 1024;
+                    tmp_arcs = realloc(diff->arcs, arcs_size*sizeof(*tmp_arcs));
+                    if(!tmp_arcs)
+                    {
+                        free(starts);
+                        return(-1);
+                    }
+                    diff->arcs = tmp_arcs;
+                }
+                diff->arcs[diff->n_arcs].ring = ring;
+                diff->arcs[diff->n_arcs].start = start;
+                diff->arcs[diff->n_arcs].end = start + len;
+                diff->arcs[diff->n_arcs].src = srcs[j];
+                diff->arcs[diff->n_arcs].dst = dsts[j];
+                diff->n_arcs++;
+            }
+        }
+
+        free(starts);
+    }
+
+    diff->exact = 1;
+
+    return(0);
+}
+
+static int diff_sampled(struct ch_placement_instance *a,
+    struct ch_placement_instance *b, unsigned int replication,
+    unsigned long samples, int n_threads, struct ch_placement_diff *diff)
+{
+    struct diff_sample_arg *args;
+    pthread_t *threads;
+    uint64_t *counts;
+    unsigned long moved = 0;
+    unsigned long i;
+    int t;
+    int n_started;
+    int ret;
+
+    if(n_threads < 1)
+        n_threads = sysconf(_SC_NPROCESSORS_ONLN);
+    if(n_threads < 1)
+        n_threads = 1;
+    if((unsigned long)n_threads > samples)
+        n_threads = samples;
+
+    args = malloc(n_threads*sizeof(*args));
+    threads = malloc(n_threads*sizeof(*threads));
+    counts = calloc((size_t)diff->n_svrs*diff->n_svrs, sizeof(*counts));
+    if(!args || !threads || !counts)
+    {
+        free(args);
+        free(threads);
+        free(counts);
+        return(-1);
+    }
+
+    for(t=0; t<n_threads; t++)
+    {
+        args[t].a = a;
+        args[t].b = b;
+        args[t].replication = replication;
+        args[t].first = (samples/n_threads)*t;
+        args[t].last = (t == n_threads-1) ? samples : (samples/n_threads)*(t+1);
+        args[t].n_svrs = diff->n_svrs;
+        args[t].counts = counts;
+        args[t].moved = 0;
+    }
+
+    /* if a thread cannot be created, its range (and every later one) is
+     * sampled on the calling thread instead
+     */
+    for(n_started=1; n_started<n_threads; n_started++)
+    {
+        ret = pthread_create(&threads[n_started], NULL, diff_sample_thread,
+            &args[n_started]);
+        if(ret != 0)
+            break;
+    }
+    diff_sample_thread(&args[0]);
+    for(t=n_started; t<n_threads; t++)
+        diff_sample_thread(&args[t]);
+    for(t=1; t<n_started; t++)
+        pthread_join(threads[t], NULL);
+    for(t=0; t<n_threads; t++)
+        moved += args[t].moved;
+
+    for(i=0; i<(unsigned long)diff->n_svrs*diff->n_svrs; i++)
+        diff->matrix[i] = (double)counts[i] / (double)samples;
+    diff->moved_fraction = (double)moved / (double)samples;
+    diff->examined = samples;
+    diff->exact = 0;
+    diff->n_arcs = 0;
+
+    free(args);
+    free(threads);
+    free(counts);
+
+    return(0);
+}
+
+static void* diff_sample_thread(void *arg)
+{
+    struct diff_sample_arg *sa = arg;
+    unsigned long old_idxs[CH_MAX_REPLICATION];
+    unsigned long new_idxs[CH_MAX_REPLICATION];
+    unsigned long srcs[CH_MAX_REPLICATION];
+    unsigned long dsts[CH_MAX_REPLICATION];
+    unsigned int n_moves;
+    unsigned long i, j;
+    uint64_t oid;
+
+    for(i=sa->first; i<sa->last; i++)
+    {
+        /* splitmix64 finalizer; a well mixed, reproducible oid per sample */
+        oid = (uint64_t)(i+1) * 0x9E3779B97F4A7C15ULL;
+        oid = (oid ^ (oid >> 30)) * 0xBF58476D1CE4E5B9ULL;
+        oid = (oid ^ (oid >> 27)) * 0x94D049BB133111EBULL;
+        oid = oid ^ (oid >> 31);
+
+        ch_placement_find_closest(sa->a, oid, sa->replication, old_idxs);
+        ch_placement_find_closest(sa->b, oid, sa->replication, new_idxs);
+        n_moves = diff_transfers(sa->replication, old_idxs, new_idxs, srcs, dsts);
+        if(!n_moves)
+            continue;
+
+        sa->moved++;
+        for(j=0; j<n_moves; j++)
+            __atomic_fetch_add(&sa->counts[srcs[j]*sa->n_svrs + dsts[j]], 1,
+                __ATOMIC_RELAXED);
+    }
+
+    return(NULL);
+}
+
+/* lists the copies needed to turn old_idxs into new_idxs.  Each server
+ * that gains a replica is paired with one that lost it; if none is left,
+ * the primary of the old replica set is used as the source.
+ */
+static unsigned int diff_transfers(unsigned int replication,
+    const unsigned long *old_idxs, const unsigned long *new_idxs,
+    unsigned long *srcs, unsigned long *dsts)
+{
+    unsigned int n_moves = 0;
+    unsigned int i, j;
+    unsigned int next_src = 0;
+
+    for(i=0; i<replication; i++)
+    {
+        for(j=0; j<replication; j++)
+        {
+            if(new_idxs[i] == old_idxs[j])
+                break;
+        }
+        if(j < replication)
+            continue;
+
+        /* find the next old replica that is no longer used */
+        for(; next_src<replication; next_src++)
+        {
+            for(j=0; j<replication; j++)
+            {
+                if(old_idxs[next_src] == new_idxs[j])
+                    break;
+            }
+            if(j == replication)
+                break;
+        }
+
+        dsts[n_moves] = new_idxs[i];
+        if(next_src < replication)
+            srcs[n_moves] = old_idxs[next_src++];
+        else
+            srcs[n_moves] = old_idxs[0];
+        n_moves++;
+    }
+
+    return(n_moves);
+}
+
+static int u64_cmp(const void* a, const void *b)
+{
+    const uint64_t *u_a = a;
+    const uint64_t *u_b = b;
+
+    if(*u_a < *u_b)
+        return(-1);
+    else if(*u_a > *u_b)
+        return(1);
+    else
+        return(0);
+}
+
+/*
+ * Local variables:
+ *  c-indent-level: 4
+ *  c-basic-offset: 4
+ * End:
+ *
+ * vim: ft=c ts=8 sts=4 sw=4 expandtab
+ */
@@ -0,0 +1,357 @@
+/*
+ * Copyright (C) 2015 University of Chicago.
+ * See COPYRIGHT notice in top-level directory.
+ *
+ */
+
+#include <stdlib.h>
+#include <string.h>
+#include <assert.h>
+#include <sched.h>
+#include <pthread.h>
+
+#include "ch-placement.h"
+
+/* Epoch based reclamation for ch_placement_handle.
+ *
+ * Readers advertise the global epoch they observed in a private slot
+ * before loading the current snapshot, and clear the slot when done.  A
+ * writer swaps in a new snapshot, advances the global epoch, and retires
+ * the old snapshot tagged with the new epoch.  Retired state may be freed
+ * once every active reader advertises an epoch at least that recent,
+ * since such readers started after the swap.
+ */
+
+#define EPOCH_CACHE_LINE 64
+
+/* what readers see: the instance to use, plus the one it replaced while a
+ * migration is in progress
+ */
+struct epoch_snapshot
+{
+    struct ch_placement_instance *current;
+    struct ch_placement_instance *previous;
+};
+
+struct epoch_retired
+{
+    struct epoch_snapshot *snapshot;
+    struct ch_placement_instance *instance; /* no longer referenced, or NULL */
+    uint64_t epoch;
+    struct epoch_retired *next;
+};
+
+/* one per reader, on its own cache line to avoid false sharing */
+struct epoch_reader
+{
+    uint64_t epoch;   /* 0 when not inside a read-side section */
+    int registered;
+    char pad[EPOCH_CACHE_LINE - sizeof(uint64_t) - sizeof(int)];
+};
+
+struct ch_placement_handle
+{
+    struct epoch_snapshot *snapshot;
+    uint64_t global_epoch;
+    unsigned int max_readers;
+    struct epoch_reader *readers;
+    pthread_mutex_t writer_lock;
+    struct epoch_retired *retired;
+};
+
+static void epoch_retire(struct ch_placement_handle *handle,
+    struct epoch_retired *retired, struct epoch_snapshot *snapshot,
+    struct ch_placement_instance *instance);
+static int epoch_reclaim(struct ch_placement_handle *handle);
+static int epoch_swap(struct ch_placement_handle *handle,
+    struct ch_placement_instance *current,
+    struct ch_placement_instance *previous,
+    struct ch_placement_instance *retire);
+
+struct ch_placement_handle* ch_placement_handle_create(
+    struct ch_placement_instance *instance,
+    unsigned int max_readers)
+{
+    struct ch_placement_handle *handle;
+    int ret;
+
+    handle = malloc(sizeof(*handle));
+    if(!handle)
+        return(NULL);
+    memset(handle, 0, sizeof(*handle));
+
+    ret = posix_memalign((void**)&handle->readers, EPOCH_CACHE_LINE,
+        max_readers*sizeof(*handle->readers));
+    if(ret != 0)
+    {
+        free(handle);
+        return(NULL);
+    }
+    memset(handle->readers, 0, max_readers*sizeof(*handle->readers));
+
+    handle->snapshot = malloc(sizeof(*handle->snapshot));
+    if(!handle->snapshot)
+    {
+        free(handle->readers);
+        free(handle);
+        return(NULL);
+    }
+    handle->snapshot->current = instance;
+    handle->snapshot->previous = NULL;
+
+    handle->max_readers = max_readers;
+    handle->global_epoch = 1;
+    pthread_mutex_init(&handle->writer_lock, NULL);
+
+    return(handle);
+}
+
+void ch_placement_handle_destroy(struct ch_placement_handle *handle)
+{
+    ch_placement_handle_synchronize(handle);
+
+    ch_placement_finalize(handle->snapshot->current);
+    if(handle->snapshot->previous)
+        ch_placement_finalize(handle->snapshot->previous);
+    free(handle->snapshot);
+    pthread_mutex_destroy(&handle->writer_lock);
+    free(handle->readers);
+    free(handle);
+
+    return;
+}
+
+int ch_placement_handle_register(struct ch_placement_handle *handle)
+{
+    unsigned int i;
+    int expected;
+
+    for(i=0; i<handle->max_readers; i++)
+    {
+        expected = 0;
+        if(__atomic_compare_exchange_n(&handle->readers[i].registered,
+            &expected, 1, 0, __ATOMIC_ACQ_REL, __ATOMIC_RELAXED))
+            return(i);
+    }
+
+    return(-1);
+}
+
+void ch_placement_handle_unregister(struct ch_placement_handle *handle,
+    int reader)
+{
+    assert(handle->readers[reader].epoch == 0);
+    __atomic_store_n(&handle->readers[reader].registered, 0, __ATOMIC_RELEASE);
+
+    return;
+}
+
+struct ch_placement_instance* ch_placement_handle_read_begin(
+    struct ch_placement_handle *handle, int reader)
+{
+    struct epoch_snapshot *snapshot;
+
+    __atomic_store_n(&handle->readers[reader].epoch,
+        __atomic_load_n(&handle->global_epoch, __ATOMIC_SEQ_CST),
+        __ATOMIC_SEQ_CST);
+    snapshot = __atomic_load_n(&handle->snapshot, __ATOMIC_SEQ_CST);
+
+    return(snapshot->current);
+}
+
+void ch_placement_handle_read_end(struct ch_placement_handle *handle,
+    int reader)
+{
+    __atomic_store_n(&handle->readers[reader].epoch, 0, __ATOMIC_RELEASE);
+
+    return;
+}
+
+void ch_placement_handle_find_closest(
+    struct ch_placement_handle *handle,
+    int reader,
+    uint64_t obj,
+    unsigned int replication,
+    unsigned long* server_idxs)
+{
+    struct ch_placement_instance *instance;
+
+    instance = ch_placement_handle_read_begin(handle, reader);
+    ch_placement_find_closest(instance, obj, replication, server_idxs);
+    ch_placement_handle_read_end(handle, reader);
+
+    return;
+}
+
+int ch_placement_handle_find_closest_dual(
+    struct ch_placement_handle *handle,
+    int reader,
+    uint64_t obj,
+    unsigned int replication,
+    unsigned long* old_server_idxs,
+    unsigned long* new_server_idxs)
+{
+    struct epoch_snapshot *snapshot;
+    int migrating = 0;
+
+    __atomic_store_n(&handle->readers[reader].epoch,
+        __atomic_load_n(&handle->global_epoch, __ATOMIC_SEQ_CST),
+        __ATOMIC_SEQ_CST);
+    snapshot = __atomic_load_n(&handle->snapshot, __ATOMIC_SEQ_CST);
+
+    /* both placements come from the same snapshot, so they are always a
+     * consistent old/new pair
+     */
+    ch_placement_find_closest(snapshot->current, obj, replication,
+        new_server_idxs);
+    if(snapshot->previous)
+    {
+        ch_placement_find_closest(snapshot->previous, obj, replication,
+            old_server_idxs);
+        migrating = 1;
+    }
+    else
+        memcpy(old_server_idxs, new_server_idxs,
+            replication*sizeof(*old_server_idxs));
+
+    ch_placement_handle_read_end(handle, reader);
+
+    return(migrating);
+}
+
+int ch_placement_handle_publish(struct ch_placement_handle *handle,
+    struct ch_placement_instance *instance)
+{
+    int ret;
+
+    pthread_mutex_lock(&handle->writer_lock);
+    /* the outgoing instance becomes the old epoch for dual lookups; an
+     * unfinished migration's old epoch is dropped
+     */
+    ret = epoch_swap(handle, instance, handle->snapshot->current,
+        handle->snapshot->previous);
+    pthread_mutex_unlock(&handle->writer_lock);
+
+    return(ret);
+}
+
+int ch_placement_handle_end_migration(struct ch_placement_handle *handle)
+{
+    int ret = 0;
+
+    pthread_mutex_lock(&handle->writer_lock);
+    if(handle->snapshot->previous)
+        ret = epoch_swap(handle, handle->snapshot->current, NULL,
+            handle->snapshot->previous);
+    pthread_mutex_unlock(&handle->writer_lock);
+
+    return(ret);
+}
+
+void ch_placement_handle_synchronize(struct ch_placement_handle *handle)
+{
+    pthread_mutex_lock(&handle->writer_lock);
+    while(epoch_reclaim(handle) > 0)
+        sched_yield();
+    pthread_mutex_unlock(&handle->writer_lock);
+
+    return;
+}
+
+/* installs a new snapshot and retires the old one; caller holds the
+ * writer lock.  Everything is allocated before the swap, so on failure
+ * the handle is left unchanged.
+ */
+static int epoch_swap(struct ch_placement_handle *handle,
+    struct ch_placement_instance *current,
+    struct ch_placement_instance *previous,
+    struct ch_placement_instance *retire)
+{
+    struct epoch_snapshot *snapshot;
+    struct epoch_snapshot *old_snapshot;
+    struct epoch_retired *retired;
+
+    snapshot = malloc(sizeof(*snapshot));
+    retired = malloc(sizeof(*retired));
+    if(!snapshot || !retired)
+    {
+        free(snapshot);
+        free(retired);
+        return(-1);
+    }
+    snapshot->current = current;
+    snapshot->previous = previous;
+
+    old_snapshot = __atomic_exchange_n(&handle->snapshot, snapshot,
+        __ATOMIC_SEQ_CST);
+    __atomic_add_fetch(&handle->global_epoch, 1, __ATOMIC_SEQ_CST);
+
+    epoch_retire(handle, retired, old_snapshot, retire);
+    epoch_reclaim(handle);
+
+    return(0);
+}
+
+static void epoch_retire(struct ch_placement_handle *handle,
+    struct epoch_retired *retired, struct epoch_snapshot *snapshot,
+    struct ch_placement_instance *instance)
+{
+    retired->snapshot = snapshot;
+    retired->instance = instance;
+    retired->epoch = __atomic_load_n(&handle->global_epoch, __ATOMIC_SEQ_CST);
+    retired->next = handle->retired;
+    handle->retired = retired;
+
+    return;
+}
+
+/* frees retired state that no reader can still see; returns the number of
+ * entries that must wait for a later grace period.  Caller holds the
+ * writer lock.
+ */
+static int epoch_reclaim(struct ch_placement_handle *handle)
+{
+    struct epoch_retired **link;
+    struct epoch_retired *retired;
+    uint64_t min_epoch = UINT64_MAX;
+    uint64_t epoch;
+    unsigned int i;
+    int pending = 0;
+
+    for(i=0; i<handle->max_readers; i++)
+    {
+        epoch = __atomic_load_n(&handle->readers[i].epoch, __ATOMIC_SEQ_CST);
+        if(epoch && epoch < min_epoch)
+            min_epoch = epoch;
+    }
+
+    link = &handle->retired;
+    while(*link)
+    {
+        retired = *link;
+        if(retired->epoch <= min_epoch)
+        {
+            *link = retired->next;
+            if(retired->instance)
+                ch_placement_finalize(retired->instance);
+            free(retired->snapshot);
+            free(retired);
+        }
+        else
+        {
+            link = &retired->next;
+            pending++;
+        }
+    }
+
+    return(pending);
+}
+
+/*
+ * Local variables:
+ *  c-indent-level: 4
+ *  c-basic-offset: 4
+ * End:
+ *
+ * vim: ft=c ts=8 sts=4 sw=4 expandtab
+ */
@@ -0,0 +1,224 @@
+/*
+ * Copyright (C) 2015 University of Chicago.
+ * See COPYRIGHT notice in top-level directory.
+ *
+ */
+
+#include "ch-placement-config.h"
+
+#include <stdlib.h>
+#include <string.h>
+#include <pthread.h>
+
+#include "ch-placement.h"
+#include "src/kernels.h"
+
+/* The kernel bodies are written once as plain loops over fixed width
+ * blocks and force-inlined into one wrapper per instruction set, so the
+ * compiler vectorizes each copy for its own target.  The results do not
+ * depend on the variant.
+ */
+
+#define KERNEL_INLINE static inline __attribute__((always_inline))
+
+#define ROT32(x, k) (((x) << (k)) | ((x) >> (32 - (k))))
+#define ROT64(x, k) (((x) << (k)) | ((x) >> (64 - (k))))
+
+/* the scanning modules' historical spooky seed/length constant */
+#define SPOOKY_SC_CONST 0xdeadbeefdeadbeefULL
+
+KERNEL_INLINE void xor_dist_body(uint64_t obj, const uint64_t * restrict ids,
+    unsigned long n, uint64_t * restrict dists)
+{
+    unsigned long b;
+    int k;
+
+    for(b=0; b<n; b+=PLACEMENT_KERNEL_WIDTH)
+        for(k=0; k<PLACEMENT_KERNEL_WIDTH; k++)
+            dists[b+k] = obj ^ ids[b+k];
+}
+
+/* hash_lookup3 distance: lookup3 hashlittle2() of the lower of the two
+ * values, with the higher one as the initial values.  Ordering the pair
+ * makes the distance commutative.
+ */
+KERNEL_INLINE void lookup3_dist_body(uint64_t obj, const uint64_t * restrict ids,
+    unsigned long n, uint64_t * restrict dists)
+{
+    unsigned long b;
+    int k;
+    uint64_t higher, lower;
+    uint32_t a, bb, c;
+
+    for(b=0; b<n; b+=PLACEMENT_KERNEL_WIDTH)
+    {
+        for(k=0; k<PLACEMENT_KERNEL_WIDTH; k++)
+        {
+            higher = obj > ids[b+k] ? obj : ids[b+k];
+            lower = obj > ids[b+k] ? ids[b+k] : obj;
+
+            a = bb = c = 0xdeadbeef + 8 + (uint32_t)higher;
+            c += (uint32_t)(higher >> 32);
+#if defined(__BYTE_ORDER__) && __BYTE_ORDER__ == __ORDER_BIG_ENDIAN__
+            a += __builtin_bswap32((uint32_t)(lower >> 32));
+            bb += __builtin_bswap32((uint32_t)lower);
+#else
+            a += (uint32_t)lower;
+            bb += (uint32_t)(lower >> 32);
+#endif
+
+            c ^= bb; c -= ROT32(bb, 14);
+            a ^= c;  a -= ROT32(c, 11);
+            bb ^= a; bb -= ROT32(a, 25);
+            c ^= bb; c -= ROT32(bb, 16);
+            a ^= c;  a -= ROT32(c, 4);
+            bb ^= a; bb -= ROT32(a, 14);
+            c ^= bb; c -= ROT32(bb, 24);
+
+            dists[b+k] = c + (((uint64_t)bb) << 32);
+        }
+    }
+}
+
+/* hash_spooky distance: spooky_hash64() of the lower of the two values,
+ * seeded with the higher one.  This is the SpookyV2 short hash unrolled
+ * for an 8 byte message.
+ */
+KERNEL_INLINE void spooky_dist_body(uint64_t obj, const uint64_t * restrict ids,
+    unsigned long n, uint64_t * restrict dists)
+{
+    unsigned long b;
+    int k;
+    uint64_t higher, lower;
+    uint64_t h0, h1, h2, h3;
+
+    for(b=0; b<n; b+=PLACEMENT_KERNEL_WIDTH)
+    {
+        for(k=0; k<PLACEMENT_KERNEL_WIDTH; k++)
+        {
+            higher = obj > ids[b+k] ? obj : ids[b+k];
+            lower = obj > ids[b+k] ? ids[b+k] : obj;
+
+            h0 = h1 = higher;
+            h2 = SPOOKY_SC_CONST + lower;
+            h3 = SPOOKY_SC_CONST + (((uint64_t)8) << 56);
+
+            h3 ^= h2;  h2 = ROT64(h2,15);  h3 += h2;
+            h0 ^= h3;  h3 = ROT64(h3,52);  h0 += h3;
+            h1 ^= h0;  h0 = ROT64(h0,26);  h1 += h0;
+            h2 ^= h1;  h1 = ROT64(h1,51);  h2 += h1;
+            h3 ^= h2;  h2 = ROT64(h2,28);  h3 += h2;
+            h0 ^= h3;  h3 = ROT64(h3,9);   h0 += h3;
+            h1 ^= h0;  h0 = ROT64(h0,47);  h1 += h0;
+            h2 ^= h1;  h1 = ROT64(h1,54);  h2 += h1;
+            h3 ^= h2;  h2 = ROT64(h2,32);  h3 += h2;
+            h0 ^= h3;  h3 = ROT64(h3,25);  h0 += h3;
+            h1 ^= h0;  h0 = ROT64(h0,63);
+
+            dists[b+k] = h0;
+        }
+    }
+}
+
+#define KERNEL_VARIANT(isa, attr) \
+attr static void xor_dist_##isa(uint64_t obj, const uint64_t *ids, \
+    unsigned long n, uint64_t *dists) \
+{ \
+    xor_dist_body(obj, ids, n, dists); \
+} \
+attr static void lookup3_dist_##isa(uint64_t obj, const uint64_t *ids, \
+    unsigned long n, uint64_t *dists) \
+{ \
+    lookup3_dist_body(obj, ids, n, dists); \
+} \
+attr static void spooky_dist_##isa(uint64_t obj, const uint64_t *ids, \
+    unsigned long n, uint64_t *dists) \
+{ \
+    spooky_dist_body(obj, ids, n, dists); \
+}
+
+KERNEL_VARIANT(scalar, )
+#ifdef CH_PLACEMENT_HAVE_X86_DISPATCH
+KERNEL_VARIANT(sse42, __attribute__((target("sse4.2"))))
+KERNEL_VARIANT(avx2, __attribute__((target("avx2"))))
+KERNEL_VARIANT(avx512, __attribute__((target("avx512f,avx512vl"))))
+#endif
+
+/* ordered from least to most capable */
+static const struct placement_kernels kernel_table[] =
+{
+    {"scalar", xor_dist_scalar, lookup3_dist_scalar, spooky_dist_scalar},
+#ifdef CH_PLACEMENT_HAVE_X86_DISPATCH
+    {"sse4.2", xor_dist_sse42, lookup3_dist_sse42, spooky_dist_sse42},
+    {"avx2", xor_dist_avx2, lookup3_dist_avx2, spooky_dist_avx2},
+    {"avx512", xor_dist_avx512, lookup3_dist_avx512, spooky_dist_avx512},
+#endif
+};
+
+#define N_KERNELS (sizeof(kernel_table)/sizeof(kernel_table[0]))
+
+static const struct placement_kernels *kernels_selected = NULL;
+static pthread_once_t kernels_once = PTHREAD_ONCE_INIT;
+
+/* non-zero if this CPU can run kernel_table[i] */
+static int kernels_supported(unsigned int i)
+{
+#ifdef CH_PLACEMENT_HAVE_X86_DISPATCH
+    __builtin_cpu_init();
+    if(strcmp(kernel_table[i].isa, "sse4.2") == 0)
+        return(__builtin_cpu_supports("sse4.2"));
+    if(strcmp(kernel_table[i].isa, "avx2") == 0)
+        return(__builtin_cpu_supports("avx2"));
+    if(strcmp(kernel_table[i].isa, "avx512") == 0)
+        return(__builtin_cpu_supports("avx512f") &&
+            __builtin_cpu_supports("avx512vl"));
+#endif
+    return(i == 0);
+}
+
+static void kernels_select(void)
+{
+    const char *forced = getenv("CH_PLACEMENT_ISA");
+    unsigned int i;
+
+    for(i=0; i<N_KERNELS; i++)
+    {
+        if(kernels_supported(i))
+            kernels_selected = &kernel_table[i];
+    }
+
+    if(forced && forced[0])
+    {
+        for(i=0; i<N_KERNELS; i++)
+        {
+            if(strcmp(forced, kernel_table[i].isa) == 0)
+                break;
+        }
+        /* unknown or unsupported levels keep the best available one */
+        if(i < N_KERNELS && kernels_supported(i))
+            kernels_selected = &kernel_table[i];
+    }
+
+    return;
+}
+
+const struct placement_kernels* placement_kernels_get(void)
+{
+    pthread_once(&kernels_once, kernels_select);
+
+    return(kernels_selected);
+}
+
+const char* ch_placement_isa(void)
+{
+    return(placement_kernels_get()->isa);
+}
+
+/*
+ * Local variables:
+ *  c-indent-level: 4
+ *  c-basic-offset: 4
+ * End:
+ *
+ * vim: ft=c ts=8 sts=4 sw=4 expandtab
+ */
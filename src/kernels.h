@@ -0,0 +1,47 @@
+/*
+ * Copyright (C) 2015 University of Chicago.
+ * See COPYRIGHT notice in top-level directory.
+ *
+ */
+
+#ifndef PLACEMENT_KERNELS_H
+#define PLACEMENT_KERNELS_H
+
+#include <stdint.h>
+
+/* Distance kernels used by the scanning modules.  Each computes
+ * dists[i] = distance(obj, ids[i]) for i in [0, n); n must be a multiple
+ * of PLACEMENT_KERNEL_WIDTH so that every variant can work in whole
+ * vectors.
+ */
+#define PLACEMENT_KERNEL_WIDTH 8
+
+typedef void (*placement_dist_fn)(uint64_t obj, const uint64_t *ids,
+    unsigned long n, uint64_t *dists);
+
+/* one set of kernels, all compiled for the same instruction set */
+struct placement_kernels
+{
+    const char *isa;
+    placement_dist_fn xor_dist;
+    placement_dist_fn lookup3_dist;
+    placement_dist_fn spooky_dist;
+};
+
+/* returns the kernels for the best instruction set supported by this CPU,
+ * or the level named by the CH_PLACEMENT_ISA environment variable
+ * (scalar, sse4.2, avx2 or avx512) if the CPU supports it.  Resolved once
+ * per process.
+ */
+const struct placement_kernels* placement_kernels_get(void);
+
+#endif /* PLACEMENT_KERNELS_H */
+
+/*
+ * Local variables:
+ *  c-indent-level: 4
+ *  c-basic-offset: 4
+ * End:
+ *
+ * vim: ft=c ts=8 sts=4 sw=4 expandtab
+ */
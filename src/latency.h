@@ -0,0 +1,140 @@
+/*
+ * Copyright (C) 2015 University of Chicago.
+ * See COPYRIGHT notice in top-level directory.
+ *
+ */
+
+#ifndef LATENCY_H
+#define LATENCY_H
+
+#include <stdint.h>
+#include <string.h>
+#include <time.h>
+
+/* Log-linear (HDR style) latency histogram.  Values below 2^LATENCY_SUB_BITS
+ * get a bucket each; above that every power of two is split into
+ * 2^LATENCY_SUB_BITS equal buckets, so a reported percentile is within
+ * 1/2^LATENCY_SUB_BITS of the true value whatever its magnitude.
+ */
+#define LATENCY_SUB_BITS 6
+#define LATENCY_SUB (1UL << LATENCY_SUB_BITS)
+#define LATENCY_BUCKETS ((64 - LATENCY_SUB_BITS + 1) * LATENCY_SUB)
+
+struct latency_hist
+{
+    uint64_t count;
+    uint64_t max;
+    uint64_t buckets[LATENCY_BUCKETS];
+};
+
+static inline void latency_hist_init(struct latency_hist *h){
+    memset(h, 0, sizeof(*h));
+}
+
+static inline unsigned long latency_bucket(uint64_t v){
+    unsigned int msb;
+
+    if (v < LATENCY_SUB)
+        return v;
+    msb = 63 - __builtin_clzll(v);
+    return (msb - LATENCY_SUB_BITS + 1) * LATENCY_SUB +
+        ((v >> (msb - LATENCY_SUB_BITS)) & (LATENCY_SUB - 1));
+}
+
+/* largest value that falls in bucket b */
+static inline uint64_t latency_bucket_top(unsigned long b){
+    unsigned int msb;
+    uint64_t low;
+
+    if (b < LATENCY_SUB)
+        return b;
+    msb = b / LATENCY_SUB + LATENCY_SUB_BITS - 1;
+    low = (1ULL << msb) | ((uint64_t)(b % LATENCY_SUB) << (msb - LATENCY_SUB_BITS));
+    return low + (1ULL << (msb - LATENCY_SUB_BITS)) - 1;
+}
+
+static inline void latency_hist_add(struct latency_hist *h, uint64_t v){
+    h->buckets[latency_bucket(v)]++;
+    h->count++;
+    if (v > h->max)
+        h->max = v;
+}
+
+/* adds the samples of src (e.g. one thread's histogram) to dst */
+static inline void latency_hist_merge(struct latency_hist *dst,
+        const struct latency_hist *src){
+    unsigned long i;
+
+    for (i = 0; i < LATENCY_BUCKETS; i++)
+        dst->buckets[i] += src->buckets[i];
+    dst->count += src->count;
+    if (src->max > dst->max)
+        dst->max = src->max;
+}
+
+/* value at or below which a fraction q of the samples lie */
+static inline uint64_t latency_hist_quantile(const struct latency_hist *h,
+        double q){
+    uint64_t rank, seen = 0;
+    unsigned long i;
+
+    if (h->count == 0)
+        return 0;
+    rank = (uint64_t)(q * h->count + 0.5);
+    if (rank < 1)
+        rank = 1;
+    for (i = 0; i < LATENCY_BUCKETS; i++){
+        seen += h->buckets[i];
+        if (seen >= rank)
+            return latency_bucket_top(i) < h->max ? latency_bucket_top(i) : h->max;
+    }
+    return h->max;
+}
+
+/* Timestamps.  On x86 the time stamp counter is read directly (a few ns),
+ * and converted to ns with a ratio measured against CLOCK_MONOTONIC;
+ * elsewhere clock_gettime() is used throughout.
+ */
+static inline uint64_t latency_clock_ns(void){
+    struct timespec ts;
+
+    clock_gettime(CLOCK_MONOTONIC, &ts);
+    return (uint64_t)ts.tv_sec * 1000000000ULL + ts.tv_nsec;
+}
+
+#if defined(__x86_64__) || defined(__i386__)
+#include <x86intrin.h>
+#define LATENCY_TIMER "tsc"
+static inline uint64_t latency_ticks(void){
+    return __rdtsc();
+}
+#else
+#define LATENCY_TIMER "clock_gettime"
+static inline uint64_t latency_ticks(void){
+    return latency_clock_ns();
+}
+#endif
+
+/* ns per tick of latency_ticks() */
+static inline double latency_calibrate(void){
+    uint64_t t0, t1, c0, c1;
+
+    c0 = latency_clock_ns();
+    t0 = latency_ticks();
+    do {
+        c1 = latency_clock_ns();
+    } while (c1 - c0 < 50000000ULL);
+    t1 = latency_ticks();
+    return (double)(c1 - c0) / (double)(t1 - t0);
+}
+
+#endif /* LATENCY_H */
+
+/*
+ * Local variables:
+ *  c-indent-level: 4
+ *  c-basic-offset: 4
+ * End:
+ *
+ * vim: ft=c ts=8 sts=4 sw=4 expandtab
+ */
@@ -16,7 +16,12 @@
 
 static void placement_find_closest_crush(struct placement_mod *mod, uint64_t obj, unsigned int replication, 
  unsigned long *server_idxs);
+static int placement_find_closest_filtered_crush(struct placement_mod *mod, uint64_t obj,
+    unsigned int replication, const struct placement_filter *filter,
+    unsigned long *server_idxs);
 static void placement_finalize_crush(struct placement_mod *mod);
+static void placement_get_stats_crush(struct placement_mod *mod,
+    struct ch_placement_stats *stats);
 
 struct crush_state
 {
@@ -47,8 +52,14 @@ struct placement_mod* placement_mod_crush(struct crush_map *map, __u32 *weight,
     mod_state->n_weight = n_weight;
 
     mod_crush->find_closest = placement_find_closest_crush;
-    mod_crush->create_striped = placement_create_striped_random;
+    mod_crush->find_closest_filtered = placement_find_closest_filtered_crush;
+    mod_crush->find_closest_batch = NULL;
+    mod_crush->create_striped = placement_create_striped_disjoint;
+    mod_crush->stripe_oid = NULL;
     mod_crush->finalize = placement_finalize_crush;
+    mod_crush->get_arcs = NULL;
+    mod_crush->get_stats = placement_get_stats_crush;
+    mod_crush->arena = NULL;
 
     return(mod_crush);
 }
@@ -72,6 +83,47 @@ static void placement_find_closest_crush(struct placement_mod *mod, uint64_t obj
     return;
 }
 
+static int placement_find_closest_filtered_crush(struct placement_mod *mod, uint64_t obj,
+    unsigned int replication, const struct placement_filter *filter,
+    unsigned long *server_idxs)
+{
+    struct crush_state *mod_state = mod->data;
+    int ret;
+    int result[CH_MAX_REPLICATION];
+    int scratch[CH_MAX_REPLICATION*3];
+    __u32 *weight;
+    int i;
+
+    /* failure domains are expressed in the crush map itself */
+    if(filter->domains)
+        return(0);
+
+    /* down servers are handled the way crush handles "out" devices: give
+     * them a weight of zero so that the rule retries elsewhere
+     */
+    weight = malloc(mod_state->n_weight*sizeof(*weight));
+    if(!weight)
+        return(0);
+    for(i=0; i<mod_state->n_weight; i++)
+    {
+        if(placement_filter_down(filter, i))
+            weight[i] = 0;
+        else
+            weight[i] = mod_state->weight[i];
+    }
+
+    ret = crush_do_rule(mod_state->map, 0, obj, result, replication,
+        weight, mod_state->n_weight, scratch);
+    free(weight);
+    if(ret < 0)
+        return(0);
+
+    for(i=0; i<ret; i++)
+        server_idxs[i] = result[i];
+
+    return(ret);
+}
+
 static void placement_finalize_crush(struct placement_mod *mod)
 {
     struct crush_state *mod_state = mod->data;
@@ -82,6 +134,18 @@ static void placement_finalize_crush(struct placement_mod *mod)
     return;
 }
 
+static void placement_get_stats_crush(struct placement_mod *mod,
+    struct ch_placement_stats *stats)
+{
+    struct crush_state *mod_state = mod->data;
+
+    /* the map and weights belong to the caller */
+    placement_stats_add(stats, "state", sizeof(*mod) + sizeof(*mod_state), 1);
+    stats->entries = mod_state->n_weight;
+
+    return;
+}
+
 
 /*
  * Local variables:
@@ -10,14 +10,18 @@
 
 #include "ch-placement.h"
 #include "src/modules/placement-mod.h"
+#include "src/modules/placement-scan.h"
 #include "src/lookup3.h"
 
 static struct placement_mod* placement_mod_hash_lookup3(int n_svrs, int virt_factor, int seed);
 static void placement_find_closest_hash_lookup3(struct placement_mod *mod, uint64_t obj, unsigned int replication, 
     unsigned long *server_idxs);
+static int placement_find_closest_filtered_hash_lookup3(struct placement_mod *mod, uint64_t obj,
+    unsigned int replication, const struct placement_filter *filter,
+    unsigned long *server_idxs);
 static void placement_finalize_hash_lookup3(struct placement_mod *mod);
-
-static uint64_t placement_distance_hash(uint64_t a, uint64_t b);
+static void placement_get_stats_hash_lookup3(struct placement_mod *mod,
+    struct ch_placement_stats *stats);
 
 struct placement_mod_map hash_lookup3_mod_map = 
 {
@@ -36,36 +40,36 @@ struct hash_lookup3_state
     unsigned int n_svrs;
     unsigned int virt_factor;
     struct vnode *virt_table;
+    uint64_t *ids;          /* svr_id of each vnode, for the scan kernel */
+    placement_dist_fn dist;
 };
 
 struct placement_mod* placement_mod_hash_lookup3(int n_svrs, int virt_factor, int seed)
 {
     struct placement_mod *mod_hash_lookup3;
     struct hash_lookup3_state *mod_state;
+    struct placement_arena *arena;
     uint32_t h1, h2;
     uint64_t i, j;
 
-    mod_hash_lookup3 = malloc(sizeof(*mod_hash_lookup3));
-    if(!mod_hash_lookup3)
+    arena = placement_arena_create(
+        placement_arena_span(sizeof(*mod_hash_lookup3)) +
+        placement_arena_span(sizeof(*mod_state)) +
+        placement_arena_span(sizeof(*mod_state->virt_table)*n_svrs*virt_factor) +
+        placement_arena_span(placement_scan_ids_size(n_svrs*virt_factor)));
+    if(!arena)
         return(NULL);
 
-    mod_state = malloc(sizeof(*mod_state));
-    if(!mod_state)
-    {
-        free(mod_hash_lookup3);
-        return(NULL);
-    }
-
+    /* the arena is sized for exactly these, so they cannot fail */
+    mod_hash_lookup3 = placement_arena_alloc(arena, sizeof(*mod_hash_lookup3));
+    mod_state = placement_arena_alloc(arena, sizeof(*mod_state));
+    mod_state->virt_table = placement_arena_alloc(arena,
+        sizeof(*mod_state->virt_table)*n_svrs*virt_factor);
+    mod_state->ids = placement_arena_alloc(arena,
+        placement_scan_ids_size(n_svrs*virt_factor));
+    mod_hash_lookup3->arena = arena;
     mod_hash_lookup3->data = mod_state;
 
-    mod_state->virt_table = malloc(sizeof(*mod_state->virt_table)*n_svrs*virt_factor);
-    if(!mod_state->virt_table)
-    {
-        free(mod_state);
-        free(mod_hash_lookup3);
-        return(NULL);
-    }
-
     mod_state->n_svrs = n_svrs;
     mod_state->virt_factor = virt_factor;
 
@@ -81,12 +85,19 @@ struct placement_mod* placement_mod_hash_lookup3(int n_svrs, int virt_factor, in
             ch_bj_hashlittle2(&i, sizeof(i), &h1, &h2);
             mod_state->virt_table[j*n_svrs+i].svr_idx = i;
             mod_state->virt_table[j*n_svrs+i].svr_id = h1 + (((uint64_t)h2)<<32);
+            mod_state->ids[j*n_svrs+i] = mod_state->virt_table[j*n_svrs+i].svr_id;
         }
     }
+    mod_state->dist = placement_kernels_get()->lookup3_dist;
 
     mod_hash_lookup3->find_closest = placement_find_closest_hash_lookup3;
-    mod_hash_lookup3->create_striped = placement_create_striped_random;
+    mod_hash_lookup3->find_closest_filtered = placement_find_closest_filtered_hash_lookup3;
+    mod_hash_lookup3->find_closest_batch = NULL;
+    mod_hash_lookup3->create_striped = placement_create_striped_disjoint;
+    mod_hash_lookup3->stripe_oid = NULL;
     mod_hash_lookup3->finalize = placement_finalize_hash_lookup3;
+    mod_hash_lookup3->get_arcs = NULL;
+    mod_hash_lookup3->get_stats = placement_get_stats_hash_lookup3;
 
     return(mod_hash_lookup3);
 }
@@ -95,25 +106,19 @@ static void placement_find_closest_hash_lookup3(struct placement_mod *mod, uint6
     unsigned long* server_idxs)
 {
     struct hash_lookup3_state *mod_state = mod->data;
-    struct vnode closest[CH_MAX_REPLICATION];
-    struct vnode svr, tmp_svr;
-    unsigned int i,j;
+    struct placement_scan_entry closest[CH_MAX_REPLICATION];
+    uint64_t dists[PLACEMENT_SCAN_BLOCK];
+    unsigned long n_vnodes = mod_state->n_svrs*mod_state->virt_factor;
+    unsigned long base, count, i;
+    unsigned int n = 0;
 
-    for(i=0; i<replication; i++)
-        closest[i].svr_idx = UINT64_MAX;
-
-    for(i=0; i<(mod_state->n_svrs*mod_state->virt_factor); i++)
+    for(base=0; base<n_vnodes; base+=PLACEMENT_SCAN_BLOCK)
     {
-        svr = mod_state->virt_table[i];
-        for(j=0; j<replication; j++)
-        {
-            if(closest[j].svr_idx == UINT64_MAX || placement_distance_hash(obj, svr.svr_id) < placement_distance_hash(obj, closest[j].svr_id))
-            {
-                tmp_svr = closest[j];
-                closest[j] = svr;
-                svr = tmp_svr;
-            }
-        }
+        count = placement_scan_dists(mod_state->dist, obj, mod_state->ids,
+            base, n_vnodes, dists);
+        for(i=0; i<count; i++)
+            placement_scan_insert(closest, &n, replication, dists[i],
+                mod_state->virt_table[base+i].svr_idx);
     }
 
     for(i=0; i<replication; i++)
@@ -124,45 +129,52 @@ static void placement_find_closest_hash_lookup3(struct placement_mod *mod, uint6
     return;
 }
 
-static uint64_t placement_distance_hash(uint64_t a, uint64_t b)
+static int placement_find_closest_filtered_hash_lookup3(struct placement_mod *mod, uint64_t obj,
+    unsigned int replication, const struct placement_filter *filter,
+    unsigned long *server_idxs)
 {
-    uint64_t higher;
-    uint64_t lower;
-    uint64_t dist;
-    uint32_t h1, h2;
+    struct hash_lookup3_state *mod_state = mod->data;
+    struct placement_scan_entry closest[CH_MAX_REPLICATION];
+    uint64_t dists[PLACEMENT_SCAN_BLOCK];
+    unsigned long n_vnodes = mod_state->n_svrs*mod_state->virt_factor;
+    unsigned long base, count, i;
+    unsigned int n = 0;
 
-    /* figure out wich number is higher */
-    /* we are just doing this to make the operation commutative, so
-     * dist(a,b) == dist(b,a)
-     */
-    if(a>b)
+    for(base=0; base<n_vnodes; base+=PLACEMENT_SCAN_BLOCK)
     {
-        higher = a;
-        lower = b;
-    }
-    else
-    {
-        higher = b;
-        lower = a;
+        count = placement_scan_dists(mod_state->dist, obj, mod_state->ids,
+            base, n_vnodes, dists);
+        for(i=0; i<count; i++)
+            placement_scan_offer(closest, &n, replication, filter, dists[i],
+                mod_state->virt_table[base+i].svr_idx);
     }
 
-    h1 = higher & 0xFFFFFFFF;
-    h2 = (higher >> 32) & 0xFFFFFFFF;
+    for(i=0; i<n; i++)
+        server_idxs[i] = closest[i].svr_idx;
 
-    ch_bj_hashlittle2(&lower, sizeof(lower), &h1, &h2);
+    return(n);
+}
 
-    dist  = h1 + (((uint64_t)h2)<<32);
+static void placement_finalize_hash_lookup3(struct placement_mod *mod)
+{
+    placement_arena_destroy(mod->arena);
 
-    return(dist);
+    return;
 }
 
-static void placement_finalize_hash_lookup3(struct placement_mod *mod)
+static void placement_get_stats_hash_lookup3(struct placement_mod *mod,
+    struct ch_placement_stats *stats)
 {
     struct hash_lookup3_state *mod_state = mod->data;
-
-    free(mod_state->virt_table);
-    free(mod_state);
-    free(mod);
+    unsigned long n_vnodes = (unsigned long)mod_state->n_svrs*mod_state->virt_factor;
+
+    placement_stats_add(stats, "state", placement_arena_span(sizeof(*mod)) +
+        placement_arena_span(sizeof(*mod_state)), 1);
+    placement_stats_add(stats, "vnodes",
+        placement_arena_span(sizeof(*mod_state->virt_table)*n_vnodes), n_vnodes);
+    placement_stats_add(stats, "ids",
+        placement_arena_span(placement_scan_ids_size(n_vnodes)), n_vnodes);
+    stats->entries = n_vnodes;
 
     return;
 }
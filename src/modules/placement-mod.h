@@ -9,33 +9,184 @@
 
 #include <stdint.h>
 
+#include "ch-placement.h"
+#include "src/arena.h"
+
+/* constraints applied by find_closest_filtered() while walking candidates */
+struct placement_filter
+{
+    /* failure domain of each server index, or NULL if replicas only need
+     * to land on distinct servers
+     */
+    const unsigned long *domains;
+    /* bitmap of servers that must be skipped (bit svr_idx%64 of word
+     * svr_idx/64), or NULL if every server is available
+     */
+    const uint64_t *down;
+    /* nonzero if replicas must land on distinct servers.  Only the scan
+     * modules consult it: their find_closest() may return a server more
+     * than once when virt_factor > 1, and skipping down servers alone must
+     * not change the placement of objects that avoid them.  Modules that
+     * always place on distinct servers ignore it.
+     */
+    int distinct;
+};
+
 struct placement_mod
 {
     void (*find_closest)(struct placement_mod *mod, uint64_t obj, unsigned int replication, 
         unsigned long* server_idxs);
-    void (*create_striped)(struct placement_mod *mod, unsigned long file_size, 
+    /* optional; like find_closest, but skips any candidate that conflicts
+     * with a replica already selected according to filter.  Returns the
+     * number of servers placed, which may be less than replication if the
+     * candidates are exhausted.
+     */
+    int (*find_closest_filtered)(struct placement_mod *mod, uint64_t obj,
+        unsigned int replication, const struct placement_filter *filter,
+        unsigned long* server_idxs);
+    /* optional; places n_objs objects, writing replication entries per
+     * object to server_idxs.  Same results as calling find_closest for
+     * each object, but free to overlap the table searches.
+     */
+    void (*find_closest_batch)(struct placement_mod *mod,
+        unsigned long n_objs, const uint64_t *objs, unsigned int replication,
+        unsigned long *server_idxs);
+    /* random choices are drawn from rng, which belongs to the caller */
+    void (*create_striped)(struct placement_mod *mod,
+      struct ch_placement_rng *rng,
+      unsigned long file_size, 
       unsigned int replication, unsigned int max_stripe_width, 
       unsigned int strip_size,
       unsigned int* num_objects,
       uint64_t *oids, unsigned long *sizes);
+    /* optional; returns the oid of stripe stripe_idx of file file_id as a
+     * pure function of its arguments and the module configuration.  If
+     * NULL, oids are chosen by placement_stripe_disjoint() from hashes of
+     * file_id, in groups of PLACEMENT_STRIPE_GROUP stripes.
+     */
+    uint64_t (*stripe_oid)(struct placement_mod *mod, uint64_t file_id,
+        unsigned long stripe_idx, unsigned int replication);
     void (*finalize)(struct placement_mod *mod);
+    /* optional; describes the arcs of oid space that share a placement.
+     * Oids are split across *n_rings independent rings by (oid % *n_rings).
+     * Returns the number of arc start points on the given ring and, if
+     * starts is not NULL, copies them there in ascending order.  An oid
+     * belongs to the arc with the greatest start that is <= the oid, or to
+     * the last arc if there is none.
+     */
+    unsigned long (*get_arcs)(struct placement_mod *mod, unsigned int ring,
+        unsigned int *n_rings, uint64_t *starts);
+    /* optional; describes the module's tables with placement_stats_add()
+     * and sets stats->entries
+     */
+    void (*get_stats)(struct placement_mod *mod,
+        struct ch_placement_stats *stats);
+    /* block holding the mod, its state and tables, or NULL if the module
+     * allocates them separately
+     */
+    struct placement_arena *arena;
     void *data;
 };
 
+/* number of table searches that find_closest_batch implementations
+ * advance together; enough independent cache misses in flight to cover
+ * DRAM latency without spilling the per-search state out of registers
+ */
+#define PLACEMENT_BATCH_GROUP 16
+
 struct placement_mod_map
 {
     char* type;
     struct placement_mod* (*initiate)(int n_svrs, int virt_factor, int seed);
 };
 
-/* generic striping function; just allocates random oids */
-void placement_create_striped_random(struct placement_mod *mod,
+/* splits file_size into at most max_stripe_width objects of strip_size
+ * sized strips, round robin, and fills in the size of each.  Returns the
+ * number of objects used.
+ */
+unsigned int placement_stripe_sizes(unsigned long file_size,
+  unsigned int max_stripe_width, unsigned int strip_size,
+  unsigned long *sizes);
+
+/* hashes a (file id, value) pair; used to derive stripe oids */
+static inline uint64_t placement_stripe_hash(uint64_t file_id, uint64_t value)
+{
+    uint64_t key[2];
+
+    key[0] = file_id;
+    key[1] = value;
+    return(ch_placement_hash_key(key, sizeof(key)));
+}
+
+/* chooses n_stripes oids whose replica sets overlap as little as
+ * possible.  Candidates are drawn from rng, or derived from file_id and
+ * the stripe index (first, first+1, ...) if rng is NULL.  Returns 0 on
+ * success, -1 on allocation failure.
+ */
+int placement_stripe_disjoint(struct placement_mod *mod,
+  struct ch_placement_rng *rng, uint64_t file_id, unsigned long first,
+  unsigned int replication, unsigned int n_stripes, uint64_t *oids);
+
+/* stripes of a file placed by file_id are chosen in independent groups of
+ * this many, so finding one stripe's oid replays at most this many
+ * placements
+ */
+#define PLACEMENT_STRIPE_GROUP 64
+
+/* generic striping function; places stripes with
+ * placement_stripe_disjoint()
+ */
+void placement_create_striped_disjoint(struct placement_mod *mod,
+  struct ch_placement_rng *rng,
   unsigned long file_size, 
   unsigned int replication, unsigned int max_stripe_width, 
   unsigned int strip_size,
   unsigned int* num_objects,
   uint64_t *oids, unsigned long *sizes);
 
+/* appends a table to a stats report */
+static inline void placement_stats_add(struct ch_placement_stats *stats,
+    const char *name, size_t bytes, unsigned long entries)
+{
+    if(stats->n_tables == CH_PLACEMENT_STATS_TABLES)
+        return;
+    stats->tables[stats->n_tables].name = name;
+    stats->tables[stats->n_tables].bytes = bytes;
+    stats->tables[stats->n_tables].entries = entries;
+    stats->n_tables++;
+}
+
+/* returns non-zero if svr_idx has been marked as down in filter */
+static inline int placement_filter_down(
+    const struct placement_filter *filter, unsigned long svr_idx)
+{
+    return(filter->down && ((filter->down[svr_idx/64] >> (svr_idx%64)) & 1));
+}
+
+/* returns non-zero if svr_idx may not be added to server_idxs[0..n):
+ * either it is down, or it shares a server or failure domain with a
+ * replica that has already been selected
+ */
+static inline int placement_filter_reject(
+    const struct placement_filter *filter, unsigned long svr_idx,
+    const unsigned long *server_idxs, unsigned int n)
+{
+    unsigned int i;
+
+    if(placement_filter_down(filter, svr_idx))
+        return(1);
+
+    for(i=0; i<n; i++)
+    {
+        if(server_idxs[i] == svr_idx)
+            return(1);
+        if(filter->domains &&
+            filter->domains[server_idxs[i]] == filter->domains[svr_idx])
+            return(1);
+    }
+
+    return(0);
+}
 
 #endif /* PLACEMENT_MOD_H */
 
@@ -15,15 +15,29 @@
 static struct placement_mod* placement_mod_multiring(int n_svrs, int virt_factor, int seed);
 static void placement_find_closest_multiring(struct placement_mod *mod, uint64_t obj, 
     unsigned int replication, unsigned long *server_idxs);
+static int placement_find_closest_filtered_multiring(struct placement_mod *mod, uint64_t obj,
+    unsigned int replication, const struct placement_filter *filter,
+    unsigned long *server_idxs);
+static void placement_find_closest_batch_multiring(struct placement_mod *mod,
+    unsigned long n_objs, const uint64_t *objs, unsigned int replication,
+    unsigned long *server_idxs);
 static void placement_finalize_multiring(struct placement_mod *mod);
+static void placement_get_stats_multiring(struct placement_mod *mod,
+    struct ch_placement_stats *stats);
+static unsigned long placement_get_arcs_multiring(struct placement_mod *mod,
+    unsigned int ring, unsigned int *n_rings, uint64_t *starts);
 static void placement_create_striped_multiring(
   struct placement_mod *mod,
+  struct ch_placement_rng *rng,
   unsigned long file_size, 
   unsigned int replication, unsigned int max_stripe_width, 
   unsigned int strip_size,
   unsigned int* num_objects,
   uint64_t *oids, unsigned long *sizes);
 
+static uint64_t placement_stripe_oid_multiring(struct placement_mod *mod,
+    uint64_t file_id, unsigned long stripe_idx, unsigned int replication);
+
 static int vnode_cmp(const void* a, const void *b);
 static int vnode_nearest_cmp(const void* key, const void *member);
 
@@ -50,45 +64,38 @@ struct multiring_state
     struct vnode **virt_table;
 };
 
+static uint64_t multiring_stripe_oid(struct multiring_state *mod_state,
+    unsigned int ring, unsigned int ring_idx, uint64_t r);
+
 struct placement_mod* placement_mod_multiring(int n_svrs, int virt_factor, int seed)
 {
     struct placement_mod *mod_multiring;
     struct multiring_state *mod_state;
+    struct placement_arena *arena;
     uint32_t h1, h2;
     uint64_t i, j;
 
-    mod_multiring = malloc(sizeof(*mod_multiring));
-    if(!mod_multiring)
+    arena = placement_arena_create(
+        placement_arena_span(sizeof(*mod_multiring)) +
+        placement_arena_span(sizeof(*mod_state)) +
+        placement_arena_span(sizeof(*mod_state->virt_table)*virt_factor) +
+        placement_arena_span(sizeof(*mod_state->virt_table[0])*n_svrs)*virt_factor);
+    if(!arena)
         return(NULL);
 
-    mod_state = malloc(sizeof(*mod_state));
-    if(!mod_state)
-    {
-        free(mod_multiring);
-        return(NULL);
-    }
-
+    /* the arena is sized for exactly these, so they cannot fail; the rings
+     * follow one another in a single block
+     */
+    mod_multiring = placement_arena_alloc(arena, sizeof(*mod_multiring));
+    mod_state = placement_arena_alloc(arena, sizeof(*mod_state));
+    mod_state->virt_table = placement_arena_alloc(arena,
+        sizeof(*mod_state->virt_table)*virt_factor);
+    for(i=0; i<(uint64_t)virt_factor; i++)
+        mod_state->virt_table[i] = placement_arena_alloc(arena,
+            sizeof(*mod_state->virt_table[0])*n_svrs);
+    mod_multiring->arena = arena;
     mod_multiring->data = mod_state;
 
-    mod_state->virt_table = malloc(sizeof(*mod_state->virt_table)*virt_factor);
-    if(!mod_state->virt_table)
-    {
-        free(mod_state);
-        free(mod_multiring);
-        return(NULL);
-    }
-    for(i=0; i<virt_factor; i++)
-    {
-        mod_state->virt_table[i] = malloc(sizeof(*mod_state->virt_table[0])*n_svrs);
-        if(!mod_state->virt_table[i])
-        {
-            free(mod_state->virt_table);
-            free(mod_state);
-            free(mod_multiring);
-            return(NULL);
-        }
-    }
-   
     mod_state->n_svrs = n_svrs;
     mod_state->virt_factor = virt_factor;
 
@@ -120,8 +127,13 @@ struct placement_mod* placement_mod_multiring(int n_svrs, int virt_factor, int s
     }
 
     mod_multiring->find_closest = placement_find_closest_multiring;
+    mod_multiring->find_closest_filtered = placement_find_closest_filtered_multiring;
+    mod_multiring->find_closest_batch = placement_find_closest_batch_multiring;
     mod_multiring->create_striped = placement_create_striped_multiring;
+    mod_multiring->stripe_oid = placement_stripe_oid_multiring;
     mod_multiring->finalize = placement_finalize_multiring;
+    mod_multiring->get_arcs = placement_get_arcs_multiring;
+    mod_multiring->get_stats = placement_get_stats_multiring;
 
     return(mod_multiring);
 }
@@ -181,6 +193,100 @@ static void placement_find_closest_multiring(struct placement_mod *mod, uint64_t
     return;
 }
 
+/* interleaved, prefetching binary searches like the ring module's batch
+ * lookup.  Every ring holds n_svrs vnodes, so the searches in a group
+ * share their length even though each oid may use a different ring.
+ */
+static void placement_find_closest_batch_multiring(struct placement_mod *mod,
+    unsigned long n_objs, const uint64_t *objs, unsigned int replication,
+    unsigned long *server_idxs)
+{
+    struct multiring_state *mod_state = mod->data;
+    const struct vnode *tables[PLACEMENT_BATCH_GROUP];
+    unsigned long base[PLACEMENT_BATCH_GROUP];
+    unsigned long n_svrs = mod_state->n_svrs;
+    unsigned long i, g, n_group, n, half, cur;
+    unsigned int r;
+
+    for(i=0; i<n_objs; i+=PLACEMENT_BATCH_GROUP)
+    {
+        n_group = n_objs - i;
+        if(n_group > PLACEMENT_BATCH_GROUP)
+            n_group = PLACEMENT_BATCH_GROUP;
+
+        for(g=0; g<n_group; g++)
+        {
+            tables[g] = mod_state->virt_table[objs[i+g] % mod_state->virt_factor];
+            base[g] = 0;
+            __builtin_prefetch(&tables[g][n_svrs/2]);
+        }
+
+        for(n=n_svrs; n>1; n-=half)
+        {
+            half = n/2;
+            for(g=0; g<n_group; g++)
+            {
+                base[g] += (tables[g][base[g]+half].svr_id <= objs[i+g]) ? half : 0;
+                __builtin_prefetch(&tables[g][base[g] + (n-half)/2]);
+            }
+        }
+
+        for(g=0; g<n_group; g++)
+        {
+            if(tables[g][base[g]].svr_id > objs[i+g])
+                base[g] = n_svrs-1;
+            /* no duplicates on a given ring */
+            cur = base[g];
+            for(r=0; r<replication; r++)
+            {
+                server_idxs[(i+g)*replication+r] = tables[g][cur].svr_idx;
+                if(++cur == n_svrs)
+                    cur = 0;
+            }
+        }
+    }
+
+    return;
+}
+
+static int placement_find_closest_filtered_multiring(struct placement_mod *mod, uint64_t obj,
+    unsigned int replication, const struct placement_filter *filter,
+    unsigned long *server_idxs)
+{
+    struct multiring_state *mod_state = mod->data;
+    int ring = obj % mod_state->virt_factor;
+    struct vnode* svr;
+    unsigned long current_index;
+    unsigned long steps;
+    unsigned int placed = 0;
+
+    svr = bsearch(&obj, mod_state->virt_table[ring],
+        mod_state->n_svrs,
+        sizeof(*mod_state->virt_table[0]), vnode_nearest_cmp);
+    if(!svr)
+        svr = &mod_state->virt_table[ring][mod_state->n_svrs-1];
+
+    /* walk clockwise around this object's ring; each server appears on it
+     * exactly once, so one revolution visits every candidate
+     */
+    current_index = svr->array_idx;
+    for(steps=0; steps<mod_state->n_svrs && placed<replication; steps++)
+    {
+        if(!placement_filter_reject(filter,
+            mod_state->virt_table[ring][current_index].svr_idx,
+            server_idxs, placed))
+        {
+            server_idxs[placed] = mod_state->virt_table[ring][current_index].svr_idx;
+            placed++;
+        }
+        current_index++;
+        if(current_index == mod_state->n_svrs)
+            current_index = 0;
+    }
+
+    return(placed);
+}
+
 static int vnode_nearest_cmp(const void* key, const void *member)
 {
     const uint64_t* obj = key;
@@ -203,22 +309,53 @@ static int vnode_nearest_cmp(const void* key, const void *member)
     return(0);
 }
 
-static void placement_finalize_multiring(struct placement_mod *mod)
+static unsigned long placement_get_arcs_multiring(struct placement_mod *mod,
+    unsigned int ring, unsigned int *n_rings, uint64_t *starts)
 {
     struct multiring_state *mod_state = mod->data;
-    int i;
+    unsigned long i;
+
+    /* one ring per virtual node; each server starts one arc on each */
+    *n_rings = mod_state->virt_factor;
+    assert(ring < mod_state->virt_factor);
+    if(starts)
+    {
+        for(i=0; i<mod_state->n_svrs; i++)
+            starts[i] = mod_state->virt_table[ring][i].svr_id;
+    }
+
+    return(mod_state->n_svrs);
+}
 
-    for(i=0; i<mod_state->virt_factor; i++)
-        free(mod_state->virt_table[i]);
-    free(mod_state->virt_table);
-    free(mod_state);
-    free(mod);
+static void placement_finalize_multiring(struct placement_mod *mod)
+{
+    placement_arena_destroy(mod->arena);
+
+    return;
+}
+
+static void placement_get_stats_multiring(struct placement_mod *mod,
+    struct ch_placement_stats *stats)
+{
+    struct multiring_state *mod_state = mod->data;
+    unsigned long n_vnodes = (unsigned long)mod_state->n_svrs*mod_state->virt_factor;
+
+    placement_stats_add(stats, "state", placement_arena_span(sizeof(*mod)) +
+        placement_arena_span(sizeof(*mod_state)), 1);
+    placement_stats_add(stats, "rings",
+        placement_arena_span(sizeof(*mod_state->virt_table)*mod_state->virt_factor),
+        mod_state->virt_factor);
+    placement_stats_add(stats, "vnodes",
+        placement_arena_span(sizeof(*mod_state->virt_table[0])*mod_state->n_svrs)*
+        mod_state->virt_factor, n_vnodes);
+    stats->entries = n_vnodes;
 
     return;
 }
 
 static void placement_create_striped_multiring(
   struct placement_mod *mod,
+  struct ch_placement_rng *rng,
   unsigned long file_size, 
   unsigned int replication, unsigned int max_stripe_width, 
   unsigned int strip_size,
@@ -226,80 +363,79 @@ static void placement_create_striped_multiring(
   uint64_t *oids, unsigned long *sizes)
 {
     struct multiring_state *mod_state = mod->data;
-    int ring = random() % mod_state->virt_factor;
-    int ring_idx = random() % mod_state->n_svrs;
+    int ring = ch_placement_rng_next(rng) % mod_state->virt_factor;
+    int ring_idx = ch_placement_rng_next(rng) % mod_state->n_svrs;
     unsigned int stripe_width;
     int i;
-    unsigned long size_left = file_size;
-    unsigned long full_stripes;
-    uint64_t range, oid_offset;
-    unsigned long check_size = 0;
-
-    /* how many objects to use */
-    stripe_width = file_size / strip_size + 1;
-    if(file_size % strip_size == 0)
-        stripe_width--;
-    if(stripe_width > max_stripe_width)
-        stripe_width = max_stripe_width;
-    *num_objects = stripe_width;
 
-    /* size of each object */
-    full_stripes = size_left/(stripe_width*strip_size);
-    size_left -= full_stripes * stripe_width * strip_size;
-    for(i=0; i<stripe_width; i++)
-    {
-        /* handle full stripes */
-        sizes[i] = full_stripes*strip_size;
-        /* handle remainder */
-        if(size_left > 0)
-        {
-            if(size_left > strip_size)
-            {
-                sizes[i] += strip_size;
-                size_left -= strip_size;
-            }
-            else
-            {
-                sizes[i] += size_left;
-                size_left = 0;
-            }
-        }
-        check_size += sizes[i];
-    }
-    assert(check_size == file_size);
-    assert(size_left == 0);
+    stripe_width = placement_stripe_sizes(file_size, max_stripe_width,
+        strip_size, sizes);
+    *num_objects = stripe_width;
 
     /* oid of each object */
     for(i=0; i<stripe_width; i++)
     {
-        /* figure out size of object interval for this server on this ring */
-        if(ring_idx < (mod_state->n_svrs-1))
-            range = mod_state->virt_table[ring][ring_idx+1].svr_id - mod_state->virt_table[ring][ring_idx].svr_id;
-        else
-            range = UINT64_MAX - mod_state->virt_table[ring][ring_idx].svr_id
-                + mod_state->virt_table[ring][0].svr_id;
-
-        /* divide by mod_state->virt_factor to account for the fact that objects are
-         * partitioned over each ring
-         */
-        range /= mod_state->virt_factor;
-        /* conservatively reduce range to account for math skew below */
-        range -= 3;
-
-        /* pick oid offset within range as random number within range */
-        oid_offset = ch_placement_random_u64() % range;
-        /* calculate true oid based on offset */
-        oids[i] = (mod_state->virt_table[ring][ring_idx].svr_id + (oid_offset+1)*mod_state->virt_factor);
-        /* round down to an oid that falls in this ring */
-        oids[i] -= oids[i]%mod_state->virt_factor;
-        oids[i] += ring;
-
+        oids[i] = multiring_stripe_oid(mod_state, ring, ring_idx,
+            ch_placement_rng_next(rng));
         ring_idx = (ring_idx + replication) % mod_state->n_svrs;
     }
 
     return;
 }
 
+/* same layout as placement_create_striped_multiring(), with the ring, the
+ * starting server and the offset within each arc derived from the file id
+ * instead of drawn at random
+ */
+static uint64_t placement_stripe_oid_multiring(struct placement_mod *mod,
+    uint64_t file_id, unsigned long stripe_idx, unsigned int replication)
+{
+    struct multiring_state *mod_state = mod->data;
+    uint64_t start = placement_stripe_hash(file_id, UINT64_MAX);
+    unsigned int ring = (start >> 32) % mod_state->virt_factor;
+    unsigned int ring_idx;
+
+    ring_idx = ((start & 0xFFFFFFFF) + (uint64_t)stripe_idx*replication) %
+        mod_state->n_svrs;
+
+    return(multiring_stripe_oid(mod_state, ring, ring_idx,
+        placement_stripe_hash(file_id, stripe_idx)));
+}
+
+/* picks an oid that maps to the given ring and falls in the arc owned by
+ * the virtual node at ring_idx, using r to choose the offset in the arc
+ */
+static uint64_t multiring_stripe_oid(struct multiring_state *mod_state,
+    unsigned int ring, unsigned int ring_idx, uint64_t r)
+{
+    uint64_t range, oid_offset;
+    uint64_t oid;
+
+    /* figure out size of object interval for this server on this ring */
+    if(ring_idx < (mod_state->n_svrs-1))
+        range = mod_state->virt_table[ring][ring_idx+1].svr_id - mod_state->virt_table[ring][ring_idx].svr_id;
+    else
+        range = UINT64_MAX - mod_state->virt_table[ring][ring_idx].svr_id
+            + mod_state->virt_table[ring][0].svr_id;
+
+    /* divide by mod_state->virt_factor to account for the fact that objects are
+     * partitioned over each ring
+     */
+    range /= mod_state->virt_factor;
+    /* conservatively reduce range to account for math skew below */
+    range -= 3;
+
+    /* pick oid offset within range as random number within range */
+    oid_offset = r % range;
+    /* calculate true oid based on offset */
+    oid = (mod_state->virt_table[ring][ring_idx].svr_id + (oid_offset+1)*mod_state->virt_factor);
+    /* round down to an oid that falls in this ring */
+    oid -= oid%mod_state->virt_factor;
+    oid += ring;
+
+    return(oid);
+}
+
 /*
  * Local variables:
  *  c-indent-level: 4
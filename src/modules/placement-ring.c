@@ -15,7 +15,17 @@
 static struct placement_mod* placement_mod_ring(int n_svrs, int virt_factor, int seed);
 static void placement_find_closest_ring(struct placement_mod *mod, uint64_t obj, 
     unsigned int replication, unsigned long *server_idxs);
+static int placement_find_closest_filtered_ring(struct placement_mod *mod, uint64_t obj,
+    unsigned int replication, const struct placement_filter *filter,
+    unsigned long *server_idxs);
+static void placement_find_closest_batch_ring(struct placement_mod *mod,
+    unsigned long n_objs, const uint64_t *objs, unsigned int replication,
+    unsigned long *server_idxs);
 static void placement_finalize_ring(struct placement_mod *mod);
+static void placement_get_stats_ring(struct placement_mod *mod,
+    struct ch_placement_stats *stats);
+static unsigned long placement_get_arcs_ring(struct placement_mod *mod,
+    unsigned int ring, unsigned int *n_rings, uint64_t *starts);
 
 static int vnode_cmp(const void* a, const void *b);
 static int vnode_nearest_cmp(const void* a, const void *b);
@@ -43,34 +53,31 @@ struct ring_state
     struct vnode *virt_table;
 };
 
+static void placement_walk_ring(struct ring_state *mod_state,
+    int current_index, unsigned int replication, unsigned long *server_idxs);
+
 struct placement_mod* placement_mod_ring(int n_svrs, int virt_factor, int seed)
 {
     struct placement_mod *mod_ring;
     struct ring_state *mod_state;
+    struct placement_arena *arena;
     uint32_t h1, h2;
     uint64_t i, j;
 
-    mod_ring = malloc(sizeof(*mod_ring));
-    if(!mod_ring)
+    arena = placement_arena_create(placement_arena_span(sizeof(*mod_ring)) +
+        placement_arena_span(sizeof(*mod_state)) +
+        placement_arena_span(sizeof(*mod_state->virt_table)*n_svrs*virt_factor));
+    if(!arena)
         return(NULL);
 
-    mod_state = malloc(sizeof(*mod_state));
-    if(!mod_state)
-    {
-        free(mod_ring);
-        return(NULL);
-    }
-
+    /* the arena is sized for exactly these, so they cannot fail */
+    mod_ring = placement_arena_alloc(arena, sizeof(*mod_ring));
+    mod_state = placement_arena_alloc(arena, sizeof(*mod_state));
+    mod_state->virt_table = placement_arena_alloc(arena,
+        sizeof(*mod_state->virt_table)*n_svrs*virt_factor);
+    mod_ring->arena = arena;
     mod_ring->data = mod_state;
 
-    mod_state->virt_table = malloc(sizeof(*mod_state->virt_table)*n_svrs*virt_factor);
-    if(!mod_state->virt_table)
-    {
-        free(mod_state);
-        free(mod_ring);
-        return(NULL);
-    }
-
     mod_state->n_svrs = n_svrs;
     mod_state->virt_factor = virt_factor;
 
@@ -98,8 +105,13 @@ struct placement_mod* placement_mod_ring(int n_svrs, int virt_factor, int seed)
     }
 
     mod_ring->find_closest = placement_find_closest_ring;
-    mod_ring->create_striped = placement_create_striped_random;
+    mod_ring->find_closest_filtered = placement_find_closest_filtered_ring;
+    mod_ring->find_closest_batch = placement_find_closest_batch_ring;
+    mod_ring->create_striped = placement_create_striped_disjoint;
+    mod_ring->stripe_oid = NULL;
     mod_ring->finalize = placement_finalize_ring;
+    mod_ring->get_arcs = placement_get_arcs_ring;
+    mod_ring->get_stats = placement_get_stats_ring;
 
     return(mod_ring);
 }
@@ -122,9 +134,6 @@ static void placement_find_closest_ring(struct placement_mod *mod, uint64_t obj,
 {
     struct ring_state *mod_state = mod->data;
     struct vnode* svr;
-    int current_index;
-    int dup;
-    int i,j;
 
     /* binary search through ring to find the server with the greatest virtual ID less than 
      * the oid 
@@ -138,8 +147,20 @@ static void placement_find_closest_ring(struct placement_mod *mod, uint64_t obj,
     if(!svr)
         svr = &mod_state->virt_table[(mod_state->n_svrs*mod_state->virt_factor)-1];
 
-    /* walk through ring, clockwise, to find N closest servers. */
-    current_index = svr->array_idx;
+    placement_walk_ring(mod_state, svr->array_idx, replication, server_idxs);
+
+    return;
+}
+
+/* walks the ring clockwise from vnode current_index to find the N closest
+ * distinct servers
+ */
+static void placement_walk_ring(struct ring_state *mod_state,
+    int current_index, unsigned int replication, unsigned long *server_idxs)
+{
+    int dup;
+    int i,j;
+
     for(i=0; i<replication; i++)
     {
         if(current_index == mod_state->n_svrs*mod_state->virt_factor)
@@ -168,6 +189,94 @@ static void placement_find_closest_ring(struct placement_mod *mod, uint64_t obj,
     return;
 }
 
+/* Runs PLACEMENT_BATCH_GROUP binary searches side by side, one level at a
+ * time.  Every search has the same length, so they share the loop over
+ * levels; after each step the search's next probe is prefetched, and by
+ * the time the group comes back around that line is (ideally) in cache.
+ * Unlike bsearch() the searches are branch free.
+ */
+static void placement_find_closest_batch_ring(struct placement_mod *mod,
+    unsigned long n_objs, const uint64_t *objs, unsigned int replication,
+    unsigned long *server_idxs)
+{
+    struct ring_state *mod_state = mod->data;
+    const struct vnode *table = mod_state->virt_table;
+    unsigned long n_vnodes = mod_state->n_svrs*mod_state->virt_factor;
+    unsigned long base[PLACEMENT_BATCH_GROUP];
+    unsigned long i, g, n_group, n, half;
+
+    for(i=0; i<n_objs; i+=PLACEMENT_BATCH_GROUP)
+    {
+        n_group = n_objs - i;
+        if(n_group > PLACEMENT_BATCH_GROUP)
+            n_group = PLACEMENT_BATCH_GROUP;
+
+        for(g=0; g<n_group; g++)
+            base[g] = 0;
+        __builtin_prefetch(&table[n_vnodes/2]);
+
+        /* narrow each search to the greatest vnode id <= its oid */
+        for(n=n_vnodes; n>1; n-=half)
+        {
+            half = n/2;
+            for(g=0; g<n_group; g++)
+            {
+                base[g] += (table[base[g]+half].svr_id <= objs[i+g]) ? half : 0;
+                __builtin_prefetch(&table[base[g] + (n-half)/2]);
+            }
+        }
+
+        for(g=0; g<n_group; g++)
+        {
+            /* oids below the first vnode belong to the last partition */
+            if(table[base[g]].svr_id > objs[i+g])
+                base[g] = n_vnodes-1;
+            placement_walk_ring(mod_state, base[g], replication,
+                &server_idxs[(i+g)*replication]);
+        }
+    }
+
+    return;
+}
+
+static int placement_find_closest_filtered_ring(struct placement_mod *mod, uint64_t obj,
+    unsigned int replication, const struct placement_filter *filter,
+    unsigned long *server_idxs)
+{
+    struct ring_state *mod_state = mod->data;
+    unsigned long n_vnodes = mod_state->n_svrs*mod_state->virt_factor;
+    struct vnode* svr;
+    unsigned long current_index;
+    unsigned long steps;
+    unsigned int placed = 0;
+
+    svr = bsearch(&obj, mod_state->virt_table, n_vnodes,
+        sizeof(*mod_state->virt_table), vnode_nearest_cmp);
+    if(!svr)
+        svr = &mod_state->virt_table[n_vnodes-1];
+
+    /* same clockwise walk as placement_find_closest_ring(), but the filter
+     * decides which servers must be skipped.  Give up after one full
+     * revolution.
+     */
+    current_index = svr->array_idx;
+    for(steps=0; steps<n_vnodes && placed<replication; steps++)
+    {
+        if(!placement_filter_reject(filter,
+            mod_state->virt_table[current_index].svr_idx,
+            server_idxs, placed))
+        {
+            server_idxs[placed] = mod_state->virt_table[current_index].svr_idx;
+            placed++;
+        }
+        current_index++;
+        if(current_index == n_vnodes)
+            current_index = 0;
+    }
+
+    return(placed);
+}
+
 static int vnode_nearest_cmp(const void* key, const void *member)
 {
     const uint64_t* obj = key;
@@ -189,13 +298,43 @@ static int vnode_nearest_cmp(const void* key, const void *member)
     return(0);
 }
 
+static unsigned long placement_get_arcs_ring(struct placement_mod *mod,
+    unsigned int ring, unsigned int *n_rings, uint64_t *starts)
+{
+    struct ring_state *mod_state = mod->data;
+    unsigned long n_vnodes = mod_state->n_svrs*mod_state->virt_factor;
+    unsigned long i;
+
+    /* there is only one ring; each vnode starts an arc */
+    *n_rings = 1;
+    assert(ring == 0);
+    if(starts)
+    {
+        for(i=0; i<n_vnodes; i++)
+            starts[i] = mod_state->virt_table[i].svr_id;
+    }
+
+    return(n_vnodes);
+}
+
 static void placement_finalize_ring(struct placement_mod *mod)
+{
+    placement_arena_destroy(mod->arena);
+
+    return;
+}
+
+static void placement_get_stats_ring(struct placement_mod *mod,
+    struct ch_placement_stats *stats)
 {
     struct ring_state *mod_state = mod->data;
+    unsigned long n_vnodes = (unsigned long)mod_state->n_svrs*mod_state->virt_factor;
 
-    free(mod_state->virt_table);
-    free(mod_state);
-    free(mod);
+    placement_stats_add(stats, "state", placement_arena_span(sizeof(*mod)) +
+        placement_arena_span(sizeof(*mod_state)), 1);
+    placement_stats_add(stats, "vnodes",
+        placement_arena_span(sizeof(*mod_state->virt_table)*n_vnodes), n_vnodes);
+    stats->entries = n_vnodes;
 
     return;
 }
@@ -0,0 +1,144 @@
+/*
+ * Copyright (C) 2015 University of Chicago.
+ * See COPYRIGHT notice in top-level directory.
+ *
+ */
+
+#ifndef PLACEMENT_SCAN_H
+#define PLACEMENT_SCAN_H
+
+#include <stdint.h>
+#include <stdlib.h>
+
+#include "src/modules/placement-mod.h"
+#include "src/kernels.h"
+
+/* helpers for modules that rank every virtual node by a distance metric
+ * (xor, hash_lookup3, hash_spooky, two_d) and keep the closest ones
+ */
+
+struct placement_scan_entry
+{
+    uint64_t dist;
+    unsigned long svr_idx;
+};
+
+/* inserts a candidate into closest[0..*n), which is kept sorted by
+ * ascending distance and never grows beyond replication entries.  Ties
+ * favor the candidate seen first.  Most candidates are rejected by a
+ * single comparison against the current worst entry, so a scan over N
+ * vnodes costs O(N) distance computations plus O(r) work for each of the
+ * (expected O(r log N)) candidates that are actually inserted.
+ */
+static inline void placement_scan_insert(struct placement_scan_entry *closest,
+    unsigned int *n, unsigned int replication, uint64_t dist,
+    unsigned long svr_idx)
+{
+    unsigned int i;
+
+    if(*n == replication && dist >= closest[*n-1].dist)
+        return;
+
+    if(*n < replication)
+        i = (*n)++;
+    else
+        i = replication-1;
+    while(i > 0 && closest[i-1].dist > dist)
+    {
+        closest[i] = closest[i-1];
+        i--;
+    }
+    closest[i].dist = dist;
+    closest[i].svr_idx = svr_idx;
+
+    return;
+}
+
+/* like placement_scan_insert(), but servers that are down are ignored.  If
+ * filter requires distinct servers or failure domains, a candidate that
+ * conflicts with an entry only replaces that entry if it is strictly
+ * closer; otherwise repeats are kept, exactly as placement_scan_insert()
+ * keeps them.
+ */
+static inline void placement_scan_offer(struct placement_scan_entry *closest,
+    unsigned int *n, unsigned int replication,
+    const struct placement_filter *filter, uint64_t dist,
+    unsigned long svr_idx)
+{
+    unsigned int i;
+    int conflict = -1;
+
+    /* quick rejection; not closer than anything we already hold */
+    if(*n == replication && dist >= closest[*n-1].dist)
+        return;
+
+    if(placement_filter_down(filter, svr_idx))
+        return;
+
+    for(i=0; (filter->distinct || filter->domains) && i<*n; i++)
+    {
+        if(closest[i].svr_idx == svr_idx ||
+            (filter->domains &&
+            filter->domains[closest[i].svr_idx] == filter->domains[svr_idx]))
+        {
+            conflict = i;
+            break;
+        }
+    }
+
+    if(conflict >= 0)
+    {
+        if(dist >= closest[conflict].dist)
+            return;
+        /* the candidate takes over this server or domain */
+        for(i=conflict; i+1<*n; i++)
+            closest[i] = closest[i+1];
+        (*n)--;
+    }
+
+    placement_scan_insert(closest, n, replication, dist, svr_idx);
+
+    return;
+}
+
+/* number of distances computed per kernel call */
+#define PLACEMENT_SCAN_BLOCK 256
+
+/* bytes of the id array for n_vnodes virtual nodes, padded to a whole
+ * number of kernel vectors; the padding must be zeroed
+ */
+static inline size_t placement_scan_ids_size(unsigned long n_vnodes)
+{
+    unsigned long padded = (n_vnodes + PLACEMENT_KERNEL_WIDTH - 1) /
+        PLACEMENT_KERNEL_WIDTH * PLACEMENT_KERNEL_WIDTH;
+
+    return(padded * sizeof(uint64_t));
+}
+
+/* computes the distances from obj to the block of ids starting at base;
+ * returns the number of valid entries in dists
+ */
+static inline unsigned long placement_scan_dists(placement_dist_fn dist,
+    uint64_t obj, const uint64_t *ids, unsigned long base,
+    unsigned long n_vnodes, uint64_t *dists)
+{
+    unsigned long count = n_vnodes - base;
+
+    if(count > PLACEMENT_SCAN_BLOCK)
+        count = PLACEMENT_SCAN_BLOCK;
+    dist(obj, &ids[base], (count + PLACEMENT_KERNEL_WIDTH - 1) /
+        PLACEMENT_KERNEL_WIDTH * PLACEMENT_KERNEL_WIDTH, dists);
+
+    return(count);
+}
+
+#endif /* PLACEMENT_SCAN_H */
+
+/*
+ * Local variables:
+ *  c-indent-level: 4
+ *  c-basic-offset: 4
+ * End:
+ *
+ * vim: ft=c ts=8 sts=4 sw=4 expandtab
+ */
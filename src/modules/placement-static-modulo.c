@@ -23,7 +23,12 @@
 static struct placement_mod* placement_mod_static_modulo(int n_svrs, int virt_factor, int seed);
 static void placement_find_closest_static_modulo(struct placement_mod *mod, uint64_t obj, unsigned int replication, 
     unsigned long *server_idxs);
+static int placement_find_closest_filtered_static_modulo(struct placement_mod *mod, uint64_t obj,
+    unsigned int replication, const struct placement_filter *filter,
+    unsigned long *server_idxs);
 static void placement_finalize_static_modulo(struct placement_mod *mod);
+static void placement_get_stats_static_modulo(struct placement_mod *mod,
+    struct ch_placement_stats *stats);
 
 struct placement_mod_map static_modulo_mod_map = 
 {
@@ -40,30 +45,34 @@ struct placement_mod* placement_mod_static_modulo(int n_svrs, int virt_factor, i
 {
     struct placement_mod *mod_static_modulo;
     struct static_modulo_state *mod_state;
+    struct placement_arena *arena;
 
     /* NOTE: this placement algorithm will not benefit from virtual nodes;
      * ignore that parameter
      */
     (void)virt_factor;
 
-    mod_static_modulo = malloc(sizeof(*mod_static_modulo));
-    if(!mod_static_modulo)
-        return(NULL);
-
-    mod_state = malloc(sizeof(*mod_state));
-    if(!mod_state)
-    {
-        free(mod_static_modulo);
+    arena = placement_arena_create(
+        placement_arena_span(sizeof(*mod_static_modulo)) +
+        placement_arena_span(sizeof(*mod_state)));
+    if(!arena)
         return(NULL);
-    }
 
+    mod_static_modulo = placement_arena_alloc(arena, sizeof(*mod_static_modulo));
+    mod_state = placement_arena_alloc(arena, sizeof(*mod_state));
+    mod_static_modulo->arena = arena;
     mod_static_modulo->data = mod_state;
 
     mod_state->n_svrs = n_svrs;
 
     mod_static_modulo->find_closest = placement_find_closest_static_modulo;
-    mod_static_modulo->create_striped = placement_create_striped_random;
+    mod_static_modulo->find_closest_filtered = placement_find_closest_filtered_static_modulo;
+    mod_static_modulo->find_closest_batch = NULL;
+    mod_static_modulo->create_striped = placement_create_striped_disjoint;
+    mod_static_modulo->stripe_oid = NULL;
     mod_static_modulo->finalize = placement_finalize_static_modulo;
+    mod_static_modulo->get_arcs = NULL;
+    mod_static_modulo->get_stats = placement_get_stats_static_modulo;
 
     return(mod_static_modulo);
 }
@@ -93,12 +102,52 @@ static void placement_find_closest_static_modulo(struct placement_mod *mod, uint
     return;
 }
 
+static int placement_find_closest_filtered_static_modulo(struct placement_mod *mod, uint64_t obj,
+    unsigned int replication, const struct placement_filter *filter,
+    unsigned long *server_idxs)
+{
+    struct static_modulo_state *mod_state = mod->data;
+    uint32_t h1 = 0;
+    uint32_t h2 = 0;
+    uint64_t hashed_obj;
+    unsigned long svr_idx;
+    unsigned int i;
+    unsigned int placed = 0;
+
+    ch_bj_hashlittle2(&obj, sizeof(obj), &h1, &h2);
+    hashed_obj  = h1 + (((uint64_t)h2)<<32);
+
+    /* step through consecutive slots, skipping rejected servers */
+    svr_idx = hashed_obj % mod_state->n_svrs;
+    for(i=0; i<mod_state->n_svrs && placed<replication; i++)
+    {
+        if(!placement_filter_reject(filter, svr_idx, server_idxs, placed))
+        {
+            server_idxs[placed] = svr_idx;
+            placed++;
+        }
+        svr_idx = (svr_idx + 1) % mod_state->n_svrs;
+    }
+
+    return(placed);
+}
+
 static void placement_finalize_static_modulo(struct placement_mod *mod)
+{
+    placement_arena_destroy(mod->arena);
+
+    return;
+}
+
+static void placement_get_stats_static_modulo(struct placement_mod *mod,
+    struct ch_placement_stats *stats)
 {
     struct static_modulo_state *mod_state = mod->data;
 
-    free(mod_state);
-    free(mod);
+    /* no table; a lookup is a single modulo */
+    placement_stats_add(stats, "state", placement_arena_span(sizeof(*mod)) +
+        placement_arena_span(sizeof(*mod_state)), 1);
+    stats->entries = 0;
 
     return;
 }
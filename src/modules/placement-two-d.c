@@ -10,12 +10,18 @@
 
 #include "ch-placement.h"
 #include "src/modules/placement-mod.h"
+#include "src/modules/placement-scan.h"
 #include "src/lookup3.h"
 
 static struct placement_mod* placement_mod_two_d(int n_svrs, int virt_factor, int seed);
 static void placement_find_closest_two_d(struct placement_mod *mod, uint64_t obj, unsigned int replication, 
     unsigned long *server_idxs);
+static int placement_find_closest_filtered_two_d(struct placement_mod *mod, uint64_t obj,
+    unsigned int replication, const struct placement_filter *filter,
+    unsigned long *server_idxs);
 static void placement_finalize_two_d(struct placement_mod *mod);
+static void placement_get_stats_two_d(struct placement_mod *mod,
+    struct ch_placement_stats *stats);
 
 static uint64_t placement_distance_two_d(uint64_t a, uint64_t b);
 
@@ -42,30 +48,24 @@ struct placement_mod* placement_mod_two_d(int n_svrs, int virt_factor, int seed)
 {
     struct placement_mod *mod_two_d;
     struct two_d_state *mod_state;
+    struct placement_arena *arena;
     uint32_t h1, h2;
     uint64_t i, j;
 
-    mod_two_d = malloc(sizeof(*mod_two_d));
-    if(!mod_two_d)
-        return(NULL);
-
-    mod_state = malloc(sizeof(*mod_state));
-    if(!mod_state)
-    {
-        free(mod_two_d);
+    arena = placement_arena_create(placement_arena_span(sizeof(*mod_two_d)) +
+        placement_arena_span(sizeof(*mod_state)) +
+        placement_arena_span(sizeof(*mod_state->virt_table)*n_svrs*virt_factor));
+    if(!arena)
         return(NULL);
-    }
 
+    /* the arena is sized for exactly these, so they cannot fail */
+    mod_two_d = placement_arena_alloc(arena, sizeof(*mod_two_d));
+    mod_state = placement_arena_alloc(arena, sizeof(*mod_state));
+    mod_state->virt_table = placement_arena_alloc(arena,
+        sizeof(*mod_state->virt_table)*n_svrs*virt_factor);
+    mod_two_d->arena = arena;
     mod_two_d->data = mod_state;
 
-    mod_state->virt_table = malloc(sizeof(*mod_state->virt_table)*n_svrs*virt_factor);
-    if(!mod_state->virt_table)
-    {
-        free(mod_state);
-        free(mod_two_d);
-        return(NULL);
-    }
-
     mod_state->n_svrs = n_svrs;
     mod_state->virt_factor = virt_factor;
 
@@ -85,8 +85,13 @@ struct placement_mod* placement_mod_two_d(int n_svrs, int virt_factor, int seed)
     }
 
     mod_two_d->find_closest = placement_find_closest_two_d;
-    mod_two_d->create_striped = placement_create_striped_random;
+    mod_two_d->find_closest_filtered = placement_find_closest_filtered_two_d;
+    mod_two_d->find_closest_batch = NULL;
+    mod_two_d->create_striped = placement_create_striped_disjoint;
+    mod_two_d->stripe_oid = NULL;
     mod_two_d->finalize = placement_finalize_two_d;
+    mod_two_d->get_arcs = NULL;
+    mod_two_d->get_stats = placement_get_stats_two_d;
 
     return(mod_two_d);
 }
@@ -96,25 +101,15 @@ static void placement_find_closest_two_d(struct placement_mod *mod, uint64_t obj
     unsigned long* server_idxs)
 {
     struct two_d_state *mod_state = mod->data;
-    struct vnode closest[CH_MAX_REPLICATION];
-    struct vnode svr, tmp_svr;
-    unsigned int i,j;
-
-    for(i=0; i<replication; i++)
-        closest[i].svr_idx = UINT64_MAX;
+    struct placement_scan_entry closest[CH_MAX_REPLICATION];
+    unsigned int n = 0;
+    unsigned int i;
 
     for(i=0; i<(mod_state->n_svrs*mod_state->virt_factor); i++)
     {
-        svr = mod_state->virt_table[i];
-        for(j=0; j<replication; j++)
-        {
-            if(closest[j].svr_idx == UINT64_MAX || placement_distance_two_d(obj, svr.svr_id) < placement_distance_two_d(obj, closest[j].svr_id))
-            {
-                tmp_svr = closest[j];
-                closest[j] = svr;
-                svr = tmp_svr;
-            }
-        }
+        placement_scan_insert(closest, &n, replication,
+            placement_distance_two_d(obj, mod_state->virt_table[i].svr_id),
+            mod_state->virt_table[i].svr_idx);
     }
 
     for(i=0; i<replication; i++)
@@ -125,13 +120,46 @@ static void placement_find_closest_two_d(struct placement_mod *mod, uint64_t obj
     return;
 }
 
+static int placement_find_closest_filtered_two_d(struct placement_mod *mod, uint64_t obj,
+    unsigned int replication, const struct placement_filter *filter,
+    unsigned long *server_idxs)
+{
+    struct two_d_state *mod_state = mod->data;
+    struct placement_scan_entry closest[CH_MAX_REPLICATION];
+    unsigned int n = 0;
+    unsigned int i;
+
+    for(i=0; i<(mod_state->n_svrs*mod_state->virt_factor); i++)
+    {
+        placement_scan_offer(closest, &n, replication, filter,
+            placement_distance_two_d(obj, mod_state->virt_table[i].svr_id),
+            mod_state->virt_table[i].svr_idx);
+    }
+
+    for(i=0; i<n; i++)
+        server_idxs[i] = closest[i].svr_idx;
+
+    return(n);
+}
+
 static void placement_finalize_two_d(struct placement_mod *mod)
+{
+    placement_arena_destroy(mod->arena);
+
+    return;
+}
+
+static void placement_get_stats_two_d(struct placement_mod *mod,
+    struct ch_placement_stats *stats)
 {
     struct two_d_state *mod_state = mod->data;
+    unsigned long n_vnodes = (unsigned long)mod_state->n_svrs*mod_state->virt_factor;
 
-    free(mod_state->virt_table);
-    free(mod_state);
-    free(mod);
+    placement_stats_add(stats, "state", placement_arena_span(sizeof(*mod)) +
+        placement_arena_span(sizeof(*mod_state)), 1);
+    placement_stats_add(stats, "vnodes",
+        placement_arena_span(sizeof(*mod_state->virt_table)*n_vnodes), n_vnodes);
+    stats->entries = n_vnodes;
 
     return;
 }
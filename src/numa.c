@@ -0,0 +1,264 @@
+/*
+ * Copyright (C) 2015 University of Chicago.
+ * See COPYRIGHT notice in top-level directory.
+ *
+ */
+
+#define _GNU_SOURCE
+
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <sched.h>
+#include <pthread.h>
+
+#include "ch-placement.h"
+#include "src/numa.h"
+
+/* NUMA topology comes from /sys/devices/system/node, so no extra library
+ * is needed.  Tables are placed on a node by building them from a thread
+ * pinned to that node's CPUs: Linux backs freshly allocated pages on the
+ * node of the CPU that first writes them.
+ */
+
+#define NUMA_SYSFS "/sys/devices/system/node"
+#define NUMA_MAX_NODES 64
+
+/* how many lookups a thread performs before checking which CPU it is on */
+#define NUMA_RECHECK 4096
+
+static int numa_n_nodes = 1;
+static int numa_n_cpus = 0;
+static int *numa_cpu_node = NULL;    /* node ordinal of each CPU */
+static pthread_once_t numa_once = PTHREAD_ONCE_INIT;
+
+static __thread int numa_local_node = -1;
+static __thread unsigned int numa_local_calls = 0;
+
+struct numa_build_arg
+{
+    struct placement_mod_map *map;
+    int n_svrs;
+    int virt_factor;
+    int seed;
+    int node;
+    struct placement_mod *mod;
+};
+
+/* parses a sysfs cpu list such as "0-3,8-11"; calls fn for each cpu */
+static void numa_parse_cpulist(const char *list, int node,
+    void (*fn)(int cpu, int node))
+{
+    const char *p = list;
+    char *end;
+    long first, last, cpu;
+
+    while(*p && *p != '\n')
+    {
+        first = strtol(p, &end, 10);
+        if(end == p)
+            return;
+        last = first;
+        p = end;
+        if(*p == '-')
+        {
+            last = strtol(p+1, &end, 10);
+            p = end;
+        }
+        for(cpu=first; cpu<=last; cpu++)
+            fn(cpu, node);
+        if(*p == ',')
+            p++;
+    }
+
+    return;
+}
+
+static void numa_count_cpu(int cpu, int node)
+{
+    if(cpu+1 > numa_n_cpus)
+        numa_n_cpus = cpu+1;
+    return;
+}
+
+static void numa_set_cpu(int cpu, int node)
+{
+    numa_cpu_node[cpu] = node;
+    return;
+}
+
+/* reads the cpu list of the ordinal'th populated node into buf */
+static int numa_node_cpulist(int ordinal, char *buf, int len)
+{
+    char path[256];
+    FILE *f;
+    int id, found = 0;
+
+    for(id=0; id<NUMA_MAX_NODES*4; id++)
+    {
+        snprintf(path, sizeof(path), NUMA_SYSFS "/node%d/cpulist", id);
+        f = fopen(path, "r");
+        if(!f)
+            continue;
+        if(!fgets(buf, len, f) || buf[0] == '\n')
+        {
+            /* memory-only node */
+            fclose(f);
+            continue;
+        }
+        fclose(f);
+        if(found == ordinal)
+            return(0);
+        found++;
+    }
+
+    return(-1);
+}
+
+static void numa_discover(void)
+{
+    char buf[4096];
+    int node;
+
+    for(node=0; node<NUMA_MAX_NODES; node++)
+    {
+        if(numa_node_cpulist(node, buf, sizeof(buf)) < 0)
+            break;
+        numa_parse_cpulist(buf, node, numa_count_cpu);
+    }
+    if(node < 2 || numa_n_cpus == 0)
+        return;
+
+    numa_cpu_node = calloc(numa_n_cpus, sizeof(*numa_cpu_node));
+    if(!numa_cpu_node)
+        return;
+    for(node=0; node<NUMA_MAX_NODES; node++)
+    {
+        if(numa_node_cpulist(node, buf, sizeof(buf)) < 0)
+            break;
+        numa_parse_cpulist(buf, node, numa_set_cpu);
+    }
+    numa_n_nodes = node;
+
+    return;
+}
+
+int placement_numa_nodes(void)
+{
+    pthread_once(&numa_once, numa_discover);
+
+    return(numa_n_nodes);
+}
+
+int placement_numa_current_node(void)
+{
+    int cpu;
+
+    if(numa_local_node < 0 || ++numa_local_calls >= NUMA_RECHECK)
+    {
+        numa_local_calls = 0;
+        numa_local_node = 0;
+        cpu = sched_getcpu();
+        if(numa_cpu_node && cpu >= 0 && cpu < numa_n_cpus)
+            numa_local_node = numa_cpu_node[cpu];
+    }
+
+    return(numa_local_node);
+}
+
+int placement_numa_bind(int node)
+{
+    cpu_set_t set;
+    int cpu;
+
+    if(placement_numa_nodes() < 2)
+        return(0);
+
+    CPU_ZERO(&set);
+    for(cpu=0; cpu<numa_n_cpus && cpu<CPU_SETSIZE; cpu++)
+    {
+        if(numa_cpu_node[cpu] == node)
+            CPU_SET(cpu, &set);
+    }
+    if(pthread_setaffinity_np(pthread_self(), sizeof(set), &set) != 0)
+        return(-1);
+    numa_local_node = -1;
+
+    return(0);
+}
+
+static void* numa_build_thread(void *arg)
+{
+    struct numa_build_arg *ba = arg;
+
+    /* if pinning fails the table is still usable, just not local */
+    placement_numa_bind(ba->node);
+
+    ba->mod = ba->map->initiate(ba->n_svrs, ba->virt_factor, ba->seed);
+
+    return(NULL);
+}
+
+struct placement_mod** placement_numa_build(struct placement_mod_map *map,
+    int n_svrs, int virt_factor, int seed, int *n_mods)
+{
+    struct numa_build_arg *args;
+    pthread_t thread;
+    struct placement_mod **mods;
+    int n_nodes = placement_numa_nodes();
+    int node;
+    int failed = 0;
+
+    args = calloc(n_nodes, sizeof(*args));
+    mods = calloc(n_nodes, sizeof(*mods));
+    if(!args || !mods)
+    {
+        free(args);
+        free(mods);
+        return(NULL);
+    }
+
+    for(node=0; node<n_nodes; node++)
+    {
+        args[node].map = map;
+        args[node].n_svrs = n_svrs;
+        args[node].virt_factor = virt_factor;
+        args[node].seed = seed;
+        args[node].node = node;
+        /* one node at a time; the builds are short and this keeps peak
+         * memory use at one table beyond what is already built
+         */
+        if(pthread_create(&thread, NULL, numa_build_thread, &args[node]) == 0)
+            pthread_join(thread, NULL);
+        else
+            numa_build_thread(&args[node]);
+        mods[node] = args[node].mod;
+        if(!mods[node])
+            failed = 1;
+    }
+
+    if(failed)
+    {
+        for(node=0; node<n_nodes; node++)
+        {
+            if(mods[node])
+                mods[node]->finalize(mods[node]);
+        }
+        free(mods);
+        mods = NULL;
+    }
+
+    free(args);
+    *n_mods = n_nodes;
+
+    return(mods);
+}
+
+/*
+ * Local variables:
+ *  c-indent-level: 4
+ *  c-basic-offset: 4
+ * End:
+ *
+ * vim: ft=c ts=8 sts=4 sw=4 expandtab
+ */
@@ -0,0 +1,41 @@
+/*
+ * Copyright (C) 2015 University of Chicago.
+ * See COPYRIGHT notice in top-level directory.
+ *
+ */
+
+#ifndef PLACEMENT_NUMA_H
+#define PLACEMENT_NUMA_H
+
+#include "src/modules/placement-mod.h"
+
+/* number of NUMA nodes with CPUs; 1 if the topology is unknown */
+int placement_numa_nodes(void);
+
+/* node ordinal of the CPU the calling thread runs on; cached per thread
+ * and refreshed periodically
+ */
+int placement_numa_current_node(void);
+
+/* pins the calling thread to the CPUs of node; does nothing on single
+ * node systems.  Returns 0 on success, -1 if the affinity could not be set.
+ */
+int placement_numa_bind(int node);
+
+/* builds one module instance per node, each from a thread pinned to that
+ * node so its tables are allocated there.  Returns an array of *n_mods
+ * modules, or NULL on failure.
+ */
+struct placement_mod** placement_numa_build(struct placement_mod_map *map,
+    int n_svrs, int virt_factor, int seed, int *n_mods);
+
+#endif /* PLACEMENT_NUMA_H */
+
+/*
+ * Local variables:
+ *  c-indent-level: 4
+ *  c-basic-offset: 4
+ * End:
+ *
+ * vim: ft=c ts=8 sts=4 sw=4 expandtab
+ */
@@ -9,6 +9,8 @@
 #include <assert.h>
 #include <stdio.h>
 #include <limits.h>
+#include <unistd.h>
+#include <pthread.h>
 
 #include "ch-placement-oid-gen.h"
 #include "ch-placement.h"
@@ -64,11 +66,205 @@ static void oid_gen_basic(
     uint64_t* total_byte_count,
     unsigned long* total_objs_count,
     struct obj** total_objs);
-static int obj_cmp(const void* a, const void *b);
+
+/* oid_sort() is an LSD radix sort of (oid, index) pairs, which are a
+ * quarter the size of struct obj, followed by one pass that moves each
+ * object to its place.  The pairs are sorted OID_SORT_DIGIT_BITS at a
+ * time by up to OID_SORT_MAX_THREADS threads, each of which histograms and
+ * then scatters its own slice; passes in which every oid has the same
+ * digit are skipped.  The threads then gather the objects into a copy of
+ * the array, or, if there is no memory for one, the caller permutes them
+ * in place.  The sort is stable.
+ */
+#define OID_SORT_DIGIT_BITS 11
+#define OID_SORT_BUCKETS (1 << OID_SORT_DIGIT_BITS)
+#define OID_SORT_MAX_THREADS 64
+/* fewer objects than this per thread are not worth a thread */
+#define OID_SORT_MIN_PER_THREAD (1UL << 16)
+
+struct oid_key
+{
+    uint64_t oid;
+    unsigned long idx;
+};
+
+struct oid_sort_shared
+{
+    struct oid_key *keys[2];    /* source and destination, swapped per pass */
+    int sorted;                 /* which of keys holds the result */
+    struct obj *objs;
+    struct obj *copy;           /* gathered objects, or NULL */
+    unsigned long n;
+    int n_threads;
+    pthread_barrier_t barrier;
+    unsigned long count[OID_SORT_MAX_THREADS][OID_SORT_BUCKETS];
+};
+
+struct oid_sort_thread
+{
+    struct oid_sort_shared *shared;
+    int id;
+};
+
+static void* oid_sort_worker(void *arg)
+{
+    struct oid_sort_thread *t = arg;
+    struct oid_sort_shared *sh = t->shared;
+    unsigned long first = sh->n*t->id/sh->n_threads;
+    unsigned long last = sh->n*(t->id+1)/sh->n_threads;
+    unsigned long offset[OID_SORT_BUCKETS];
+    unsigned long *count = sh->count[t->id];
+    unsigned long i, sum;
+    struct oid_key *src, *dst;
+    int shift, b, j, cur = 0;
+
+    for(shift=0; shift<64; shift+=OID_SORT_DIGIT_BITS)
+    {
+        src = sh->keys[cur];
+        dst = sh->keys[!cur];
+        memset(count, 0, OID_SORT_BUCKETS*sizeof(*count));
+        for(i=first; i<last; i++)
+            count[(src[i].oid >> shift) & (OID_SORT_BUCKETS-1)]++;
+        pthread_barrier_wait(&sh->barrier);
+
+        /* this thread's slice of bucket b follows all of bucket b-1 and
+         * the slices of lower threads in bucket b
+         */
+        sum = 0;
+        for(b=0; b<OID_SORT_BUCKETS; b++)
+        {
+            for(j=0; j<sh->n_threads; j++)
+            {
+                if(j == t->id)
+                    offset[b] = sum;
+                sum += sh->count[j][b];
+            }
+        }
+        for(b=0; b<OID_SORT_BUCKETS; b++)
+        {
+            for(sum=0, j=0; j<sh->n_threads; j++)
+                sum += sh->count[j][b];
+            if(sum == sh->n)
+                break;
+        }
+        if(b < OID_SORT_BUCKETS)
+        {
+            /* every oid has the same digit; nothing moves */
+            pthread_barrier_wait(&sh->barrier);
+            continue;
+        }
+
+        for(i=first; i<last; i++)
+            dst[offset[(src[i].oid >> shift) & (OID_SORT_BUCKETS-1)]++] = src[i];
+        pthread_barrier_wait(&sh->barrier);
+        cur = !cur;
+    }
+
+    if(t->id == 0)
+        sh->sorted = cur;
+    if(sh->copy)
+    {
+        src = sh->keys[cur];
+        for(i=first; i<last; i++)
+            sh->copy[i] = sh->objs[src[i].idx];
+        pthread_barrier_wait(&sh->barrier);
+        memcpy(&sh->objs[first], &sh->copy[first],
+            (last-first)*sizeof(*sh->objs));
+    }
+
+    return(NULL);
+}
+
+static int oid_sort_threads(unsigned long n)
+{
+    const char *env = getenv("CH_PLACEMENT_THREADS");
+    long max = 0;
+    long t;
+
+    if(env)
+        max = strtol(env, NULL, 10);
+    if(max < 1)
+        max = sysconf(_SC_NPROCESSORS_ONLN);
+    if(max > OID_SORT_MAX_THREADS)
+        max = OID_SORT_MAX_THREADS;
+    t = n / OID_SORT_MIN_PER_THREAD;
+    if(t > max)
+        t = max;
+    if(t < 1)
+        t = 1;
+
+    return(t);
+}
 
 void oid_sort(struct obj* objs, unsigned int objs_count)
 {
-    qsort(objs, objs_count, sizeof(*objs), obj_cmp);
+    struct oid_sort_shared *sh;
+    struct oid_sort_thread threads[OID_SORT_MAX_THREADS];
+    pthread_t tids[OID_SORT_MAX_THREADS];
+    struct oid_key *sorted;
+    struct obj tmp_obj;
+    unsigned long i, j, k;
+    int t, ret;
+
+    if(objs_count < 2)
+        return;
+
+    sh = malloc(sizeof(*sh));
+    assert(sh);
+    sh->n = objs_count;
+    sh->keys[0] = malloc(sh->n*sizeof(**sh->keys));
+    sh->keys[1] = malloc(sh->n*sizeof(**sh->keys));
+    assert(sh->keys[0] && sh->keys[1]);
+    for(i=0; i<sh->n; i++)
+    {
+        sh->keys[0][i].oid = objs[i].oid;
+        sh->keys[0][i].idx = i;
+    }
+
+    sh->objs = objs;
+    sh->copy = malloc(sh->n*sizeof(*sh->copy));
+    sh->n_threads = oid_sort_threads(sh->n);
+    pthread_barrier_init(&sh->barrier, NULL, sh->n_threads);
+    for(t=0; t<sh->n_threads; t++)
+    {
+        threads[t].shared = sh;
+        threads[t].id = t;
+    }
+    for(t=1; t<sh->n_threads; t++)
+    {
+        ret = pthread_create(&tids[t], NULL, oid_sort_worker, &threads[t]);
+        assert(ret == 0);
+    }
+    oid_sort_worker(&threads[0]);
+    for(t=1; t<sh->n_threads; t++)
+        pthread_join(tids[t], NULL);
+    pthread_barrier_destroy(&sh->barrier);
+    sorted = sh->keys[sh->sorted];
+    free(sh->keys[!sh->sorted]);
+
+    /* sorted[i].idx is where the object for position i is now; follow each
+     * cycle of the permutation, moving every object once
+     */
+    for(i=0; !sh->copy && i<sh->n; i++)
+    {
+        if(sorted[i].idx == i)
+            continue;
+        tmp_obj = objs[i];
+        j = i;
+        while(sorted[j].idx != i)
+        {
+            k = sorted[j].idx;
+            objs[j] = objs[k];
+            sorted[j].idx = j;
+            j = k;
+        }
+        objs[j] = tmp_obj;
+        sorted[j].idx = j;
+    }
+
+    free(sorted);
+    free(sh->copy);
+    free(sh);
 
     return;
 }
@@ -142,7 +338,7 @@ static void oid_gen_random(
     struct obj** total_objs)
 {
     uint64_t byte_count = 0;
-    unsigned int i;
+    unsigned long i, j;
     unsigned r;
 #if PRINT_PROGRESS
     unsigned long progress = 0;
@@ -162,7 +358,7 @@ static void oid_gen_random(
     assert(*total_objs);
     *total_objs_count = 0;
 
-    srand(random_seed);
+    ch_placement_random_seed(random_seed);
 
 #if PRINT_PROGRESS
     printf("# Progress: 0%%");
@@ -179,7 +375,7 @@ static void oid_gen_random(
         }
 #endif
         (*total_objs)[*total_objs_count].oid = ch_placement_random_u64();
-        r = random();
+        r = ch_placement_random_u64();
         (*total_objs)[*total_objs_count].size = r % (1024*1024*16);
         (*total_objs)[*total_objs_count].replication = replication;
         byte_count += (*total_objs)[*total_objs_count].size;
@@ -190,35 +386,183 @@ static void oid_gen_random(
     fflush(stdout);
 #endif
 
-    /* sort and filter out duplicate OIDs */
+    /* sort and filter out duplicate OIDs, keeping the last of each run */
     oid_sort(*total_objs, *total_objs_count);
 
-    for(i=0; i<((*total_objs_count)-1); i++)
+    for(i=0, j=0; i<*total_objs_count; i++)
     {
-        while((*total_objs)[i].oid == (*total_objs)[i+1].oid)
+        if(i+1 < *total_objs_count &&
+            (*total_objs)[i].oid == (*total_objs)[i+1].oid)
         {
             byte_count -= (*total_objs)[i].size;
-            memmove(&((*total_objs)[i]), &((*total_objs)[i+1]), ((*total_objs_count)-i-1)*sizeof(**total_objs));
-            (*total_objs_count)--;
+            continue;
         }
+        if(j != i)
+            (*total_objs)[j] = (*total_objs)[i];
+        j++;
     }
+    *total_objs_count = j;
 
     *total_byte_count = byte_count;
 
     return;
 }
 
-static int obj_cmp(const void* a, const void *b)
+/* Bloom filter for oid_stream: OID_STREAM_HASHES probes by double
+ * hashing.  It is sized for OID_STREAM_BITS_PER_OID bits per oid when the
+ * budget allows, where false positives are rare enough (~1e-7) that the
+ * stream reproduces oid_gen() exactly for any population that fits in
+ * memory.  It stops taking new oids once it holds one per
+ * OID_STREAM_MIN_BITS_PER_OID bits, so the false positive rate never
+ * exceeds ~1%.
+ */
+#define OID_STREAM_HASHES 7
+#define OID_STREAM_BITS_PER_OID 64
+#define OID_STREAM_MIN_BITS_PER_OID 10
+
+struct oid_stream
 {
-    const struct obj *o_a = a;
-    const struct obj *o_b = b;
+    struct ch_placement_rng rng;
+    unsigned long max_objs;
+    uint64_t max_bytes;
+    unsigned int replication;
+    unsigned long chunk_objs;
+    unsigned long obj_count;
+    uint64_t byte_count;
+    unsigned long suppressed;
+    uint64_t *filter;
+    uint64_t filter_mask;       /* bits in the filter - 1 */
+    unsigned long filter_capacity;
+    unsigned long filter_count;
+};
 
-    if(o_a->oid < o_b->oid)
-        return(-1);
-    else if(o_a->oid > o_b->oid)
-        return(1);
-    else
-        return(0);
+static uint64_t oid_stream_mix(uint64_t x)
+{
+    x ^= x >> 30;
+    x *= 0xbf58476d1ce4e5b9ULL;
+    x ^= x >> 27;
+    x *= 0x94d049bb133111ebULL;
+    x ^= x >> 31;
+    return(x);
+}
+
+/* returns 1 if oid may have been seen before, otherwise records it (while
+ * the filter has room) and returns 0
+ */
+static int oid_stream_seen(struct oid_stream *stream, uint64_t oid)
+{
+    uint64_t h1, h2, bit;
+    int i, seen = 1;
+
+    h1 = oid_stream_mix(oid);
+    h2 = oid_stream_mix(h1 ^ 0x9e3779b97f4a7c15ULL) | 1;
+    for(i=0; i<OID_STREAM_HASHES; i++)
+    {
+        bit = (h1 + i*h2) & stream->filter_mask;
+        if(!(stream->filter[bit/64] & (1ULL << (bit%64))))
+        {
+            seen = 0;
+            break;
+        }
+    }
+    if(seen || stream->filter_count >= stream->filter_capacity)
+        return(seen);
+
+    for(i=0; i<OID_STREAM_HASHES; i++)
+    {
+        bit = (h1 + i*h2) & stream->filter_mask;
+        stream->filter[bit/64] |= (1ULL << (bit%64));
+    }
+    stream->filter_count++;
+
+    return(0);
+}
+
+struct oid_stream* oid_stream_init(const char* gen_name,
+    unsigned long max_objs,
+    uint64_t max_bytes,
+    unsigned int random_seed,
+    unsigned int replication,
+    unsigned long chunk_objs,
+    size_t filter_bytes)
+{
+    struct oid_stream *stream;
+    uint64_t bits = 512;
+
+    if(strcmp(gen_name, "random") != 0 || chunk_objs == 0)
+        return(NULL);
+    if(filter_bytes == 0)
+        filter_bytes = OID_STREAM_DEFAULT_FILTER_BYTES;
+
+    stream = calloc(1, sizeof(*stream));
+    if(!stream)
+        return(NULL);
+    /* smallest power of two that holds every oid, within the budget */
+    while(bits < (uint64_t)max_objs*OID_STREAM_BITS_PER_OID &&
+        bits*2 <= (uint64_t)filter_bytes*8)
+        bits *= 2;
+    stream->filter = calloc(bits/64, sizeof(*stream->filter));
+    if(!stream->filter)
+    {
+        free(stream);
+        return(NULL);
+    }
+    stream->filter_mask = bits - 1;
+    stream->filter_capacity = bits / OID_STREAM_MIN_BITS_PER_OID;
+
+    /* the same sequence as ch_placement_random_seed() and oid_gen() */
+    ch_placement_rng_seed(&stream->rng, random_seed);
+    stream->max_objs = max_objs;
+    stream->max_bytes = max_bytes;
+    stream->replication = replication;
+    stream->chunk_objs = chunk_objs;
+
+    return(stream);
+}
+
+unsigned long oid_stream_next_batch(struct oid_stream *stream,
+    struct obj *objs)
+{
+    unsigned long n = 0;
+    uint64_t oid;
+    unsigned r;
+
+    while(n < stream->chunk_objs && stream->obj_count < stream->max_objs &&
+        stream->byte_count < stream->max_bytes)
+    {
+        oid = ch_placement_rng_next(&stream->rng);
+        r = ch_placement_rng_next(&stream->rng);
+        if(oid_stream_seen(stream, oid))
+        {
+            stream->suppressed++;
+            continue;
+        }
+        objs[n].oid = oid;
+        objs[n].size = r % (1024*1024*16);
+        objs[n].replication = stream->replication;
+        stream->byte_count += objs[n].size;
+        stream->obj_count++;
+        n++;
+    }
+
+    return(n);
+}
+
+void oid_stream_finalize(struct oid_stream *stream,
+    uint64_t* total_byte_count,
+    unsigned long* total_obj_count,
+    unsigned long* suppressed)
+{
+    if(total_byte_count)
+        *total_byte_count = stream->byte_count;
+    if(total_obj_count)
+        *total_obj_count = stream->obj_count;
+    if(suppressed)
+        *suppressed = stream->suppressed;
+    free(stream->filter);
+    free(stream);
+
+    return;
 }
 
 struct bin
@@ -253,8 +597,8 @@ static void oid_gen_hist_stripe(
     FILE* hist;
     char buffer[512];
     struct bin *bin_array;
-    int nbins = 0;
-    int i;
+    unsigned int nbins = 0;
+    unsigned int i;
     unsigned long total_count = 0;
     unsigned long running_count = 0;
     uint64_t r;
@@ -364,7 +708,7 @@ static void oid_gen_hist_stripe(
         assert(nbins < 50);
     }
     fclose(hist);
-    printf("# read in %d bins from %s\n", nbins, hist_file);
+    printf("# read in %u bins from %s\n", nbins, hist_file);
     for(i=0; i<nbins; i++)
     {
         printf("%lu\t%lu\t%lu\t%f\n", bin_array[i].min, bin_array[i].max, bin_array[i].count, bin_array[i].cumu_percentage);
@@ -487,8 +831,8 @@ static void oid_gen_hist_hadoop(
     FILE* hist;
     char buffer[512];
     struct bin *bin_array;
-    int nbins = 0;
-    int i;
+    unsigned int nbins = 0;
+    unsigned int i;
     unsigned long total_count = 0;
     unsigned long running_count = 0;
     uint64_t r;
@@ -577,7 +921,7 @@ static void oid_gen_hist_hadoop(
         assert(nbins < 50);
     }
     fclose(hist);
-    printf("# read in %d bins from %s\n", nbins, hist_file);
+    printf("# read in %u bins from %s\n", nbins, hist_file);
     for(i=0; i<nbins; i++)
     {
         printf("%lu\t%lu\t%lu\t%f\n", bin_array[i].min, bin_array[i].max, bin_array[i].count, bin_array[i].cumu_percentage);
@@ -0,0 +1,250 @@
+/*
+ * Copyright (C) 2015 University of Chicago.
+ * See COPYRIGHT notice in top-level directory.
+ *
+ */
+
+#ifndef PERFCTR_H
+#define PERFCTR_H
+
+#include <stdio.h>
+#include <stdint.h>
+#include <string.h>
+#include <errno.h>
+#include <unistd.h>
+
+#include "ch-placement-config.h"
+
+#ifdef CH_PLACEMENT_HAVE_PERF_EVENT
+#include <linux/perf_event.h>
+#include <sys/ioctl.h>
+#include <sys/syscall.h>
+#endif
+
+/* Hardware counters for the benchmark tools.  Each thread opens its own
+ * perf_event_open() group around the loop being measured, so the counts
+ * cover only that loop and only user space; the groups of all threads are
+ * added up afterwards.  Events the CPU or kernel cannot count are left
+ * out, and counts are scaled if the kernel had to multiplex the group.
+ */
+#define PERFCTR_EVENTS 5
+
+enum perfctr_event {
+    PERFCTR_CYCLES,
+    PERFCTR_INSTRUCTIONS,
+    PERFCTR_LLC_MISSES,
+    PERFCTR_DTLB_MISSES,
+    PERFCTR_BRANCH_MISSES
+};
+
+/* name of event e, as used for the JSON and CSV fields */
+static inline const char* perfctr_name(int e)
+{
+    static const char *names[PERFCTR_EVENTS] = {"cycles", "instructions",
+        "llc_misses", "dtlb_misses", "branch_misses"};
+
+    return(names[e]);
+}
+
+/* one thread's counter group */
+struct perfctr
+{
+    int leader;
+    int n;                      /* events in the group */
+    int fds[PERFCTR_EVENTS];
+    int events[PERFCTR_EVENTS]; /* event of each group member, in order */
+};
+
+/* counts summed over threads; bit e of valid is set if event e was
+ * counted by at least one thread.  error is the errno of a failed open.
+ */
+struct perfctr_counts
+{
+    uint64_t val[PERFCTR_EVENTS];
+    unsigned int valid;
+    int error;
+};
+
+#ifdef CH_PLACEMENT_HAVE_PERF_EVENT
+static inline void perfctr_attr(int event, struct perf_event_attr *attr)
+{
+    memset(attr, 0, sizeof(*attr));
+    attr->size = sizeof(*attr);
+    attr->exclude_kernel = 1;
+    attr->exclude_hv = 1;
+    attr->read_format = PERF_FORMAT_GROUP |
+        PERF_FORMAT_TOTAL_TIME_ENABLED | PERF_FORMAT_TOTAL_TIME_RUNNING;
+    switch(event)
+    {
+        case PERFCTR_CYCLES:
+            attr->type = PERF_TYPE_HARDWARE;
+            attr->config = PERF_COUNT_HW_CPU_CYCLES;
+            break;
+        case PERFCTR_INSTRUCTIONS:
+            attr->type = PERF_TYPE_HARDWARE;
+            attr->config = PERF_COUNT_HW_INSTRUCTIONS;
+            break;
+        case PERFCTR_LLC_MISSES:
+            attr->type = PERF_TYPE_HW_CACHE;
+            attr->config = PERF_COUNT_HW_CACHE_LL |
+                (PERF_COUNT_HW_CACHE_OP_READ << 8) |
+                (PERF_COUNT_HW_CACHE_RESULT_MISS << 16);
+            break;
+        case PERFCTR_DTLB_MISSES:
+            attr->type = PERF_TYPE_HW_CACHE;
+            attr->config = PERF_COUNT_HW_CACHE_DTLB |
+                (PERF_COUNT_HW_CACHE_OP_READ << 8) |
+                (PERF_COUNT_HW_CACHE_RESULT_MISS << 16);
+            break;
+        case PERFCTR_BRANCH_MISSES:
+            attr->type = PERF_TYPE_HARDWARE;
+            attr->config = PERF_COUNT_HW_BRANCH_MISSES;
+            break;
+    }
+}
+#endif
+
+/* opens a disabled group on the calling thread.  Returns 0 if at least one
+ * event can be counted, otherwise -1 with errno set.
+ */
+static inline int perfctr_open(struct perfctr *pc)
+{
+#ifdef CH_PLACEMENT_HAVE_PERF_EVENT
+    struct perf_event_attr attr;
+    int e, fd, err = 0;
+
+    pc->leader = -1;
+    pc->n = 0;
+    for(e = 0; e < PERFCTR_EVENTS; e++)
+    {
+        perfctr_attr(e, &attr);
+        attr.disabled = (pc->leader < 0);
+        fd = syscall(SYS_perf_event_open, &attr, 0, -1, pc->leader, 0);
+        if(fd < 0)
+        {
+            err = errno;
+            continue;
+        }
+        if(pc->leader < 0)
+            pc->leader = fd;
+        pc->fds[pc->n] = fd;
+        pc->events[pc->n] = e;
+        pc->n++;
+    }
+    if(pc->leader < 0)
+    {
+        errno = err;
+        return(-1);
+    }
+    return(0);
+#else
+    pc->leader = -1;
+    pc->n = 0;
+    errno = ENOSYS;
+    return(-1);
+#endif
+}
+
+static inline void perfctr_start(struct perfctr *pc)
+{
+#ifdef CH_PLACEMENT_HAVE_PERF_EVENT
+    ioctl(pc->leader, PERF_EVENT_IOC_RESET, PERF_IOC_FLAG_GROUP);
+    ioctl(pc->leader, PERF_EVENT_IOC_ENABLE, PERF_IOC_FLAG_GROUP);
+#else
+    (void)pc;
+#endif
+}
+
+/* stops the group and adds its counts to c */
+static inline void perfctr_stop(struct perfctr *pc, struct perfctr_counts *c)
+{
+#ifdef CH_PLACEMENT_HAVE_PERF_EVENT
+    uint64_t buf[3 + PERFCTR_EVENTS];
+    double scale;
+    int i;
+
+    ioctl(pc->leader, PERF_EVENT_IOC_DISABLE, PERF_IOC_FLAG_GROUP);
+    if(read(pc->leader, buf, sizeof(buf)) < (ssize_t)(3*sizeof(uint64_t)))
+        return;
+    /* never scheduled, e.g. all counters taken by another group */
+    if(buf[2] == 0)
+        return;
+    scale = (double)buf[1] / (double)buf[2];
+    for(i = 0; i < pc->n && i < (int)buf[0]; i++)
+    {
+        c->val[pc->events[i]] += (uint64_t)(buf[3+i] * scale);
+        c->valid |= 1U << pc->events[i];
+    }
+#else
+    (void)pc;
+    (void)c;
+#endif
+}
+
+static inline void perfctr_close(struct perfctr *pc)
+{
+    int i;
+
+    for(i = 0; i < pc->n; i++)
+        close(pc->fds[i]);
+    pc->n = 0;
+    pc->leader = -1;
+}
+
+/* adds the counts of src (e.g. one thread's) to dst */
+static inline void perfctr_merge(struct perfctr_counts *dst,
+        const struct perfctr_counts *src){
+    int e;
+
+    for(e = 0; e < PERFCTR_EVENTS; e++)
+        dst->val[e] += src->val[e];
+    dst->valid |= src->valid;
+    if(!dst->error)
+        dst->error = src->error;
+}
+
+/* count of event e per lookup, or a negative value if it was not counted */
+static inline double perfctr_per(const struct perfctr_counts *c, int e,
+        unsigned long lookups){
+    if(!(c->valid & (1U << e)) || lookups == 0)
+        return(-1);
+    return((double)c->val[e] / lookups);
+}
+
+/* prints the counts per lookup as tab separated columns, '-' for events
+ * that were not counted, followed by instructions per cycle
+ */
+static inline void perfctr_print(FILE *f, const struct perfctr_counts *c,
+        unsigned long lookups){
+    double v;
+    int e;
+
+    for(e = 0; e < PERFCTR_EVENTS; e++)
+    {
+        v = perfctr_per(c, e, lookups);
+        if(v < 0)
+            fprintf(f, "\t-");
+        else
+            fprintf(f, "\t%.2f", v);
+    }
+    if((c->valid & (1U << PERFCTR_CYCLES)) &&
+        (c->valid & (1U << PERFCTR_INSTRUCTIONS)) && c->val[PERFCTR_CYCLES])
+        fprintf(f, "\t%.2f", (double)c->val[PERFCTR_INSTRUCTIONS] /
+            c->val[PERFCTR_CYCLES]);
+    else
+        fprintf(f, "\t-");
+}
+
+/* column names matching perfctr_print() */
+#define PERFCTR_HEADER "\t<cycles>\t<instructions>\t<LLC misses>\t<dTLB misses>\t<branch misses>\t<IPC>"
+
+#endif /* PERFCTR_H */
+
+/*
+ * Local variables:
+ *  c-indent-level: 4
+ *  c-basic-offset: 4
+ * End:
+ *
+ * vim: ft=c ts=8 sts=4 sw=4 expandtab
+ */
@@ -0,0 +1,284 @@
+/*
+ * Copyright (C) 2015 University of Chicago.
+ * See COPYRIGHT notice in top-level directory.
+ *
+ */
+
+#include <stdlib.h>
+#include <string.h>
+#include <unistd.h>
+#include <pthread.h>
+
+#include "ch-placement.h"
+#include "src/numa.h"
+
+/* Worker pool behind ch_placement_find_closest_parallel().
+ *
+ * A batch is cut into chunks of POOL_CHUNK oids, and each participant (the
+ * workers plus the calling thread) starts with a contiguous run of them.
+ * Participants claim chunks from the front of a run with an atomic
+ * increment, so a participant that finishes its own run can keep claiming
+ * from the runs of others: the increment is the steal.  Workers are spread
+ * over the NUMA nodes and steal from participants on their own node before
+ * crossing to another one.
+ */
+
+/* oids per chunk; a multiple of the batch lookup group size */
+#define POOL_CHUNK 1024
+#define POOL_MAX_THREADS 256
+#define POOL_CACHE_LINE 64
+
+/* one participant's run of chunks, on its own cache line */
+struct pool_queue
+{
+    unsigned long next;   /* next chunk to claim */
+    unsigned long end;
+    int node;
+    char pad[POOL_CACHE_LINE - 2*sizeof(unsigned long) - sizeof(int)];
+};
+
+struct pool_job
+{
+    struct ch_placement_instance *instance;
+    unsigned long n_objs;
+    const uint64_t *objs;
+    unsigned int replication;
+    unsigned long *server_idxs;
+};
+
+struct placement_pool
+{
+    pthread_mutex_t busy;       /* held by the caller running a job */
+    pthread_mutex_t lock;
+    pthread_cond_t start;
+    pthread_cond_t done;
+    unsigned long generation;   /* bumped for every job */
+    int active;                 /* workers still on the current job */
+    int n_threads;              /* participants, including the caller */
+    struct pool_job job;
+    struct pool_queue *queues;
+};
+
+struct pool_worker_arg
+{
+    struct placement_pool *pool;
+    int id;
+};
+
+static struct placement_pool *global_pool = NULL;
+static pthread_once_t pool_once = PTHREAD_ONCE_INIT;
+
+static void pool_work(struct placement_pool *pool, int id);
+
+static void* pool_worker(void *arg)
+{
+    struct pool_worker_arg *wa = arg;
+    struct placement_pool *pool = wa->pool;
+    int id = wa->id;
+    unsigned long seen = 0;
+
+    free(wa);
+
+    placement_numa_bind(id % placement_numa_nodes());
+    __atomic_store_n(&pool->queues[id].node, placement_numa_current_node(),
+        __ATOMIC_RELAXED);
+
+    while(1)
+    {
+        pthread_mutex_lock(&pool->lock);
+        while(pool->generation == seen)
+            pthread_cond_wait(&pool->start, &pool->lock);
+        seen = pool->generation;
+        pthread_mutex_unlock(&pool->lock);
+
+        pool_work(pool, id);
+
+        pthread_mutex_lock(&pool->lock);
+        if(--pool->active == 0)
+            pthread_cond_signal(&pool->done);
+        pthread_mutex_unlock(&pool->lock);
+    }
+
+    return(NULL);
+}
+
+/* thread count from CH_PLACEMENT_THREADS, or one per online CPU */
+static int pool_thread_count(void)
+{
+    const char *env = getenv("CH_PLACEMENT_THREADS");
+    long n = 0;
+
+    if(env)
+        n = strtol(env, NULL, 10);
+    if(n < 1)
+        n = sysconf(_SC_NPROCESSORS_ONLN);
+    if(n < 1)
+        n = 1;
+    if(n > POOL_MAX_THREADS)
+        n = POOL_MAX_THREADS;
+
+    return(n);
+}
+
+static void pool_create(void)
+{
+    struct placement_pool *p;
+    struct pool_worker_arg *wa;
+    pthread_t thread;
+    int n_threads = pool_thread_count();
+    int i;
+
+    p = malloc(sizeof(*p));
+    if(!p)
+        return;
+    memset(p, 0, sizeof(*p));
+    if(posix_memalign((void**)&p->queues, POOL_CACHE_LINE,
+        n_threads*sizeof(*p->queues)) != 0)
+    {
+        free(p);
+        return;
+    }
+    memset(p->queues, 0, n_threads*sizeof(*p->queues));
+    pthread_mutex_init(&p->busy, NULL);
+    pthread_mutex_init(&p->lock, NULL);
+    pthread_cond_init(&p->start, NULL);
+    pthread_cond_init(&p->done, NULL);
+
+    /* participant 0 is whichever thread submits a job */
+    p->n_threads = 1;
+    for(i=1; i<n_threads; i++)
+    {
+        wa = malloc(sizeof(*wa));
+        if(!wa)
+            break;
+        wa->pool = p;
+        wa->id = i;
+        if(pthread_create(&thread, NULL, pool_worker, wa) != 0)
+        {
+            free(wa);
+            break;
+        }
+        pthread_detach(thread);
+        p->n_threads++;
+    }
+
+    global_pool = p;
+
+    return;
+}
+
+/* claims and places chunks from the run of participant victim until it
+ * is empty
+ */
+static void pool_drain(struct placement_pool *pool, int victim)
+{
+    struct pool_queue *q = &pool->queues[victim];
+    struct pool_job *job = &pool->job;
+    unsigned long chunk, first, n;
+
+    while((chunk = __atomic_fetch_add(&q->next, 1, __ATOMIC_RELAXED)) < q->end)
+    {
+        first = chunk*POOL_CHUNK;
+        n = job->n_objs - first;
+        if(n > POOL_CHUNK)
+            n = POOL_CHUNK;
+        ch_placement_find_closest_batch(job->instance, n, &job->objs[first],
+            job->replication, &job->server_idxs[first*job->replication]);
+    }
+
+    return;
+}
+
+static void pool_work(struct placement_pool *pool, int id)
+{
+    int node = __atomic_load_n(&pool->queues[id].node, __ATOMIC_RELAXED);
+    int i, victim;
+
+    pool_drain(pool, id);
+
+    /* steal, nearest first */
+    for(i=1; i<pool->n_threads; i++)
+    {
+        victim = (id + i) % pool->n_threads;
+        if(__atomic_load_n(&pool->queues[victim].node, __ATOMIC_RELAXED) == node)
+            pool_drain(pool, victim);
+    }
+    for(i=1; i<pool->n_threads; i++)
+    {
+        victim = (id + i) % pool->n_threads;
+        if(__atomic_load_n(&pool->queues[victim].node, __ATOMIC_RELAXED) != node)
+            pool_drain(pool, victim);
+    }
+
+    return;
+}
+
+void ch_placement_find_closest_parallel(
+    struct ch_placement_instance *instance,
+    unsigned long n_objs,
+    const uint64_t *objs,
+    unsigned int replication,
+    unsigned long* server_idxs)
+{
+    struct placement_pool *pool;
+    unsigned long n_chunks = (n_objs + POOL_CHUNK - 1) / POOL_CHUNK;
+    unsigned long per_thread, extra, next;
+    int i;
+
+    pthread_once(&pool_once, pool_create);
+    pool = global_pool;
+
+    /* too small to split, or another caller owns the pool */
+    if(!pool || pool->n_threads < 2 || n_chunks < 2 ||
+        pthread_mutex_trylock(&pool->busy) != 0)
+    {
+        ch_placement_find_closest_batch(instance, n_objs, objs, replication,
+            server_idxs);
+        return;
+    }
+
+    pool->job.instance = instance;
+    pool->job.n_objs = n_objs;
+    pool->job.objs = objs;
+    pool->job.replication = replication;
+    pool->job.server_idxs = server_idxs;
+
+    __atomic_store_n(&pool->queues[0].node, placement_numa_current_node(),
+        __ATOMIC_RELAXED);
+    per_thread = n_chunks / pool->n_threads;
+    extra = n_chunks % pool->n_threads;
+    next = 0;
+    for(i=0; i<pool->n_threads; i++)
+    {
+        pool->queues[i].next = next;
+        next += per_thread + ((unsigned long)i < extra ? 1 : 0);
+        pool->queues[i].end = next;
+    }
+
+    /* the mutex publishes the job and queues to the workers */
+    pthread_mutex_lock(&pool->lock);
+    pool->active = pool->n_threads - 1;
+    pool->generation++;
+    pthread_cond_broadcast(&pool->start);
+    pthread_mutex_unlock(&pool->lock);
+
+    pool_work(pool, 0);
+
+    pthread_mutex_lock(&pool->lock);
+    while(pool->active > 0)
+        pthread_cond_wait(&pool->done, &pool->lock);
+    pthread_mutex_unlock(&pool->lock);
+
+    pthread_mutex_unlock(&pool->busy);
+
+    return;
+}
+
+/*
+ * Local variables:
+ *  c-indent-level: 4
+ *  c-basic-offset: 4
+ * End:
+ *
+ * vim: ft=c ts=8 sts=4 sw=4 expandtab
+ */
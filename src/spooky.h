@@ -10,12 +10,67 @@
 
 #include <stdint.h>
 #include <stddef.h>
+#include <string.h>
 
 uint64_t spooky_hash64(
         const void *message, 
         size_t length, 
         uint64_t seed);
 
+#define SPOOKY_CONST 0xdeadbeefdeadbeefULL
+#define SPOOKY_ROT64(x, k) (((x) << (k)) | ((x) >> (64 - (k))))
+
+/* spooky_hash64() specialized for 16 byte messages (e.g. UUIDs); returns
+ * exactly the same value, without the length dispatch of the generic
+ * short hash
+ */
+static inline uint64_t spooky_hash64_16(
+        const void *message,
+        uint64_t seed)
+{
+    uint64_t a = seed, b = seed;
+    uint64_t c = SPOOKY_CONST, d = SPOOKY_CONST;
+    uint64_t in[2];
+
+    memcpy(in, message, sizeof(in));
+    c += in[0];
+    d += in[1];
+
+    /* ShortMix */
+    c = SPOOKY_ROT64(c,50);  c += d;  a ^= c;
+    d = SPOOKY_ROT64(d,52);  d += a;  b ^= d;
+    a = SPOOKY_ROT64(a,30);  a += b;  c ^= a;
+    b = SPOOKY_ROT64(b,41);  b += c;  d ^= b;
+    c = SPOOKY_ROT64(c,54);  c += d;  a ^= c;
+    d = SPOOKY_ROT64(d,48);  d += a;  b ^= d;
+    a = SPOOKY_ROT64(a,38);  a += b;  c ^= a;
+    b = SPOOKY_ROT64(b,37);  b += c;  d ^= b;
+    c = SPOOKY_ROT64(c,62);  c += d;  a ^= c;
+    d = SPOOKY_ROT64(d,34);  d += a;  b ^= d;
+    a = SPOOKY_ROT64(a,5);   a += b;  c ^= a;
+    b = SPOOKY_ROT64(b,36);  b += c;  d ^= b;
+
+    /* length, and no remaining bytes */
+    d += ((uint64_t)16) << 56;
+    c += SPOOKY_CONST;
+    d += SPOOKY_CONST;
+
+    /* ShortEnd */
+    d ^= c;  c = SPOOKY_ROT64(c,15);  d += c;
+    a ^= d;  d = SPOOKY_ROT64(d,52);  a += d;
+    b ^= a;  a = SPOOKY_ROT64(a,26);  b += a;
+    c ^= b;  b = SPOOKY_ROT64(b,51);  c += b;
+    d ^= c;  c = SPOOKY_ROT64(c,28);  d += c;
+    a ^= d;  d = SPOOKY_ROT64(d,9);   a += d;
+    b ^= a;  a = SPOOKY_ROT64(a,47);  b += a;
+    c ^= b;  b = SPOOKY_ROT64(b,54);  c += b;
+    d ^= c;  c = SPOOKY_ROT64(c,32);  d += c;
+    a ^= d;  d = SPOOKY_ROT64(d,25);  a += d;
+    b ^= a;  a = SPOOKY_ROT64(a,63);  b += a;
+
+    return(a);
+}
+
 #endif /* end of include guard: SPOOKY_H */
 
 /*
@@ -0,0 +1,160 @@
+/*
+ * Copyright (C) 2015 University of Chicago.
+ * See COPYRIGHT notice in top-level directory.
+ *
+ */
+
+#include <stdlib.h>
+#include <string.h>
+#include <limits.h>
+
+#include "ch-placement.h"
+#include "src/modules/placement-mod.h"
+
+/* Generic replica-disjoint striping.  Stripes are placed one at a time by
+ * rejection sampling: candidate oids are drawn and looked up with the
+ * module's find_closest until one lands entirely on servers the file does
+ * not use yet.  If none does within the attempt budget (e.g. the stripe
+ * width times the replication exceeds the number of servers), the
+ * candidate whose servers already hold the fewest of the file's objects
+ * is kept, which spreads the overlap evenly.
+ */
+
+#define STRIPE_ATTEMPTS 64
+
+#define STRIPE_EMPTY ULONG_MAX
+
+/* open addressing map from server index to the number of the file's
+ * objects placed on it so far
+ */
+struct stripe_counts
+{
+    unsigned long mask;
+    unsigned long *svr_idxs;
+    unsigned int *counts;
+};
+
+static unsigned int* stripe_count_slot(struct stripe_counts *sc,
+    unsigned long svr_idx)
+{
+    unsigned long i = (svr_idx * 0x9E3779B97F4A7C15ULL) >> 7;
+
+    for(i &= sc->mask; sc->svr_idxs[i] != STRIPE_EMPTY; i = (i+1) & sc->mask)
+    {
+        if(sc->svr_idxs[i] == svr_idx)
+            return(&sc->counts[i]);
+    }
+    sc->svr_idxs[i] = svr_idx;
+    sc->counts[i] = 0;
+
+    return(&sc->counts[i]);
+}
+
+static unsigned long stripe_count_get(const struct stripe_counts *sc,
+    unsigned long svr_idx)
+{
+    unsigned long i = (svr_idx * 0x9E3779B97F4A7C15ULL) >> 7;
+
+    for(i &= sc->mask; sc->svr_idxs[i] != STRIPE_EMPTY; i = (i+1) & sc->mask)
+    {
+        if(sc->svr_idxs[i] == svr_idx)
+            return(sc->counts[i]);
+    }
+
+    return(0);
+}
+
+int placement_stripe_disjoint(struct placement_mod *mod,
+    struct ch_placement_rng *rng, uint64_t file_id, unsigned long first,
+    unsigned int replication, unsigned int n_stripes, uint64_t *oids)
+{
+    struct stripe_counts sc;
+    unsigned long server_idxs[CH_MAX_REPLICATION];
+    unsigned long best_score, score;
+    unsigned long size = 16;
+    uint64_t candidate;
+    unsigned int i, a, j;
+
+    /* at most n_stripes*replication distinct servers; keep the load
+     * factor at or below one half
+     */
+    while(size < 2*(unsigned long)n_stripes*replication)
+        size *= 2;
+    sc.mask = size-1;
+    sc.svr_idxs = malloc(size*sizeof(*sc.svr_idxs));
+    sc.counts = malloc(size*sizeof(*sc.counts));
+    if(!sc.svr_idxs || !sc.counts)
+    {
+        free(sc.svr_idxs);
+        free(sc.counts);
+        return(-1);
+    }
+    memset(sc.svr_idxs, 0xFF, size*sizeof(*sc.svr_idxs));
+
+    for(i=0; i<n_stripes; i++)
+    {
+        best_score = ULONG_MAX;
+        for(a=0; a<STRIPE_ATTEMPTS && best_score > 0; a++)
+        {
+            if(rng)
+                candidate = ch_placement_rng_next(rng);
+            else
+                candidate = placement_stripe_hash(file_id,
+                    ((uint64_t)a << 32) | (first+i));
+
+            mod->find_closest(mod, candidate, replication, server_idxs);
+            score = 0;
+            for(j=0; j<replication; j++)
+                score += stripe_count_get(&sc, server_idxs[j]);
+            if(score < best_score)
+            {
+                best_score = score;
+                oids[i] = candidate;
+            }
+        }
+
+        mod->find_closest(mod, oids[i], replication, server_idxs);
+        for(j=0; j<replication; j++)
+            (*stripe_count_slot(&sc, server_idxs[j]))++;
+    }
+
+    free(sc.svr_idxs);
+    free(sc.counts);
+
+    return(0);
+}
+
+void placement_create_striped_disjoint(struct placement_mod *mod,
+    struct ch_placement_rng *rng,
+    unsigned long file_size,
+    unsigned int replication, unsigned int max_stripe_width,
+    unsigned int strip_size,
+    unsigned int* num_objects,
+    uint64_t *oids, unsigned long *sizes)
+{
+    unsigned int i;
+    int ret;
+
+    *num_objects = placement_stripe_sizes(file_size, max_stripe_width,
+        strip_size, sizes);
+
+    ret = placement_stripe_disjoint(mod, rng, 0, 0, replication,
+        *num_objects, oids);
+    if(ret < 0)
+    {
+        /* no memory to track servers; fall back to independent oids */
+        for(i=0; i<*num_objects; i++)
+            oids[i] = ch_placement_rng_next(rng);
+    }
+
+    return;
+}
+
+/*
+ * Local variables:
+ *  c-indent-level: 4
+ *  c-basic-offset: 4
+ * End:
+ *
+ * vim: ft=c ts=8 sts=4 sw=4 expandtab
+ */
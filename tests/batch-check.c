@@ -0,0 +1,103 @@
+/*
+ * Copyright (C) 2015 University of Chicago.
+ * See COPYRIGHT notice in top-level directory.
+ *
+ */
+
+#include <stdio.h>
+#include <string.h>
+#include <stdint.h>
+#include <stdlib.h>
+
+#include "ch-placement.h"
+
+/* Batch lookups must match one-at-a-time lookups, including for partial
+ * groups, oids at the ends of the oid space, and with servers down.
+ */
+
+#define N_OBJS 10007
+#define REPLICATION 3
+
+static const char *modules[] = {"ring", "multiring", "xor", "static_modulo",
+    NULL};
+
+static int check(struct ch_placement_instance *instance, const uint64_t *oids,
+    unsigned long n_objs, unsigned long *batch_idxs)
+{
+    unsigned long idxs[REPLICATION];
+    unsigned long i;
+
+    ch_placement_find_closest_batch(instance, n_objs, oids, REPLICATION,
+        batch_idxs);
+    for(i=0; i<n_objs; i++)
+    {
+        ch_placement_find_closest(instance, oids[i], REPLICATION, idxs);
+        if(memcmp(idxs, &batch_idxs[i*REPLICATION], sizeof(idxs)) != 0)
+            return(-1);
+    }
+
+    return(0);
+}
+
+int main(void)
+{
+    struct ch_placement_instance *instance;
+    struct ch_placement_rng rng;
+    uint64_t *oids;
+    unsigned long *batch_idxs;
+    uint64_t down[CH_PLACEMENT_DOWN_WORDS(50)] = {0};
+    int m;
+    unsigned long i;
+
+    oids = malloc(N_OBJS*sizeof(*oids));
+    batch_idxs = malloc(N_OBJS*REPLICATION*sizeof(*batch_idxs));
+    if(!oids || !batch_idxs)
+        return(1);
+
+    ch_placement_rng_seed(&rng, 1);
+    for(i=0; i<N_OBJS; i++)
+        oids[i] = ch_placement_rng_next(&rng);
+    oids[0] = 0;
+    oids[1] = UINT64_MAX;
+    down[0] = (1ULL << 3) | (1ULL << 17);
+
+    for(m=0; modules[m]; m++)
+    {
+        instance = ch_placement_initialize(modules[m], 50, 37, 0);
+        if(!instance)
+            return(1);
+
+        /* odd sizes leave a partial group at the end */
+        if(check(instance, oids, N_OBJS, batch_idxs) < 0 ||
+            check(instance, oids, 5, batch_idxs) < 0)
+        {
+            fprintf(stderr, "Error: %s: batch lookups differ.\n", modules[m]);
+            return(1);
+        }
+
+        ch_placement_set_down(instance, down);
+        if(check(instance, oids, N_OBJS, batch_idxs) < 0)
+        {
+            fprintf(stderr, "Error: %s: batch lookups differ with servers down.\n",
+                modules[m]);
+            return(1);
+        }
+        ch_placement_set_down(instance, NULL);
+
+        ch_placement_finalize(instance);
+    }
+
+    free(oids);
+    free(batch_idxs);
+
+    return(0);
+}
+
+/*
+ * Local variables:
+ *  c-indent-level: 4
+ *  c-basic-offset: 4
+ * End:
+ *
+ * vim: ft=c ts=8 sts=4 sw=4 expandtab
+ */
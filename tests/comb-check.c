@@ -0,0 +1,95 @@
+/*
+ * Copyright (C) 2015 University of Chicago.
+ * See COPYRIGHT notice in top-level directory.
+ *
+ */
+
+#include <stdio.h>
+#include <stdlib.h>
+#include <stdint.h>
+
+#include "src/comb.h"
+
+/* comb_index() must number the (N choose 3) sets 0..(N choose 3)-1
+ * without gaps or repeats, and the sparse counters must add up and merge
+ * exactly.
+ */
+
+#define N 40
+#define K 3
+
+int main(void)
+{
+    struct comb_binom binom;
+    struct comb_counts a, b;
+    unsigned long vals[K];
+    unsigned char *seen;
+    uint64_t total, idx, count = 0;
+    unsigned long i, j, l;
+
+    if(comb_binom_init(&binom, N, K) < 0)
+        return(1);
+    total = comb_binom_get(&binom, N, K);
+    if(total != choose(N, K))
+    {
+        fprintf(stderr, "Error: binomial table disagrees with choose().\n");
+        return(1);
+    }
+
+    seen = calloc(total, 1);
+    if(!seen || comb_counts_init(&a) < 0 || comb_counts_init(&b) < 0)
+        return(1);
+
+    for(i=0; i<N; i++)
+        for(j=0; j<i; j++)
+            for(l=0; l<j; l++)
+            {
+                vals[0] = i;
+                vals[1] = j;
+                vals[2] = l;
+                idx = comb_index(&binom, K, vals);
+                if(idx >= total || seen[idx])
+                {
+                    fprintf(stderr, "Error: bad index %llu.\n",
+                        (unsigned long long)idx);
+                    return(1);
+                }
+                seen[idx] = 1;
+                /* split over two tables, forcing several resizes */
+                comb_counts_add((idx & 1) ? &a : &b, idx, 1, idx);
+                comb_counts_add(&a, idx, 1, 0);
+                count++;
+            }
+
+    if(count != total || comb_counts_merge(&a, &b) < 0 || a.used != total)
+    {
+        fprintf(stderr, "Error: wrong number of combinations.\n");
+        return(1);
+    }
+    for(i=0; i<a.size; i++)
+    {
+        if(a.slots[i].key &&
+            (a.slots[i].count != 2 || a.slots[i].bytes != a.slots[i].key - 1))
+        {
+            fprintf(stderr, "Error: bad counters for index %llu.\n",
+                (unsigned long long)(a.slots[i].key - 1));
+            return(1);
+        }
+    }
+
+    comb_counts_free(&a);
+    comb_counts_free(&b);
+    comb_binom_free(&binom);
+    free(seen);
+
+    return(0);
+}
+
+/*
+ * Local variables:
+ *  c-indent-level: 4
+ *  c-basic-offset: 4
+ * End:
+ *
+ * vim: ft=c ts=8 sts=4 sw=4 expandtab
+ */
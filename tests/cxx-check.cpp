@@ -0,0 +1,81 @@
+/*
+ * Copyright (C) 2015 University of Chicago.
+ * See COPYRIGHT notice in top-level directory.
+ *
+ */
+
+#include <stdio.h>
+#include <string.h>
+#include <vector>
+
+#include "ch-placement.h"
+#include "ch-placement.hpp"
+
+/* The header-only C++ types must produce the same placements as the C
+ * library for the same configuration.
+ */
+
+#define N_OBJS 100000
+
+template <class T, unsigned int R>
+static int compare(const char *name, unsigned int n_svrs,
+    unsigned int virt_factor, int seed)
+{
+    struct ch_placement_instance *instance;
+    T t(n_svrs, virt_factor, seed);
+    std::vector<uint64_t> objs(N_OBJS);
+    std::vector<unsigned long> batch(N_OBJS*R);
+    unsigned long idxs[R];
+    struct ch_placement_rng rng;
+    unsigned long i;
+
+    instance = ch_placement_initialize(name, n_svrs, virt_factor, seed);
+    if(!instance)
+        return(1);
+
+    ch_placement_rng_seed(&rng, seed);
+    for(i=0; i<N_OBJS; i++)
+        objs[i] = ch_placement_rng_next(&rng);
+    t.find_closest(objs, batch);
+
+    for(i=0; i<N_OBJS; i++)
+    {
+        ch_placement_find_closest(instance, objs[i], R, idxs);
+        if(memcmp(idxs, &batch[i*R], sizeof(idxs)) != 0 ||
+            memcmp(idxs, t.find_closest(objs[i]).data(), sizeof(idxs)) != 0)
+        {
+            fprintf(stderr, "Error: %s (%u servers, %u virt_factor, r=%u) differs for oid %lu.\n",
+                name, n_svrs, virt_factor, R, (unsigned long)objs[i]);
+            return(1);
+        }
+    }
+
+    ch_placement_finalize(instance);
+
+    return(0);
+}
+
+int main(void)
+{
+    using namespace ch_placement;
+
+    if(compare<ring<1>, 1>("ring", 10, 1, 0) ||
+        compare<ring<3>, 3>("ring", 100, 16, 0) ||
+        compare<ring<3, layout_aos>, 3>("ring", 100, 16, 3) ||
+        compare<ring<5>, 5>("ring", 37, 128, 7) ||
+        compare<multiring<3>, 3>("multiring", 100, 16, 0) ||
+        compare<multiring<3, layout_aos>, 3>("multiring", 100, 4, 3) ||
+        compare<multiring<8>, 8>("multiring", 50, 1, 7))
+        return(1);
+
+    return(0);
+}
+
+/*
+ * Local variables:
+ *  c-indent-level: 4
+ *  c-basic-offset: 4
+ * End:
+ *
+ * vim: ft=cpp ts=8 sts=4 sw=4 expandtab
+ */
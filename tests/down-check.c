@@ -0,0 +1,129 @@
+/*
+ * Copyright (C) 2015 University of Chicago.
+ * See COPYRIGHT notice in top-level directory.
+ *
+ */
+
+#include <stdio.h>
+#include <string.h>
+#include <stdint.h>
+#include <stdlib.h>
+
+#include "ch-placement.h"
+
+/* Marking a server down must only move objects that had a replica on it,
+ * and must never place a replica on it.  With too few servers up, every
+ * entry is either an up server or CH_PLACEMENT_NO_SERVER (the scan modules
+ * may repeat a server, as they do with every server up).
+ */
+
+#define N_OBJS 20000
+#define N_SVRS 16
+#define VIRT_FACTOR 4
+#define REPLICATION 3
+#define DOWN_SVR 5
+
+static const char *modules[] = {"ring", "multiring", "hash_lookup3",
+    "hash_spooky", "xor", "two_d", "static_modulo", NULL};
+
+static int check_module(const char *module)
+{
+    struct ch_placement_instance *instance;
+    uint64_t down[CH_PLACEMENT_DOWN_WORDS(N_SVRS)];
+    uint64_t all_down[CH_PLACEMENT_DOWN_WORDS(N_SVRS)];
+    unsigned long *before, after[REPLICATION];
+    uint64_t oid;
+    unsigned long i, moved = 0;
+    int j, affected;
+
+    instance = ch_placement_initialize(module, N_SVRS, VIRT_FACTOR, 0);
+    before = malloc(N_OBJS*REPLICATION*sizeof(*before));
+    if(!instance || !before)
+        return(-1);
+
+    ch_placement_random_seed(11);
+    memset(down, 0, sizeof(down));
+    down[DOWN_SVR/64] |= 1ULL << (DOWN_SVR%64);
+    for(i=0; i<N_OBJS; i++)
+    {
+        oid = ch_placement_random_u64();
+        ch_placement_set_down(instance, NULL);
+        ch_placement_find_closest(instance, oid, REPLICATION,
+            &before[i*REPLICATION]);
+        ch_placement_set_down(instance, down);
+        ch_placement_find_closest(instance, oid, REPLICATION, after);
+
+        affected = 0;
+        for(j=0; j<REPLICATION; j++)
+        {
+            if(before[i*REPLICATION+j] == DOWN_SVR)
+                affected = 1;
+            if(after[j] == DOWN_SVR)
+            {
+                fprintf(stderr, "Error: %s placed a replica on a down server.\n",
+                    module);
+                return(-1);
+            }
+        }
+        if(!affected && memcmp(after, &before[i*REPLICATION],
+            sizeof(after)) != 0)
+            moved++;
+    }
+    if(moved)
+    {
+        fprintf(stderr, "Error: %s moved %lu objects with no replica on the down server.\n",
+            module, moved);
+        return(-1);
+    }
+
+    /* only two servers up for three replicas */
+    memset(all_down, 0xff, sizeof(all_down));
+    all_down[0] &= ~3ULL;
+    ch_placement_set_down(instance, all_down);
+    memset(after, 0x55, sizeof(after));
+    ch_placement_find_closest(instance, 42, REPLICATION, after);
+    for(j=0; j<REPLICATION; j++)
+    {
+        if(after[j] > 1 && after[j] != CH_PLACEMENT_NO_SERVER)
+        {
+            fprintf(stderr, "Error: %s left replica %d unset.\n", module, j);
+            return(-1);
+        }
+    }
+    ch_placement_set_down(instance, NULL);
+
+    if(ch_placement_find_closest_domains(instance, 42,
+        CH_MAX_REPLICATION+1, after) == 0)
+    {
+        fprintf(stderr, "Error: %s accepted too large a replication factor.\n",
+            module);
+        return(-1);
+    }
+
+    free(before);
+    ch_placement_finalize(instance);
+
+    return(0);
+}
+
+int main(void)
+{
+    int m;
+
+    for(m=0; modules[m]; m++)
+    {
+        if(check_module(modules[m]) < 0)
+            return(1);
+    }
+
+    return(0);
+}
+
+/*
+ * Local variables:
+ *  c-indent-level: 4
+ *  c-basic-offset: 4
+ * End:
+ *
+ * vim: ft=c ts=8 sts=4 sw=4 expandtab
+ */
@@ -0,0 +1,112 @@
+/*
+ * Copyright (C) 2015 University of Chicago.
+ * See COPYRIGHT notice in top-level directory.
+ *
+ */
+
+#include <stdio.h>
+#include <assert.h>
+#include <string.h>
+#include <stdlib.h>
+#include <pthread.h>
+
+#include "ch-placement.h"
+
+/* Readers look objects up through an epoch-protected handle while the
+ * main thread keeps publishing instances with different server counts.
+ * Every placement must come from one of the published configurations.
+ */
+
+#define N_READERS 4
+#define N_PUBLISH 200
+#define MAX_SVRS 80
+
+static struct ch_placement_handle *handle;
+static int done = 0;
+static int failed = 0;
+
+static void* reader_fn(void *arg)
+{
+    unsigned long old_idxs[3];
+    unsigned long new_idxs[3];
+    unsigned long lookups = 0;
+    uint64_t obj = (uintptr_t)arg;
+    int reader;
+    int i;
+
+    reader = ch_placement_handle_register(handle);
+    assert(reader >= 0);
+
+    while(!__atomic_load_n(&done, __ATOMIC_ACQUIRE))
+    {
+        obj = obj * 6364136223846793005ULL + 1442695040888963407ULL;
+        ch_placement_handle_find_closest_dual(handle, reader, obj, 3,
+            old_idxs, new_idxs);
+        for(i=0; i<3; i++)
+        {
+            if(old_idxs[i] >= MAX_SVRS || new_idxs[i] >= MAX_SVRS)
+                __atomic_store_n(&failed, 1, __ATOMIC_RELEASE);
+        }
+        lookups++;
+    }
+
+    ch_placement_handle_unregister(handle, reader);
+    assert(lookups > 0);
+
+    return(NULL);
+}
+
+int main(int argc, char **argv)
+{
+    pthread_t readers[N_READERS];
+    struct ch_placement_instance *inst;
+    int i;
+    int ret;
+
+    inst = ch_placement_initialize("ring", 64, 16, 0);
+    assert(inst);
+    handle = ch_placement_handle_create(inst, N_READERS);
+    assert(handle);
+
+    for(i=0; i<N_READERS; i++)
+    {
+        ret = pthread_create(&readers[i], NULL, reader_fn, (void*)(uintptr_t)(i+1));
+        assert(ret == 0);
+    }
+
+    for(i=0; i<N_PUBLISH; i++)
+    {
+        inst = ch_placement_initialize("ring", 64 + (i % 17), 16, 0);
+        assert(inst);
+        ret = ch_placement_handle_publish(handle, inst);
+        assert(ret == 0);
+        if(i % 3 == 0)
+        {
+            ret = ch_placement_handle_end_migration(handle);
+            assert(ret == 0);
+        }
+    }
+
+    __atomic_store_n(&done, 1, __ATOMIC_RELEASE);
+    for(i=0; i<N_READERS; i++)
+        pthread_join(readers[i], NULL);
+
+    ch_placement_handle_destroy(handle);
+
+    if(failed)
+    {
+        fprintf(stderr, "Error: reader saw an invalid placement\n");
+        return(-1);
+    }
+
+    return(0);
+}
+
+/*
+ * Local variables:
+ *  c-indent-level: 4
+ *  c-basic-offset: 4
+ * End:
+ *
+ * vim: ft=c ts=8 sts=4 sw=4 expandtab
+ */
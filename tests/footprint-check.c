@@ -0,0 +1,62 @@
+/*
+ * Copyright (C) 2015 University of Chicago.
+ * See COPYRIGHT notice in top-level directory.
+ *
+ */
+
+#include <stdio.h>
+#include <stdint.h>
+
+#include "ch-placement.h"
+
+/* Every module reports a footprint that covers its virtual node table and
+ * is rounded to whole pages.
+ */
+
+#define N_SVRS 1000
+#define VIRT_FACTOR 64
+
+static const char *modules[] = {"ring", "multiring", "xor", "hash_lookup3",
+    "hash_spooky", "two_d", NULL};
+
+int main(void)
+{
+    struct ch_placement_instance *instance;
+    struct ch_placement_footprint fp;
+    int m;
+
+    for(m=0; modules[m]; m++)
+    {
+        instance = ch_placement_initialize(modules[m], N_SVRS, VIRT_FACTOR, 0);
+        if(!instance)
+            return(1);
+
+        if(ch_placement_get_footprint(instance, &fp) != 0)
+        {
+            fprintf(stderr, "Error: %s: no footprint.\n", modules[m]);
+            return(1);
+        }
+        if(fp.used < (size_t)N_SVRS*VIRT_FACTOR*2*sizeof(uint64_t) ||
+            fp.bytes < fp.used || fp.page_size == 0 ||
+            fp.bytes % fp.page_size != 0)
+        {
+            fprintf(stderr, "Error: %s: bad footprint: %zu mapped, %zu used, "
+                "%zu byte pages.\n", modules[m], fp.bytes, fp.used,
+                fp.page_size);
+            return(1);
+        }
+
+        ch_placement_finalize(instance);
+    }
+
+    return(0);
+}
+
+/*
+ * Local variables:
+ *  c-indent-level: 4
+ *  c-basic-offset: 4
+ * End:
+ *
+ * vim: ft=c ts=8 sts=4 sw=4 expandtab
+ */
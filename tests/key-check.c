@@ -0,0 +1,85 @@
+/*
+ * Copyright (C) 2015 University of Chicago.
+ * See COPYRIGHT notice in top-level directory.
+ *
+ */
+
+#include <stdio.h>
+#include <string.h>
+#include <stdlib.h>
+
+#include "ch-placement.h"
+#include "src/spooky.h"
+
+/* The specialized 16 byte key hash must agree with the generic one, and
+ * key based lookups must match placing the key's hash directly.
+ */
+
+#define N_KEYS 10000
+#define MAX_KEY_LEN 64
+#define REPLICATION 3
+
+int main(void)
+{
+    struct ch_placement_instance *instance;
+    unsigned char keys[N_KEYS][MAX_KEY_LEN];
+    const void *key_ptrs[N_KEYS];
+    size_t key_lens[N_KEYS];
+    unsigned long batch_idxs[N_KEYS*REPLICATION];
+    unsigned long idxs[REPLICATION];
+    unsigned long i, j;
+
+    for(i=0; i<N_KEYS; i++)
+    {
+        for(j=0; j<MAX_KEY_LEN; j++)
+            keys[i][j] = (unsigned char)random();
+        key_ptrs[i] = keys[i];
+        key_lens[i] = (i % 3 == 0) ? 16 : i % MAX_KEY_LEN;
+
+        for(j=0; j<4; j++)
+        {
+            if(spooky_hash64_16(keys[i], j) != spooky_hash64(keys[i], 16, j))
+            {
+                fprintf(stderr, "Error: 16 byte hash mismatch for key %lu.\n", i);
+                return(1);
+            }
+        }
+    }
+
+    instance = ch_placement_initialize("ring", 50, 64, 0);
+    if(!instance)
+        return(1);
+
+    ch_placement_find_closest_key_batch(instance, N_KEYS, key_ptrs, key_lens,
+        REPLICATION, batch_idxs);
+    for(i=0; i<N_KEYS; i++)
+    {
+        ch_placement_find_closest(instance,
+            ch_placement_hash_key(keys[i], key_lens[i]), REPLICATION, idxs);
+        if(memcmp(idxs, &batch_idxs[i*REPLICATION], sizeof(idxs)) != 0)
+        {
+            fprintf(stderr, "Error: batch placement mismatch for key %lu.\n", i);
+            return(1);
+        }
+        ch_placement_find_closest_key(instance, keys[i], key_lens[i],
+            REPLICATION, idxs);
+        if(memcmp(idxs, &batch_idxs[i*REPLICATION], sizeof(idxs)) != 0)
+        {
+            fprintf(stderr, "Error: key placement mismatch for key %lu.\n", i);
+            return(1);
+        }
+    }
+
+    ch_placement_finalize(instance);
+
+    return(0);
+}
+
+/*
+ * Local variables:
+ *  c-indent-level: 4
+ *  c-basic-offset: 4
+ * End:
+ *
+ * vim: ft=c ts=8 sts=4 sw=4 expandtab
+ */
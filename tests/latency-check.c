@@ -0,0 +1,92 @@
+/*
+ * Copyright (C) 2015 University of Chicago.
+ * See COPYRIGHT notice in top-level directory.
+ *
+ */
+
+#include <stdio.h>
+#include <stdlib.h>
+#include <stdint.h>
+
+#include "src/latency.h"
+
+/* Histogram percentiles must stay within the bucket resolution of the
+ * exact order statistics, for a wide spread of magnitudes and when built
+ * from several merged histograms.
+ */
+
+#define N_SAMPLES 100000
+#define N_PARTS 4
+
+static int cmp_u64(const void *a, const void *b)
+{
+    uint64_t x = *(const uint64_t*)a;
+    uint64_t y = *(const uint64_t*)b;
+
+    return(x < y ? -1 : x > y);
+}
+
+int main(void)
+{
+    static const double qs[] = {0.5, 0.9, 0.99, 0.999, 1.0};
+    struct latency_hist *parts, *total;
+    uint64_t *samples;
+    uint64_t exact, approx;
+    unsigned long i;
+    unsigned int q;
+
+    parts = malloc(N_PARTS*sizeof(*parts));
+    total = malloc(sizeof(*total));
+    samples = malloc(N_SAMPLES*sizeof(*samples));
+    if(!parts || !total || !samples)
+        return(1);
+
+    for(i=0; i<N_PARTS; i++)
+        latency_hist_init(&parts[i]);
+    latency_hist_init(total);
+
+    /* log-uniform from 1 to ~2^40 */
+    srandom(7);
+    for(i=0; i<N_SAMPLES; i++)
+    {
+        samples[i] = 1ULL << (random() % 40);
+        samples[i] += random() % samples[i];
+        latency_hist_add(&parts[i % N_PARTS], samples[i]);
+    }
+    for(i=0; i<N_PARTS; i++)
+        latency_hist_merge(total, &parts[i]);
+    qsort(samples, N_SAMPLES, sizeof(*samples), cmp_u64);
+
+    if(total->count != N_SAMPLES || total->max != samples[N_SAMPLES-1])
+    {
+        fprintf(stderr, "Error: bad count or max.\n");
+        return(1);
+    }
+
+    for(q=0; q<sizeof(qs)/sizeof(qs[0]); q++)
+    {
+        exact = samples[(unsigned long)(qs[q]*N_SAMPLES + 0.5) - 1];
+        approx = latency_hist_quantile(total, qs[q]);
+        if(approx < exact || approx - exact > exact / LATENCY_SUB + 1)
+        {
+            fprintf(stderr, "Error: p%g: %llu, expected %llu.\n", qs[q]*100,
+                (unsigned long long)approx, (unsigned long long)exact);
+            return(1);
+        }
+    }
+
+    free(parts);
+    free(total);
+    free(samples);
+
+    return(0);
+}
+
+/*
+ * Local variables:
+ *  c-indent-level: 4
+ *  c-basic-offset: 4
+ * End:
+ *
+ * vim: ft=c ts=8 sts=4 sw=4 expandtab
+ */
@@ -0,0 +1,105 @@
+/*
+ * Copyright (C) 2015 University of Chicago.
+ * See COPYRIGHT notice in top-level directory.
+ *
+ */
+
+#include <stdio.h>
+#include <string.h>
+#include <stdlib.h>
+#include <pthread.h>
+
+#include "ch-placement.h"
+
+/* Instances with per node table copies must place exactly like ordinary
+ * instances, from any thread.
+ */
+
+#define N_THREADS 4
+#define N_OBJS 20000
+#define REPLICATION 3
+
+static const char *modules[] = {"ring", "multiring", "xor", "hash_lookup3",
+    "static_modulo", NULL};
+
+struct check_arg
+{
+    struct ch_placement_instance *plain;
+    struct ch_placement_instance *numa;
+    int thread;
+    int failed;
+};
+
+static void* check_thread(void *arg)
+{
+    struct check_arg *ca = arg;
+    struct ch_placement_rng rng;
+    unsigned long a[REPLICATION], b[REPLICATION];
+    uint64_t oid;
+    int i;
+
+    ch_placement_rng_seed(&rng, ca->thread);
+    for(i=0; i<N_OBJS; i++)
+    {
+        oid = ch_placement_rng_next(&rng);
+        ch_placement_find_closest(ca->plain, oid, REPLICATION, a);
+        ch_placement_find_closest(ca->numa, oid, REPLICATION, b);
+        if(memcmp(a, b, sizeof(a)) != 0)
+        {
+            ca->failed = 1;
+            break;
+        }
+    }
+
+    return(NULL);
+}
+
+int main(void)
+{
+    struct check_arg args[N_THREADS];
+    pthread_t threads[N_THREADS];
+    struct ch_placement_instance *plain, *numa;
+    int m, t;
+
+    for(m=0; modules[m]; m++)
+    {
+        plain = ch_placement_initialize(modules[m], 100, 8, 0);
+        numa = ch_placement_initialize_flags(modules[m], 100, 8, 0,
+            CH_PLACEMENT_NUMA_REPLICATE);
+        if(!plain || !numa)
+            return(1);
+
+        for(t=0; t<N_THREADS; t++)
+        {
+            args[t].plain = plain;
+            args[t].numa = numa;
+            args[t].thread = t;
+            args[t].failed = 0;
+            pthread_create(&threads[t], NULL, check_thread, &args[t]);
+        }
+        for(t=0; t<N_THREADS; t++)
+        {
+            pthread_join(threads[t], NULL);
+            if(args[t].failed)
+            {
+                fprintf(stderr, "Error: %s: replicated tables place differently.\n",
+                    modules[m]);
+                return(1);
+            }
+        }
+
+        ch_placement_finalize(plain);
+        ch_placement_finalize(numa);
+    }
+
+    return(0);
+}
+
+/*
+ * Local variables:
+ *  c-indent-level: 4
+ *  c-basic-offset: 4
+ * End:
+ *
+ * vim: ft=c ts=8 sts=4 sw=4 expandtab
+ */
@@ -0,0 +1,107 @@
+/*
+ * Copyright (C) 2015 University of Chicago.
+ * See COPYRIGHT notice in top-level directory.
+ *
+ */
+
+#include <stdio.h>
+#include <string.h>
+#include <stdlib.h>
+
+#include "ch-placement.h"
+#include "ch-placement-oid-gen.h"
+
+/* oid_sort() must order objects by oid, keep equal oids in their original
+ * order, and carry every field along with its oid.  Run with several
+ * thread counts by the test script.
+ */
+
+#define N_OBJS 300000
+
+/* orders by oid, then by original position */
+static int ref_cmp(const void *a, const void *b)
+{
+    const struct obj *o_a = a;
+    const struct obj *o_b = b;
+
+    if(o_a->oid != o_b->oid)
+        return(o_a->oid < o_b->oid ? -1 : 1);
+    if(o_a->size != o_b->size)
+        return(o_a->size < o_b->size ? -1 : 1);
+    return(0);
+}
+
+static int check(struct obj *objs, unsigned int n, const char *what)
+{
+    struct obj *ref;
+    unsigned int i;
+
+    ref = malloc(n*sizeof(*ref));
+    if(!ref)
+        return(1);
+    memcpy(ref, objs, n*sizeof(*ref));
+    qsort(ref, n, sizeof(*ref), ref_cmp);
+    oid_sort(objs, n);
+    for(i=0; i<n; i++)
+    {
+        if(objs[i].oid != ref[i].oid || objs[i].size != ref[i].size ||
+            objs[i].server_idxs[0] != ref[i].server_idxs[0])
+        {
+            fprintf(stderr, "Error: %s: object %u out of order.\n", what, i);
+            free(ref);
+            return(1);
+        }
+    }
+    free(ref);
+
+    return(0);
+}
+
+int main(void)
+{
+    struct obj *objs;
+    unsigned int i;
+
+    objs = calloc(N_OBJS, sizeof(*objs));
+    if(!objs)
+        return(1);
+    ch_placement_random_seed(99);
+
+    /* full width oids; size records the original position */
+    for(i=0; i<N_OBJS; i++)
+    {
+        objs[i].oid = ch_placement_random_u64();
+        objs[i].size = i;
+        objs[i].server_idxs[0] = objs[i].oid ^ i;
+    }
+    if(check(objs, N_OBJS, "random oids"))
+        return(1);
+
+    /* few distinct oids, in a narrow range, so that most digits are equal */
+    for(i=0; i<N_OBJS; i++)
+    {
+        objs[i].oid = (1ULL << 40) + ch_placement_random_u64() % 1000;
+        objs[i].size = i;
+        objs[i].server_idxs[0] = objs[i].oid ^ i;
+    }
+    if(check(objs, N_OBJS, "repeated oids"))
+        return(1);
+
+    /* already sorted, and tiny arrays */
+    if(check(objs, N_OBJS, "sorted oids") || check(objs, 1, "one oid") ||
+        check(objs, 0, "no oids"))
+        return(1);
+
+    free(objs);
+
+    return(0);
+}
+
+/*
+ * Local variables:
+ *  c-indent-level: 4
+ *  c-basic-offset: 4
+ * End:
+ *
+ * vim: ft=c ts=8 sts=4 sw=4 expandtab
+ */
@@ -0,0 +1,143 @@
+/*
+ * Copyright (C) 2015 University of Chicago.
+ * See COPYRIGHT notice in top-level directory.
+ *
+ */
+
+#include <stdio.h>
+#include <string.h>
+#include <stdlib.h>
+#include <limits.h>
+
+#include "ch-placement.h"
+#include "ch-placement-oid-gen.h"
+
+/* A stream must produce, in chunks of at most the requested size, the same
+ * objects as oid_gen("random") for the same seed, stop at either limit,
+ * and keep producing unique oids when its filter is too small to hold
+ * them all.
+ */
+
+#define N_OBJS 100000
+#define CHUNK 7777
+
+static int obj_cmp(const void *a, const void *b)
+{
+    const struct obj *o_a = a;
+    const struct obj *o_b = b;
+
+    if(o_a->oid < o_b->oid)
+        return(-1);
+    return(o_a->oid > o_b->oid);
+}
+
+/* streams the whole population into one array; returns its length */
+static unsigned long drain(unsigned long max_objs, uint64_t max_bytes,
+    size_t filter_bytes, struct obj *all, uint64_t *bytes)
+{
+    struct oid_stream *stream;
+    struct obj *chunk;
+    unsigned long n, total = 0, count;
+
+    stream = oid_stream_init("random", max_objs, max_bytes, 42, 3, CHUNK,
+        filter_bytes);
+    chunk = malloc(CHUNK*sizeof(*chunk));
+    if(!stream || !chunk)
+        exit(1);
+    while((n = oid_stream_next_batch(stream, chunk)) > 0)
+    {
+        if(n > CHUNK || total + n > max_objs)
+        {
+            fprintf(stderr, "Error: chunk of %lu objects is too large.\n", n);
+            exit(1);
+        }
+        memcpy(&all[total], chunk, n*sizeof(*chunk));
+        total += n;
+    }
+    oid_stream_finalize(stream, bytes, &count, NULL);
+    free(chunk);
+    if(count != total)
+    {
+        fprintf(stderr, "Error: stream counted %lu objects, produced %lu.\n",
+            count, total);
+        exit(1);
+    }
+
+    return(total);
+}
+
+int main(void)
+{
+    struct obj *ref, *all;
+    unsigned long ref_count, n, i;
+    uint64_t ref_bytes, bytes;
+
+    if(oid_stream_init("basic", N_OBJS, ULONG_MAX, 42, 3, CHUNK, 0))
+    {
+        fprintf(stderr, "Error: only the random generator streams.\n");
+        return(1);
+    }
+
+    oid_gen("random", NULL, N_OBJS, ULONG_MAX, 42, 3, 0, NULL,
+        &ref_bytes, &ref_count, &ref);
+    all = malloc(N_OBJS*sizeof(*all));
+    if(!all)
+        return(1);
+
+    n = drain(N_OBJS, ULONG_MAX, 0, all, &bytes);
+    qsort(all, n, sizeof(*all), obj_cmp);
+    if(n != ref_count || bytes != ref_bytes)
+    {
+        fprintf(stderr, "Error: stream produced %lu objects, %llu bytes; oid_gen %lu, %llu.\n",
+            n, (unsigned long long)bytes, ref_count,
+            (unsigned long long)ref_bytes);
+        return(1);
+    }
+    for(i=0; i<n; i++)
+    {
+        if(all[i].oid != ref[i].oid || all[i].size != ref[i].size)
+        {
+            fprintf(stderr, "Error: object %lu differs from oid_gen.\n", i);
+            return(1);
+        }
+    }
+
+    /* a filter far too small still yields the full count of unique oids */
+    n = drain(N_OBJS, ULONG_MAX, 64, all, &bytes);
+    qsort(all, n, sizeof(*all), obj_cmp);
+    if(n != N_OBJS)
+    {
+        fprintf(stderr, "Error: small filter produced %lu objects.\n", n);
+        return(1);
+    }
+    for(i=1; i<n; i++)
+    {
+        if(all[i].oid == all[i-1].oid)
+        {
+            fprintf(stderr, "Error: repeated oid.\n");
+            return(1);
+        }
+    }
+
+    /* the byte limit ends the stream early, as it does oid_gen */
+    n = drain(N_OBJS, 1024UL*1024*1024, 0, all, &bytes);
+    if(n >= N_OBJS || bytes < 1024UL*1024*1024)
+    {
+        fprintf(stderr, "Error: byte limit ignored (%lu objects).\n", n);
+        return(1);
+    }
+
+    free(ref);
+    free(all);
+
+    return(0);
+}
+
+/*
+ * Local variables:
+ *  c-indent-level: 4
+ *  c-basic-offset: 4
+ * End:
+ *
+ * vim: ft=c ts=8 sts=4 sw=4 expandtab
+ */
@@ -0,0 +1,121 @@
+/*
+ * Copyright (C) 2015 University of Chicago.
+ * See COPYRIGHT notice in top-level directory.
+ *
+ */
+
+#include <stdio.h>
+#include <string.h>
+#include <stdint.h>
+#include <stdlib.h>
+#include <pthread.h>
+
+#include "ch-placement.h"
+
+/* Parallel lookups must match batch lookups, including when several
+ * threads submit at once and some of them find the pool busy.
+ */
+
+#define N_OBJS 100003
+#define N_CALLERS 3
+#define REPLICATION 3
+
+static const char *modules[] = {"ring", "multiring", "hash_lookup3", NULL};
+
+struct caller_arg
+{
+    struct ch_placement_instance *instance;
+    const uint64_t *oids;
+    const unsigned long *expected;
+    int failed;
+};
+
+static void* caller_thread(void *arg)
+{
+    struct caller_arg *ca = arg;
+    unsigned long *idxs;
+    int round;
+
+    idxs = malloc(N_OBJS*REPLICATION*sizeof(*idxs));
+    if(!idxs)
+    {
+        ca->failed = 1;
+        return(NULL);
+    }
+    for(round=0; round<4; round++)
+    {
+        memset(idxs, 0xff, N_OBJS*REPLICATION*sizeof(*idxs));
+        ch_placement_find_closest_parallel(ca->instance, N_OBJS, ca->oids,
+            REPLICATION, idxs);
+        if(memcmp(idxs, ca->expected, N_OBJS*REPLICATION*sizeof(*idxs)) != 0)
+            ca->failed = 1;
+    }
+    free(idxs);
+
+    return(NULL);
+}
+
+int main(void)
+{
+    struct ch_placement_instance *instance;
+    struct ch_placement_rng rng;
+    struct caller_arg args[N_CALLERS];
+    pthread_t threads[N_CALLERS];
+    uint64_t *oids;
+    unsigned long *expected;
+    unsigned long i;
+    int m, t;
+
+    oids = malloc(N_OBJS*sizeof(*oids));
+    expected = malloc(N_OBJS*REPLICATION*sizeof(*expected));
+    if(!oids || !expected)
+        return(1);
+
+    ch_placement_rng_seed(&rng, 2);
+    for(i=0; i<N_OBJS; i++)
+        oids[i] = ch_placement_rng_next(&rng);
+
+    for(m=0; modules[m]; m++)
+    {
+        instance = ch_placement_initialize(modules[m], 200, 16, 0);
+        if(!instance)
+            return(1);
+        ch_placement_find_closest_batch(instance, N_OBJS, oids, REPLICATION,
+            expected);
+
+        for(t=0; t<N_CALLERS; t++)
+        {
+            args[t].instance = instance;
+            args[t].oids = oids;
+            args[t].expected = expected;
+            args[t].failed = 0;
+            pthread_create(&threads[t], NULL, caller_thread, &args[t]);
+        }
+        for(t=0; t<N_CALLERS; t++)
+        {
+            pthread_join(threads[t], NULL);
+            if(args[t].failed)
+            {
+                fprintf(stderr, "Error: %s: parallel lookups differ.\n",
+                    modules[m]);
+                return(1);
+            }
+        }
+
+        ch_placement_finalize(instance);
+    }
+
+    free(oids);
+    free(expected);
+
+    return(0);
+}
+
+/*
+ * Local variables:
+ *  c-indent-level: 4
+ *  c-basic-offset: 4
+ * End:
+ *
+ * vim: ft=c ts=8 sts=4 sw=4 expandtab
+ */
@@ -0,0 +1,84 @@
+/*
+ * Copyright (C) 2015 University of Chicago.
+ * See COPYRIGHT notice in top-level directory.
+ *
+ */
+
+#include <stdio.h>
+#include <string.h>
+#include <stdlib.h>
+
+#include "ch-placement.h"
+
+/* Seeded streams must be reproducible, jumped streams must differ, and
+ * striping with an explicit stream must not depend on any other state.
+ */
+
+#define N_DRAWS 1000
+#define MAX_WIDTH 64
+
+int main(void)
+{
+    struct ch_placement_instance *instance;
+    struct ch_placement_rng a, b;
+    uint64_t oids_a[MAX_WIDTH], oids_b[MAX_WIDTH];
+    unsigned long sizes[MAX_WIDTH];
+    unsigned int n_a, n_b;
+    uint64_t x;
+    int i;
+
+    ch_placement_rng_seed(&a, 42);
+    ch_placement_rng_seed(&b, 42);
+    for(i=0; i<N_DRAWS; i++)
+    {
+        if(ch_placement_rng_next(&a) != ch_placement_rng_next(&b))
+        {
+            fprintf(stderr, "Error: equal seeds produced different streams.\n");
+            return(1);
+        }
+    }
+
+    ch_placement_rng_jump(&b);
+    if(ch_placement_rng_next(&a) == ch_placement_rng_next(&b))
+    {
+        fprintf(stderr, "Error: jumped stream matches the original.\n");
+        return(1);
+    }
+
+    ch_placement_random_seed(7);
+    x = ch_placement_random_u64();
+    ch_placement_random_seed(7);
+    if(ch_placement_random_u64() != x)
+    {
+        fprintf(stderr, "Error: reseeded thread stream is not reproducible.\n");
+        return(1);
+    }
+
+    instance = ch_placement_initialize("multiring", 128, 4, 0);
+    if(!instance)
+        return(1);
+    ch_placement_rng_seed(&a, 1234);
+    ch_placement_rng_seed(&b, 1234);
+    ch_placement_create_striped_rng(instance, &a, 1UL<<40, 2, MAX_WIDTH,
+        1<<20, &n_a, oids_a, sizes);
+    ch_placement_random_u64();
+    ch_placement_create_striped_rng(instance, &b, 1UL<<40, 2, MAX_WIDTH,
+        1<<20, &n_b, oids_b, sizes);
+    if(n_a != n_b || memcmp(oids_a, oids_b, n_a*sizeof(*oids_a)) != 0)
+    {
+        fprintf(stderr, "Error: striping with equal streams differs.\n");
+        return(1);
+    }
+    ch_placement_finalize(instance);
+
+    return(0);
+}
+
+/*
+ * Local variables:
+ *  c-indent-level: 4
+ *  c-basic-offset: 4
+ * End:
+ *
+ * vim: ft=c ts=8 sts=4 sw=4 expandtab
+ */
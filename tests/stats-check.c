@@ -0,0 +1,82 @@
+/*
+ * Copyright (C) 2015 University of Chicago.
+ * See COPYRIGHT notice in top-level directory.
+ *
+ */
+
+#include <stdio.h>
+#include <stdint.h>
+
+#include "ch-placement.h"
+
+/* Every module describes its tables, and the tables add up to the memory
+ * its footprint reports as used, less the arena's own header.
+ */
+
+#define ARENA_HEADER 256
+
+#define N_SVRS 1000
+#define VIRT_FACTOR 64
+
+static const char *modules[] = {"ring", "multiring", "xor", "hash_lookup3",
+    "hash_spooky", "two_d", "static_modulo", NULL};
+
+static int check(const char *module, unsigned int flags)
+{
+    struct ch_placement_instance *instance;
+    struct ch_placement_footprint fp;
+    struct ch_placement_stats stats;
+    unsigned long entries;
+
+    instance = ch_placement_initialize_flags(module, N_SVRS, VIRT_FACTOR, 0,
+        flags);
+    if(!instance)
+        return(-1);
+
+    if(ch_placement_get_stats(instance, &stats) != 0 ||
+        ch_placement_get_footprint(instance, &fp) != 0)
+    {
+        fprintf(stderr, "Error: %s: no stats.\n", module);
+        return(-1);
+    }
+
+    entries = (unsigned long)N_SVRS*VIRT_FACTOR;
+    if(stats.n_tables < 1 || stats.replicas < 1 ||
+        stats.construction_time < 0 ||
+        stats.entries != (stats.n_tables > 1 ? entries : 0) ||
+        stats.bytes > fp.used ||
+        fp.used - stats.bytes > (size_t)ARENA_HEADER*stats.replicas)
+    {
+        fprintf(stderr, "Error: %s: bad stats: %u tables, %d replicas, "
+            "%lu entries, %zu bytes (%zu used).\n", module, stats.n_tables,
+            stats.replicas, stats.entries, stats.bytes, fp.used);
+        return(-1);
+    }
+
+    ch_placement_finalize(instance);
+
+    return(0);
+}
+
+int main(void)
+{
+    int m;
+
+    for(m=0; modules[m]; m++)
+    {
+        if(check(modules[m], 0) < 0 ||
+            check(modules[m], CH_PLACEMENT_NUMA_REPLICATE) < 0)
+            return(1);
+    }
+
+    return(0);
+}
+
+/*
+ * Local variables:
+ *  c-indent-level: 4
+ *  c-basic-offset: 4
+ * End:
+ *
+ * vim: ft=c ts=8 sts=4 sw=4 expandtab
+ */
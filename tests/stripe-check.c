@@ -0,0 +1,166 @@
+/*
+ * Copyright (C) 2015 University of Chicago.
+ * See COPYRIGHT notice in top-level directory.
+ *
+ */
+
+#include <stdio.h>
+#include <string.h>
+#include <stdlib.h>
+
+#include "ch-placement.h"
+
+/* Stripe oids derived from a file id must be reproducible across
+ * instances and individually recomputable, and multiring must still place
+ * consecutive stripes on disjoint servers.  Other modules must spread the
+ * replicas of a file's stripes over mostly distinct servers, and recompute
+ * stripes of files wider than one group of stripes.  Replication factors
+ * that cannot be placed are rejected.
+ */
+
+#define N_SVRS 64
+#define REPLICATION 3
+#define N_FILES 200
+#define MAX_WIDTH (N_SVRS/REPLICATION)
+#define WIDE_WIDTH 150
+
+static const char *modules[] = {"ring", "multiring", "xor", "static_modulo", NULL};
+
+int main(void)
+{
+    struct ch_placement_instance *a, *b;
+    uint64_t oids_a[WIDE_WIDTH], oids_b[MAX_WIDTH];
+    unsigned long sizes[WIDE_WIDTH];
+    uint64_t oid;
+    unsigned long idxs[REPLICATION];
+    int used[N_SVRS];
+    unsigned int n_a, n_b;
+    unsigned long width;
+    unsigned long f, i, j;
+    int m;
+
+    for(m=0; modules[m]; m++)
+    {
+        a = ch_placement_initialize(modules[m], N_SVRS, 4, 0);
+        b = ch_placement_initialize(modules[m], N_SVRS, 4, 0);
+        if(!a || !b)
+            return(1);
+
+        for(f=0; f<N_FILES; f++)
+        {
+            if(ch_placement_create_striped_file(a, f*7919, 1UL<<34,
+                REPLICATION, MAX_WIDTH, 1<<20, &n_a, oids_a, sizes) < 0 ||
+                ch_placement_create_striped_file(b, f*7919, 1UL<<34,
+                REPLICATION, MAX_WIDTH, 1<<20, &n_b, oids_b, sizes) < 0)
+                return(1);
+            if(n_a != MAX_WIDTH || n_a != n_b ||
+                memcmp(oids_a, oids_b, n_a*sizeof(*oids_a)) != 0)
+            {
+                fprintf(stderr, "Error: %s: stripe oids not reproducible.\n",
+                    modules[m]);
+                return(1);
+            }
+
+            memset(used, 0, sizeof(used));
+            for(i=0; i<n_a; i++)
+            {
+                if(ch_placement_stripe_oid(b, f*7919, i, REPLICATION,
+                    &oid) < 0 || oid != oids_a[i])
+                {
+                    fprintf(stderr, "Error: %s: stripe %lu oid differs.\n",
+                        modules[m], i);
+                    return(1);
+                }
+                ch_placement_find_closest(a, oids_a[i], REPLICATION, idxs);
+                for(j=0; j<REPLICATION; j++)
+                {
+                    if(used[idxs[j]]++ && strcmp(modules[m], "multiring") == 0)
+                    {
+                        fprintf(stderr, "Error: multiring: stripes overlap on server %lu.\n",
+                            idxs[j]);
+                        return(1);
+                    }
+                }
+            }
+
+            width = 0;
+            for(i=0; i<N_SVRS; i++)
+            {
+                if(used[i])
+                    width++;
+            }
+            if(width*10 < (unsigned long)n_a*REPLICATION*8)
+            {
+                fprintf(stderr, "Error: %s: file %lu only reached %lu servers.\n",
+                    modules[m], f, width);
+                return(1);
+            }
+        }
+
+        if(ch_placement_create_striped_file(a, 12345, 1UL<<40, REPLICATION,
+            WIDE_WIDTH, 1<<20, &n_a, oids_a, sizes) < 0 || n_a != WIDE_WIDTH)
+            return(1);
+        for(i=0; i<n_a; i++)
+        {
+            if(ch_placement_stripe_oid(b, 12345, i, REPLICATION, &oid) < 0 ||
+                oid != oids_a[i])
+            {
+                fprintf(stderr, "Error: %s: wide stripe %lu oid differs.\n",
+                    modules[m], i);
+                return(1);
+            }
+        }
+
+        /* replication the lookup buffers or the servers cannot hold */
+        if(ch_placement_create_striped_file(a, 1, 1UL<<30,
+            CH_MAX_REPLICATION+1, MAX_WIDTH, 1<<20, &n_a, oids_a, sizes) == 0 ||
+            ch_placement_stripe_oid(a, 1, 0, CH_MAX_REPLICATION+1, &oid) == 0)
+        {
+            fprintf(stderr, "Error: %s: replication %d accepted.\n",
+                modules[m], CH_MAX_REPLICATION+1);
+            return(1);
+        }
+        ch_placement_create_striped(a, 1UL<<30, CH_MAX_REPLICATION+1,
+            MAX_WIDTH, 1<<20, &n_a, oids_a, sizes);
+        if(n_a != 0)
+        {
+            fprintf(stderr, "Error: %s: replication %d accepted.\n",
+                modules[m], CH_MAX_REPLICATION+1);
+            return(1);
+        }
+        ch_placement_finalize(a);
+        a = ch_placement_initialize(modules[m], 2, 4, 0);
+        if(!a)
+            return(1);
+        if(ch_placement_create_striped_file(a, 1, 1UL<<30, REPLICATION,
+            MAX_WIDTH, 1<<20, &n_a, oids_a, sizes) == 0 ||
+            ch_placement_stripe_oid(a, 1, 0, REPLICATION, &oid) == 0)
+        {
+            fprintf(stderr, "Error: %s: replication %d on 2 servers accepted.\n",
+                modules[m], REPLICATION);
+            return(1);
+        }
+        ch_placement_create_striped(a, 1UL<<30, REPLICATION, MAX_WIDTH,
+            1<<20, &n_a, oids_a, sizes);
+        if(n_a != 0)
+        {
+            fprintf(stderr, "Error: %s: replication %d on 2 servers accepted.\n",
+                modules[m], REPLICATION);
+            return(1);
+        }
+
+        ch_placement_finalize(a);
+        ch_placement_finalize(b);
+    }
+
+    return(0);
+}
+
+/*
+ * Local variables:
+ *  c-indent-level: 4
+ *  c-basic-offset: 4
+ * End:
+ *
+ * vim: ft=c ts=8 sts=4 sw=4 expandtab
+ */
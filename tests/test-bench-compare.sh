@@ -0,0 +1,69 @@
+#!/bin/bash
+
+tmp=$(mktemp -d)
+trap "rm -rf $tmp" EXIT
+
+# a run compared with itself passes, and CSV rows accumulate under one
+# header
+for i in 1 2; do
+    src/ch-placement-benchmark -s 64 -o 20000 -r 3 -p ring -v 16 -n 3 -b 64 -l 1 \
+        -J $tmp/run.json -C $tmp/run.csv > /dev/null
+    if [ $? -ne 0 ]; then
+        exit 1
+    fi
+done
+if [ $(wc -l < $tmp/run.csv) -ne 3 ]; then
+    echo "Error: expected a header and two rows in the CSV output"
+    exit 1
+fi
+src/ch-placement-bench-compare $tmp/run.json $tmp/run.json > /dev/null
+if [ $? -ne 0 ]; then
+    exit 1
+fi
+
+# synthetic results: ring placement at the given per pass rates
+result() {
+    cat > $tmp/$1.json <<EOT
+{
+  "benchmark": "ch-placement-benchmark",
+  "config": {"algorithm": "ring", "objects": 1000, "replication": 3,
+             "servers": 64, "virt_factor": 16, "numa_replicate": 0},
+  "metrics": {"placement": {"oids_per_call": 1, "rate": 0, "samples": [$2]}}
+}
+EOT
+}
+
+result base "100, 101, 99, 100"
+
+# a 20% drop is a regression
+result slow "80, 81, 79, 80"
+src/ch-placement-bench-compare $tmp/base.json $tmp/slow.json > /dev/null
+if [ $? -ne 1 ]; then
+    echo "Error: 20% slowdown not flagged"
+    exit 1
+fi
+
+# within the tolerance
+result same "98, 99, 97, 98"
+src/ch-placement-bench-compare $tmp/base.json $tmp/same.json > /dev/null
+if [ $? -ne 0 ]; then
+    echo "Error: 2% slowdown flagged"
+    exit 1
+fi
+
+# beyond the tolerance, but within the noise of the current run
+result noisy "60, 120, 70, 110"
+src/ch-placement-bench-compare $tmp/base.json $tmp/noisy.json > /dev/null
+if [ $? -ne 0 ]; then
+    echo "Error: noisy run flagged"
+    exit 1
+fi
+
+# different workloads cannot be compared
+sed -e 's/"servers": 64/"servers": 65/' $tmp/same.json > $tmp/other.json
+src/ch-placement-bench-compare $tmp/base.json $tmp/other.json > /dev/null 2>&1
+rc=$?
+if [ $rc -eq 0 -o $rc -eq 1 ]; then
+    echo "Error: mismatched configurations compared"
+    exit 1
+fi
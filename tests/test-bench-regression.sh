@@ -0,0 +1,26 @@
+#!/bin/bash
+
+# Optional performance gate: set CH_PLACEMENT_BENCH_BASELINE to a JSON
+# result of the command below, recorded with a known good build on the
+# same machine.  If the file does not exist it is recorded now.  Skipped
+# when the variable is not set.
+if [ -z "$CH_PLACEMENT_BENCH_BASELINE" ]; then
+    exit 77
+fi
+
+bench() {
+    src/ch-placement-benchmark -s 1000 -o 1000000 -r 3 -p ring -v 1024 \
+        -n 5 -b 64 -l 1 -J $1 > /dev/null
+}
+
+if [ ! -e "$CH_PLACEMENT_BENCH_BASELINE" ]; then
+    bench "$CH_PLACEMENT_BENCH_BASELINE" || exit 1
+    echo "Recorded baseline $CH_PLACEMENT_BENCH_BASELINE"
+    exit 0
+fi
+
+current=$(mktemp)
+trap "rm -f $current" EXIT
+bench $current || exit 1
+src/ch-placement-bench-compare $CH_PLACEMENT_BENCH_COMPARE_ARGS \
+    "$CH_PLACEMENT_BENCH_BASELINE" $current
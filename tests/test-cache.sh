@@ -0,0 +1,29 @@
+#!/bin/bash
+
+tmp=$(mktemp -d)
+trap "rm -rf $tmp" EXIT
+
+# every cache mode is reported in both oid orders, and recorded in JSON
+src/ch-placement-benchmark -s 64 -o 20000 -r 3 -p ring -v 16 -w 100 \
+    -J $tmp/run.json > $tmp/cache.out
+if [ $? -ne 0 ]; then
+    exit 1
+fi
+for mode in warm flush cycle; do
+    for order in random sorted; do
+        if ! grep -q "^$mode	$order	" $tmp/cache.out; then
+            echo "Error: no $mode/$order result"
+            exit 1
+        fi
+        if ! grep -q "\"${mode}_${order}_ns\"" $tmp/run.json; then
+            echo "Error: no $mode/$order result in the JSON output"
+            exit 1
+        fi
+    done
+done
+
+# a run compared with itself passes
+src/ch-placement-bench-compare $tmp/run.json $tmp/run.json > /dev/null
+if [ $? -ne 0 ]; then
+    exit 1
+fi
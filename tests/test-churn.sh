@@ -0,0 +1,35 @@
+#!/bin/bash
+
+tmp=$(mktemp -d)
+trap "rm -rf $tmp" EXIT
+
+# consistent hashing moves close to the minimum for every kind of step
+src/ch-placement-churn -p ring -s 64 -v 64 -r 3 -o 20000 -c +1,+4,-5,d3,u3 > $tmp/ring.out
+if [ $? -ne 0 ]; then
+    exit 1
+fi
+if [ $(grep -vc "^#" $tmp/ring.out) -ne 5 ]; then
+    echo "Error: expected one row per step"
+    exit 1
+fi
+if grep -v "^#" $tmp/ring.out | awk -F'\t' '$12 > 1.5 {bad=1} END {exit !bad}'; then
+    echo "Error: ring moved far more than the minimum"
+    exit 1
+fi
+
+# modulo placement reshuffles almost everything when a server is added
+src/ch-placement-churn -p static_modulo -s 64 -v 1 -r 3 -o 20000 -c +1 > $tmp/modulo.out
+if [ $? -ne 0 ]; then
+    exit 1
+fi
+if grep -v "^#" $tmp/modulo.out | awk -F'\t' '$12 < 5 {bad=1} END {exit !bad}'; then
+    echo "Error: modulo placement churn not measured"
+    exit 1
+fi
+
+# steps that would leave too few servers are rejected
+src/ch-placement-churn -p ring -s 4 -v 16 -r 3 -o 1000 -c d0,d1 > /dev/null 2>&1
+if [ $? -eq 0 ]; then
+    echo "Error: impossible step accepted"
+    exit 1
+fi
@@ -0,0 +1,71 @@
+#!/bin/bash
+
+tmp=$(mktemp -d)
+trap "rm -rf $tmp" EXIT
+
+# hardware counters may not be available (virtual machines, restrictive
+# perf_event_paranoid); either way the runs must succeed and say which
+src/ch-placement-benchmark -s 64 -o 20000 -r 3 -p ring -v 16 -H \
+    -J $tmp/run.json > $tmp/bench.out
+if [ $? -ne 0 ]; then
+    exit 1
+fi
+if grep -q "^# Hardware counters not available" $tmp/bench.out; then
+    echo "Note: hardware counters not available, fallback checked only"
+    if grep -q '"counters"' $tmp/run.json; then
+        echo "Error: counters written to JSON although not available"
+        exit 1
+    fi
+elif ! grep -q "^ring	" $tmp/bench.out || \
+    ! grep -q '"counters"' $tmp/run.json; then
+    echo "Error: no counters reported"
+    exit 1
+fi
+
+src/ch-placement-decluster-check -s 16 -o 10000 -r 3 -p ring -v 16 -k 2 -H \
+    > $tmp/decluster.out
+if [ $? -ne 0 ]; then
+    exit 1
+fi
+if ! grep -q "^# Hardware counters not available" $tmp/decluster.out && \
+    ! grep -q "^ring	failover	" $tmp/decluster.out; then
+    echo "Error: no failover counters reported"
+    exit 1
+fi
+
+# the table sweep gets counter columns
+src/ch-placement-benchmark -s 64,128 -o 10000 -r 3 -p ring -v 16 -H > $tmp/table.out
+if [ $? -ne 0 ]; then
+    exit 1
+fi
+if [ $(grep -v "^#" $tmp/table.out | awk -F'\t' '{print NF}' | sort -u) != 16 ]; then
+    echo "Error: wrong number of columns in the table sweep"
+    exit 1
+fi
+
+# instructions per lookup are compared, the other counters only shown
+result() {
+    cat > $tmp/$1.json <<EOT
+{
+  "benchmark": "ch-placement-benchmark",
+  "config": {"algorithm": "ring", "objects": 1000, "replication": 3,
+             "servers": 64, "virt_factor": 16, "numa_replicate": 0},
+  "counters": {"cycles": $3, "instructions": $2},
+  "metrics": {"placement": {"oids_per_call": 1, "rate": 0, "samples": [100, 100]}}
+}
+EOT
+}
+
+result base 200 100
+result more 240 100
+src/ch-placement-bench-compare $tmp/base.json $tmp/more.json > /dev/null
+if [ $? -ne 1 ]; then
+    echo "Error: 20% more instructions not flagged"
+    exit 1
+fi
+result slower 200 150
+src/ch-placement-bench-compare $tmp/base.json $tmp/slower.json > /dev/null
+if [ $? -ne 0 ]; then
+    echo "Error: cycles per lookup flagged"
+    exit 1
+fi
@@ -0,0 +1,6 @@
+#!/bin/bash
+
+tests/cxx-check
+if [ $? -ne 0 ]; then
+    exit 1
+fi
@@ -0,0 +1,49 @@
+#!/bin/bash
+
+# prints the "changed replica set" percentage reported by ch-placement-diff
+moved_pct() {
+    src/ch-placement-diff "$@" | \
+        sed -n 's/^# Objects with a changed replica set: \([0-9.]*\)%$/\1/p'
+}
+
+# exact arc comparison
+exact=$(moved_pct -p ring -s 64 -S 72 -v 16 -r 3)
+if [ $? -ne 0 ] || [ -z "$exact" ]; then
+    exit 1
+fi
+
+# the sampled estimate of the same change must agree with the exact
+# result to within half a percentage point
+sampled=$(moved_pct -p ring -s 64 -S 72 -v 16 -r 3 -e -n 200000)
+if [ $? -ne 0 ] || [ -z "$sampled" ]; then
+    exit 1
+fi
+awk -v e="$exact" -v s="$sampled" \
+    'BEGIN { d = e - s; if(d < 0) d = -d; exit(d > 0.5) }'
+if [ $? -ne 0 ]; then
+    echo "exact $exact% and sampled $sampled% moved fractions disagree"
+    exit 1
+fi
+
+# same, with sampling forced onto a single thread
+sampled=$(moved_pct -p ring -s 64 -S 72 -v 16 -r 3 -e -n 20000 -t 1)
+if [ $? -ne 0 ] || [ -z "$sampled" ]; then
+    exit 1
+fi
+awk -v e="$exact" -v s="$sampled" \
+    'BEGIN { d = e - s; if(d < 0) d = -d; exit(d > 1.5) }'
+if [ $? -ne 0 ]; then
+    echo "exact $exact% and single thread sampled $sampled% disagree"
+    exit 1
+fi
+
+src/ch-placement-diff -p multiring -s 64 -v 16 -r 3 -X 5 > /dev/null
+if [ $? -ne 0 ]; then
+    exit 1
+fi
+
+# sampled comparison
+src/ch-placement-diff -p hash_spooky -s 64 -S 72 -v 1 -r 3 -n 10000 > /dev/null
+if [ $? -ne 0 ]; then
+    exit 1
+fi
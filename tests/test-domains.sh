@@ -0,0 +1,14 @@
+#!/bin/bash
+
+for module in ring multiring hash_lookup3 hash_spooky xor two_d static_modulo; do
+    src/ch-placement-lookup $module 256 16 100 3 8
+    if [ $? -ne 0 ]; then
+        exit 1
+    fi
+done
+
+# asking for more replicas than there are domains must fail
+src/ch-placement-lookup ring 256 16 100 3 2
+if [ $? -eq 0 ]; then
+    exit 1
+fi
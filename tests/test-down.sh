@@ -0,0 +1,14 @@
+#!/bin/bash
+
+for module in ring multiring hash_lookup3 xor static_modulo; do
+    src/ch-placement-decluster-check -s 64 -o 10000 -r 3 -p $module -v 4 -k 5 > /dev/null
+    if [ $? -ne 0 ]; then
+        exit 1
+    fi
+done
+
+# objects with no replica on the down server keep their placement
+tests/down-check
+if [ $? -ne 0 ]; then
+    exit 1
+fi
@@ -0,0 +1,32 @@
+#!/bin/bash
+
+# every instruction set level must produce the same placement; levels the
+# CPU lacks fall back to the best available one
+for module in xor hash_lookup3 hash_spooky; do
+    expected=$(CH_PLACEMENT_ISA=scalar src/ch-placement-lookup $module 300 3 98765432101 4)
+    if [ $? -ne 0 ]; then
+        exit 1
+    fi
+    for isa in sse4.2 avx2 avx512; do
+        result=$(CH_PLACEMENT_ISA=$isa src/ch-placement-lookup $module 300 3 98765432101 4 2>&1)
+        if [ "$result" != "$expected" ]; then
+            echo "Error: $module placement differs with CH_PLACEMENT_ISA=$isa"
+            exit 1
+        fi
+    done
+done
+
+# the library falls back silently and reports the level it chose
+isa_in_use() {
+    CH_PLACEMENT_ISA=$1 src/ch-placement-benchmark -s 16 -o 1000 -r 3 \
+        -p xor -v 4 2>&1 | sed -n 's/^# Scan kernels: //p'
+}
+best=$(isa_in_use "")
+if [ -z "$best" ] || [ "$(isa_in_use scalar)" != "scalar" ]; then
+    echo "Error: CH_PLACEMENT_ISA=scalar not honored"
+    exit 1
+fi
+if [ "$(isa_in_use bogus)" != "$best" ]; then
+    echo "Error: unknown CH_PLACEMENT_ISA did not fall back to $best"
+    exit 1
+fi
@@ -0,0 +1,6 @@
+#!/bin/bash
+
+tests/latency-check
+if [ $? -ne 0 ]; then
+    exit 1
+fi
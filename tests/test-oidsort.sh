@@ -0,0 +1,9 @@
+#!/bin/bash
+
+# one thread, and several threads sharing the passes
+for threads in 1 4; do
+    CH_PLACEMENT_THREADS=$threads tests/oidsort-check
+    if [ $? -ne 0 ]; then
+        exit 1
+    fi
+done
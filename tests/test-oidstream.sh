@@ -0,0 +1,46 @@
+#!/bin/bash
+
+tests/oidstream-check
+if [ $? -ne 0 ]; then
+    exit 1
+fi
+
+tmp=$(mktemp -d)
+trap "rm -rf $tmp" EXIT
+
+# the failover counts do not depend on the chunk size
+for chunk in 3000 20000; do
+    src/ch-placement-decluster-check -s 32 -o 20000 -r 3 -p ring -v 64 -k 5 \
+        -G $chunk | grep -v '^#' > $tmp/decluster.$chunk
+    if [ ${PIPESTATUS[0]} -ne 0 ]; then
+        exit 1
+    fi
+done
+if ! cmp -s $tmp/decluster.3000 $tmp/decluster.20000; then
+    echo "Error: decluster results depend on the chunk size"
+    exit 1
+fi
+
+# every pass of the benchmark streams the population
+src/ch-placement-benchmark -s 64 -o 20000 -r 3 -p ring -v 16 -G 3000 \
+    -b 64 -P -l 1 > $tmp/bench.out
+if [ $? -ne 0 ]; then
+    exit 1
+fi
+if ! grep -q "^20000	3	64	16	ring	" $tmp/bench.out; then
+    echo "Error: no placement result"
+    exit 1
+fi
+
+# so do the table and thread sweeps and the key benchmark
+for args in "-s 64,128 -v 16" "-s 64 -v 16 -S 2" "-s 64 -v 16 -k 16"; do
+    src/ch-placement-benchmark $args -o 20000 -r 3 -p ring -G 3000 \
+        > $tmp/mode.out
+    if [ $? -ne 0 ]; then
+        exit 1
+    fi
+    if ! grep -q "^20000	" $tmp/mode.out; then
+        echo "Error: no result for $args"
+        exit 1
+    fi
+done
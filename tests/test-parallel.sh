@@ -0,0 +1,8 @@
+#!/bin/bash
+
+# more threads than this machine may have CPUs, so that work is always
+# split and stolen
+CH_PLACEMENT_THREADS=4 tests/parallel-check
+if [ $? -ne 0 ]; then
+    exit 1
+fi
@@ -0,0 +1,12 @@
+#!/bin/bash
+
+tests/stats-check
+if [ $? -ne 0 ]; then
+    exit 1
+fi
+
+# table sweep over server counts and virtual node factors
+src/ch-placement-benchmark -s 64,128 -v 1,16 -o 10000 -r 3 -p ring,multiring,static_modulo > /dev/null
+if [ $? -ne 0 ]; then
+    exit 1
+fi
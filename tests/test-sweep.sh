@@ -0,0 +1,8 @@
+#!/bin/bash
+
+for a in compact scatter numa none; do
+    src/ch-placement-benchmark -s 64 -o 20000 -r 3 -p ring,multiring -v 16 -S 3 -a $a > /dev/null
+    if [ $? -ne 0 ]; then
+        exit 1
+    fi
+done
@@ -0,0 +1,9 @@
+#!/bin/bash
+
+# erasure coded widths beyond the historical limit of 5
+for module in ring multiring hash_lookup3 hash_spooky xor two_d static_modulo; do
+    src/ch-placement-lookup $module 64 4 100 32 > /dev/null
+    if [ $? -ne 0 ]; then
+        exit 1
+    fi
+done